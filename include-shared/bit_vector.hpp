@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Bits packed 64 to a word: bit i is bit i % 64 of word i / 64. Bit strings
+ * list bit 0 first, as input files and outputs always have, so
+ * BitVector::from_string("011")[1] == 1.
+ */
+class BitVector {
+public:
+  BitVector();
+  explicit BitVector(size_t num_bits); // all zero
+  // From 0s and 1s. Explicit, so unpacked inputs are never repacked unseen.
+  explicit BitVector(const std::vector<int> &bits);
+
+  // '0' and '1' characters; anything else is skipped, as parse_input does.
+  static BitVector from_string(const std::string &bits);
+  // Hex digits, digit k holding bits 4k..4k+3 with bit 4k its lowest.
+  static BitVector from_hex(const std::string &hex);
+  // Bit i is bit i % 8 of byte i / 8.
+  static BitVector from_bytes(const unsigned char *data, size_t num_bits);
+
+  size_t size() const { return this->num_bits; }
+  bool empty() const { return this->num_bits == 0; }
+  int operator[](size_t i) const {
+    return (this->words[i / 64] >> (i % 64)) & 1;
+  }
+  void set(size_t i, int bit);
+  void push_back(int bit);
+  void append(const BitVector &bits);
+  void resize(size_t num_bits);
+  void reserve(size_t num_bits);
+
+  std::string to_string() const;
+  std::string to_hex() const;
+  void to_bytes(unsigned char *out) const; // (size() + 7) / 8 bytes
+  std::vector<int> to_ints() const;
+
+  bool operator==(const BitVector &other) const;
+
+private:
+  std::vector<uint64_t> words; // bits past num_bits are zero
+  size_t num_bits;
+};
+
+// ================================================
+// INPUT FILES
+// ================================================
+
+/*
+ * Input file formats:
+ *   TEXT    0s and 1s, one input per line (other characters are skipped)
+ *   HEX     hex digits as BitVector::from_hex, one input per line; inputs
+ *           are cut to the circuit's width, and the bits cut must be zero
+ *   BINARY  "YAOSBITS", uint32 version, uint32 reserved, uint64 width,
+ *           uint64 count, then count inputs of (width + 7) / 8 bytes each
+ *           as BitVector::from_bytes, little endian
+ */
+namespace InputFormat {
+enum T { TEXT, HEX, BINARY };
+};
+// From "text", "hex" or "binary".
+InputFormat::T parse_input_format(std::string name);
+
+/*
+ * Reads a batch input file one input at a time, so only the packed inputs
+ * are ever held. width is the number of bits an input must have.
+ */
+class BatchInputReader {
+public:
+  BatchInputReader(std::string filename, InputFormat::T format, size_t width);
+  // False at the end of the file.
+  // @throws error if an input has the wrong width.
+  bool next(BitVector &input);
+
+private:
+  std::string filename;
+  InputFormat::T format;
+  size_t width;
+  std::ifstream in;
+  uint64_t remaining; // inputs left in a binary file
+};
+
+// Every input in filename; single runs take the first.
+std::vector<BitVector> read_batch_input(std::string filename,
+                                        InputFormat::T format, size_t width);
+// Write inputs, all of one width, in the BINARY format.
+void write_binary_input(std::string filename,
+                        const std::vector<BitVector> &inputs);
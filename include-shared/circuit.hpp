@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <span>
 #include <stdio.h>
 #include <string>
 #include <vector>
@@ -9,12 +13,16 @@
 #include <crypto++/integer.h>
 #include <crypto++/secblock.h>
 
+#include "constants.hpp"
+#include "label.hpp"
+#include "secure_arena.hpp"
+
 // ================================================
 // REGULAR CIRCUIT
 // ================================================
 
 namespace GateType {
-enum T { AND_GATE = 1, XOR_GATE = 2, NOT_GATE = 3 };
+enum T : int32_t { AND_GATE = 1, XOR_GATE = 2, NOT_GATE = 3 };
 };
 
 struct Gate {
@@ -24,26 +32,110 @@ struct Gate {
   int output; // index corresponding to output wire
 };
 
+/*
+ * Gates are a read-only view so they can live in a vector or directly in a
+ * mapped compiled circuit; `storage` keeps either alive. Copies share it.
+ */
 struct Circuit {
   int num_gate, num_wire, garbler_input_length, evaluator_input_length,
       output_length;
-  std::vector<Gate> gates;
+  std::span<const Gate> gates;
+  std::shared_ptr<const void> storage;
+  // Set by schedule_circuit: level i is gates [level_offsets[i],
+  // level_offsets[i + 1]). Empty if gates are not grouped by level.
+  std::vector<int> level_offsets;
+
+  void set_gates(std::vector<Gate> gates);
 };
 Circuit parse_circuit(std::string filename);
+Circuit parse_circuit_stdio(std::string filename);
+void write_circuit(const Circuit &circuit, std::string filename);
+// parse_circuit's checks for circuits loaded another way: wires in range,
+// read only after they are assigned, assigned once, every output assigned.
+void validate_circuit(const Circuit &circuit);
+
+// Analyses. Level 0 gates read only inputs. The last use of an output wire is
+// num_gate; a wire nothing reads dies at the gate writing it (inputs at 0).
+std::vector<uint32_t> compute_gate_levels(const Circuit &circuit);
+std::vector<uint32_t> compute_wire_last_use(const Circuit &circuit);
+
+// SHA-256 over the header and gate list, as hex. Identifies a circuit
+// independently of the file it came from.
+std::string circuit_fingerprint(const Circuit &circuit);
+
+// Label storage plan: wire w lives in slot[w] of a pool of num_slots labels.
+// A slot is reused once the last gate reading its wire has run. Inputs keep
+// slots 0..inputs-1 and output slots are never reused.
+struct WireSlots {
+  std::vector<int> slot;
+  int num_slots;
+};
+WireSlots assign_wire_slots(const Circuit &circuit);
+
+// Reorder gates level by level, operands close together, and renumber wires
+// in that order. Inputs and outputs keep their wires. Deterministic and
+// idempotent, so both parties get the same circuit.
+Circuit schedule_circuit(const Circuit &circuit);
 
 // ================================================
 // GARBLED CIRCUIT
 // ================================================
 
+// Labels of the width this build was configured with.
+using WireLabel = Label<YAOS_LABEL_BITS>;
+using GateEntry = TableEntry<YAOS_LABEL_BITS>;
+
 struct GarbledWire {
-  CryptoPP::SecByteBlock value;
+  WireLabel value;
 };
 
+// Entries come from the session arena while one is in scope.
 struct GarbledGate {
-  std::vector<CryptoPP::SecByteBlock> entries;
+  ArenaVector<GateEntry> entries; // 4 for AND gates, none otherwise
 };
 
 struct GarbledLabels {
   std::vector<GarbledWire> zeros; //[0, curcuit.garblerinputlen-1][garblerinputlen, evalen+garblerinputlen-1]
   std::vector<GarbledWire> ones;
+  WireLabel delta; // free-XOR offset: ones = zeros ^ delta
 };
+
+// ================================================
+// REACTIVE JOBS
+// ================================================
+
+/*
+ * How a session job connects to labels kept from earlier jobs. A kept value
+ * is a run of output wires left as labels under the session's delta instead
+ * of being revealed. A bound input takes a kept value's labels directly, so
+ * it needs neither a garbler input label nor an OT.
+ */
+struct KeptOutput {
+  std::string name;
+  int first_output; // index among the circuit's outputs
+  int length;
+};
+
+struct BoundInput {
+  std::string name; // whole value, on consecutive input wires
+  int first_input;  // input wire index
+};
+
+struct JobWiring {
+  std::vector<BoundInput> inputs;
+  std::vector<KeptOutput> outputs;
+};
+
+// Kept values by name: zero labels for the garbler, the evaluated labels for
+// the evaluator.
+using KeptLabels = std::map<std::string, std::vector<GarbledWire>>;
+
+// Label each input wire takes from kept, nullptr where unbound.
+// @throws error for unknown values or ranges outside the inputs.
+std::vector<const GarbledWire *>
+bind_inputs(const Circuit &circuit, const JobWiring &wiring,
+            const KeptLabels &kept);
+// Whether each output is kept rather than revealed.
+// @throws error for ranges outside the outputs.
+std::vector<bool> kept_outputs(const Circuit &circuit,
+                               const JobWiring &wiring);
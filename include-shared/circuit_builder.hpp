@@ -0,0 +1,84 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "circuit.hpp"
+
+/*
+ * Builds a Circuit gate by gate. A Bit is a wire or one of the constants
+ * ZERO and ONE; constants are folded as gates are added, so generators can
+ * pad with them for free. Bits vectors are little-endian, matching the bit
+ * order of input and output strings.
+ */
+class CircuitBuilder {
+public:
+  using Bit = int;
+  using Bits = std::vector<Bit>;
+  static constexpr Bit ZERO = -1;
+  static constexpr Bit ONE = -2;
+
+  CircuitBuilder(int garbler_input_length, int evaluator_input_length);
+
+  Bits garbler_input() const;
+  Bits evaluator_input() const;
+
+  Bit AND(Bit a, Bit b);
+  Bit XOR(Bit a, Bit b);
+  Bit NOT(Bit a);
+  Bit OR(Bit a, Bit b);
+  Bit MUX(Bit s, Bit a, Bit b); // s ? a : b
+
+  /*
+   * Circuit computing outputs, with inputs as given to the constructor and
+   * outputs as the last wires. Dead gates are dropped by optimize_circuit.
+   * @throws error if a constant output is asked of a circuit with no inputs.
+   */
+  Circuit finish(const Bits &outputs);
+
+private:
+  Bit emit(GateType::T type, Bit lhs, Bit rhs);
+
+  int garbler_input_length, evaluator_input_length;
+  int num_wire;
+  std::vector<Gate> gates;
+  std::unordered_map<Bit, Bit> negation; // NOT outputs and their inputs
+};
+
+/*
+ * Builds a circuit from a body taking (builder, garbler bits, evaluator bits)
+ * and returning the output bits.
+ */
+template <typename Body>
+Circuit build_circuit(int garbler_input_length, int evaluator_input_length,
+                      Body body) {
+  CircuitBuilder builder(garbler_input_length, evaluator_input_length);
+  CircuitBuilder::Bits outputs =
+      body(builder, builder.garbler_input(), builder.evaluator_input());
+  return builder.finish(outputs);
+}
+
+// Generators. Operands of different widths are zero-extended; results are
+// as wide as noted. All are written to keep AND gates, the only gates that
+// cost ciphertexts under free-XOR, to a minimum.
+namespace circuits {
+using Bit = CircuitBuilder::Bit;
+using Bits = CircuitBuilder::Bits;
+
+// x + y, one bit wider than the wider operand. Ripple carry uses one AND per
+// bit; carry lookahead (Sklansky prefix) has logarithmic depth, more ANDs.
+Bits add(CircuitBuilder &b, const Bits &x, const Bits &y);
+Bits add_lookahead(CircuitBuilder &b, const Bits &x, const Bits &y);
+// x - y modulo 2^width of the wider operand.
+Bits subtract(CircuitBuilder &b, const Bits &x, const Bits &y);
+// Full product, x.size() + y.size() bits. Karatsuba above a threshold width,
+// schoolbook with ripple accumulation below it.
+Bits multiply(CircuitBuilder &b, const Bits &x, const Bits &y);
+
+// Unsigned comparisons and equality.
+Bit less_than(CircuitBuilder &b, const Bits &x, const Bits &y);
+Bit greater_than(CircuitBuilder &b, const Bits &x, const Bits &y);
+Bit equal(CircuitBuilder &b, const Bits &x, const Bits &y);
+// s ? x : y, bitwise.
+Bits mux(CircuitBuilder &b, Bit s, const Bits &x, const Bits &y);
+} // namespace circuits
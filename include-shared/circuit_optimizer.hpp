@@ -0,0 +1,35 @@
+#pragma once
+
+#include "circuit.hpp"
+
+struct GateCounts {
+  int and_gates, xor_gates, not_gates;
+};
+GateCounts count_gates(const Circuit &circuit);
+
+/*
+ * Returns an equivalent circuit with constants folded, NOTs pushed through
+ * XORs and cancelled, repeated gates merged, gates that cannot reach an
+ * output removed, and wires renumbered densely. Inputs keep their wires and
+ * outputs stay the last output_length wires, so both parties can swap the
+ * result in for the original.
+ */
+Circuit optimize_circuit(const Circuit &circuit);
+
+/*
+ * Returns an equivalent circuit with fewer AND gates, the only gates that
+ * cost ciphertexts under free-XOR. Rewrites cones of up to three inputs
+ * (majority, full-adder carry, mux, ...) with a cheapest AND/XOR form of the
+ * same truth table when that frees more ANDs than it adds, for up to
+ * max_rounds rounds. Output is compacted as by optimize_circuit.
+ */
+Circuit minimize_and_gates(const Circuit &circuit, int max_rounds = 4);
+
+/*
+ * Returns a circuit computing only the given outputs of circuit, output i
+ * being circuit's output outputs[i]. Gates outside their backward cone are
+ * dropped and the rest simplified as by optimize_circuit; inputs keep their
+ * wires, so the same inputs run it.
+ * @throws error if an index is not an output of circuit.
+ */
+Circuit output_cone(const Circuit &circuit, const std::vector<int> &outputs);
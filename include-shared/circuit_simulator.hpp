@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "circuit.hpp"
+
+/*
+ * Plaintext evaluation, bit-sliced: bit k of every wire word belongs to
+ * input set k, so one pass over the gates evaluates 64 (run64) or 256
+ * (run256) independent input sets. Wires live in liveness slots, which keeps
+ * the working set cache resident. Safe to share between threads.
+ */
+class CircuitSimulator {
+public:
+  explicit CircuitSimulator(const Circuit &circuit);
+
+  // One input set; returns the output bits.
+  std::vector<int> run(const std::vector<int> &input) const;
+  // input[w] holds wire w for 64 sets; returns one word per output.
+  std::vector<uint64_t> run64(const std::vector<uint64_t> &input) const;
+  // input[4 * w + j] holds wire w for sets 64j..64j+63; outputs likewise.
+  std::vector<uint64_t> run256(const std::vector<uint64_t> &input) const;
+
+private:
+  int num_inputs, num_slots;
+  std::vector<Gate> ops; // gates with wires replaced by their slots
+  std::vector<int> output_slots;
+};
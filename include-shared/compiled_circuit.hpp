@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "circuit.hpp"
+
+/*
+ * Compiled circuit file, version 2. Integers are little endian and every
+ * section starts on a 64-byte boundary:
+ *   header    CompiledCircuitHeader
+ *   gates     num_gate Gate records {type, lhs, rhs, output}, 16 bytes each
+ *   levels    num_gate uint32 gate levels (compute_gate_levels)
+ *   last use  num_wire uint32 wire last uses (compute_wire_last_use)
+ * The checksum is SHA-256 over everything after the header. With
+ * COMPILED_SCHEDULED set, gates are in schedule_circuit order and the loader
+ * restores level_offsets from the levels section.
+ */
+const uint32_t COMPILED_SCHEDULED = 1;
+
+struct CompiledCircuitHeader {
+  char magic[8]; // "YAOSCIRC"
+  uint32_t version;
+  uint32_t header_size;
+  int32_t num_gate, num_wire, garbler_input_length, evaluator_input_length,
+      output_length;
+  uint32_t num_levels;
+  uint32_t flags;
+  uint64_t gates_offset, levels_offset, last_use_offset, file_size;
+  unsigned char checksum[32];
+};
+
+/*
+ * A compiled circuit mapped read-only. All views point into the mapping,
+ * which stays alive as long as any copy of `circuit` does.
+ */
+struct CompiledCircuit {
+  Circuit circuit;
+  uint32_t num_levels;
+  std::span<const uint32_t> gate_levels;
+  std::span<const uint32_t> wire_last_use;
+};
+
+void compile_circuit(const Circuit &circuit, std::string filename);
+CompiledCircuit load_compiled_circuit(std::string filename,
+                                      bool verify_checksum = true);
+bool is_compiled_circuit(std::string filename);
+
+// Load a Bristol or compiled circuit, picked by the file's magic bytes.
+Circuit load_circuit(std::string filename);
+// load_circuit, then schedule_circuit unless the file was already scheduled.
+Circuit load_scheduled_circuit(std::string filename);
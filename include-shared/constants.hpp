@@ -4,8 +4,13 @@
 #include <crypto++/integer.h>
 #include <crypto++/secblock.h>
 
-#define LABEL_LENGTH 16     /* 128 bits */
-#define LABEL_TAG_LENGTH 16 /* 128 bits */
+// Wire label width in bits, fixed at build time (-DYAOS_LABEL_BITS=80 for
+// shorter labels where 80-bit security will do). Both parties must agree.
+#ifndef YAOS_LABEL_BITS
+#define YAOS_LABEL_BITS 128
+#endif
+#define LABEL_LENGTH (YAOS_LABEL_BITS / 8)
+#define LABEL_TAG_LENGTH LABEL_LENGTH
 
 #define EG_KEYSIZE 1024
 
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * CPU features the kernels below can use, detected once. AVX flags are only
+ * set if the OS also saves the wider registers.
+ */
+struct CpuFeatures {
+  bool aes, avx2, avx512f, vaes;
+};
+const CpuFeatures &cpu_features();
+
+// AES-128 round keys, as expanded by Kernels::aes_expand.
+struct AesKey {
+  alignas(16) unsigned char round_keys[11][16];
+};
+
+/*
+ * One implementation of each hot loop. Every set gives the same results, so
+ * parties on different hosts interoperate whatever each one selects:
+ *   scalar  64-bit words; random bytes come from the OS, the garbling hash
+ *           from Crypto++'s AES
+ *   aesni   SSE2 XOR, AES-NI for the PRG and garbling hash
+ *   avx2    AVX2 XOR, AES-NI for the PRG and garbling hash
+ *   vaes    AVX-512 XOR, VAES encrypting four blocks per instruction
+ */
+struct Kernels {
+  const char *name;
+  // out[i] = a[i] ^ b[i] for n bytes; out may be a or b.
+  void (*xor_bytes)(unsigned char *out, const unsigned char *a,
+                    const unsigned char *b, size_t n);
+  // nullptr without AES instructions.
+  void (*aes_expand)(const unsigned char *key, AesKey &out);
+  // Encrypt n 16-byte blocks with AES-128; in may be out.
+  void (*aes_encrypt)(const AesKey &key, const unsigned char *in,
+                      unsigned char *out, size_t n);
+  // out[i] = AES(k, in[i]) ^ in[i] for n 16-byte blocks under a fixed,
+  // public key k; in and out must not overlap.
+  void (*aes_hash)(const unsigned char *in, unsigned char *out, size_t n);
+};
+
+// The selected kernels; on first use, the best the CPU supports.
+const Kernels &kernels();
+// Use the named kernels from now on, or the best again for "auto".
+// @throws error if the name is unknown or the CPU lacks its features.
+void select_kernels(const std::string &name);
+// Names of the kernel sets this CPU can run, best last.
+std::vector<std::string> supported_kernels();
+// The selection and CPU features, for logs.
+std::string describe_kernels();
+
+/*
+ * Fill out with n cryptographically random bytes: AES-128-CTR under a
+ * per-thread key from the OS, or the OS itself with the scalar kernels.
+ */
+void random_bytes(unsigned char *out, size_t n);
+
+/*
+ * The garbling hash: out_length <= 32 bytes of H(x, y) for labels x and y of
+ * label_length <= 16 bytes. With X and Y the labels zero-padded to 128 bits
+ * and doubling in GF(2^128), block j of the output is
+ *   AES(k, K ^ j) ^ K ^ j  where  K = 2X ^ 4Y
+ * under the fixed key of Kernels::aes_hash.
+ */
+void garbling_hash(const unsigned char *x, const unsigned char *y,
+                   size_t label_length, unsigned char *out, size_t out_length);
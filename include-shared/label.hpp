@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <crypto++/misc.h>
+
+#include "kernels.hpp"
+
+/*
+ * A wire label of Bits bits, held inline so its size is a compile-time
+ * constant. The low bit of the last byte is the point bit: delta always has
+ * it set, so the two labels of a wire differ in it.
+ */
+template <size_t Bits> struct Label {
+  static_assert(Bits % 8 == 0 && Bits >= 80 && Bits <= 128,
+                "labels are 80 to 128 bits in whole bytes");
+  static constexpr size_t LENGTH = Bits / 8;
+
+  std::array<unsigned char, LENGTH> bytes{};
+
+  Label() = default;
+  Label(const Label &) = default;
+  Label &operator=(const Label &) = default;
+  // Labels and delta are secret; wipe them as SecByteBlock would.
+  ~Label() { CryptoPP::SecureWipeArray(this->bytes.data(), LENGTH); }
+
+  unsigned char *data() { return this->bytes.data(); }
+  const unsigned char *data() const { return this->bytes.data(); }
+  static constexpr size_t size() { return LENGTH; }
+  int point_bit() const { return this->bytes[LENGTH - 1] & 0x01; }
+
+  static Label random() {
+    Label res;
+    random_bytes(res.data(), LENGTH);
+    return res;
+  }
+  // First LENGTH bytes of data.
+  static Label from_bytes(const unsigned char *data) {
+    Label res;
+    std::copy(data, data + LENGTH, res.bytes.begin());
+    return res;
+  }
+  // @throws error unless s is exactly LENGTH bytes.
+  static Label from_string(const std::string &s) {
+    if (s.size() != LENGTH) {
+      throw std::runtime_error("Label is " + std::to_string(s.size()) +
+                               " bytes, not " + std::to_string(LENGTH));
+    }
+    return from_bytes(reinterpret_cast<const unsigned char *>(s.data()));
+  }
+  std::string to_string() const {
+    return std::string(reinterpret_cast<const char *>(this->data()), LENGTH);
+  }
+
+  // Through the selected kernels, as every label XOR is on the hot path.
+  Label &operator^=(const Label &other) {
+    kernels().xor_bytes(this->data(), this->data(), other.data(), LENGTH);
+    return *this;
+  }
+  Label operator^(const Label &other) const {
+    Label res;
+    kernels().xor_bytes(res.data(), this->data(), other.data(), LENGTH);
+    return res;
+  }
+  // Constant time, as labels are secret.
+  bool operator==(const Label &other) const {
+    return CryptoPP::VerifyBufsEqual(this->data(), other.data(), LENGTH);
+  }
+};
+
+/*
+ * One entry of a garbled AND table: the output label followed by a tag of
+ * LENGTH zero bytes, XORed with garbling_hash(x, y) for input labels x and y.
+ */
+template <size_t Bits> struct TableEntry {
+  static constexpr size_t LENGTH = 2 * Label<Bits>::LENGTH;
+  static_assert(LENGTH <= 32, "garbling_hash yields at most two blocks");
+
+  std::array<unsigned char, LENGTH> bytes{};
+
+  TableEntry() = default;
+  TableEntry(const TableEntry &) = default;
+  TableEntry &operator=(const TableEntry &) = default;
+  // Pads and decryptions hold labels, so wipe entries too.
+  ~TableEntry() { CryptoPP::SecureWipeArray(this->bytes.data(), LENGTH); }
+
+  unsigned char *data() { return this->bytes.data(); }
+  const unsigned char *data() const { return this->bytes.data(); }
+  static constexpr size_t size() { return LENGTH; }
+
+  // The pad encrypting the entry under x and y.
+  static TableEntry pad(const Label<Bits> &x, const Label<Bits> &y) {
+    TableEntry res;
+    garbling_hash(x.data(), y.data(), x.size(), res.data(), LENGTH);
+    return res;
+  }
+  static TableEntry encrypt(const Label<Bits> &x, const Label<Bits> &y,
+                            const Label<Bits> &z) {
+    TableEntry res = pad(x, y);
+    kernels().xor_bytes(res.data(), res.data(), z.data(), z.size());
+    return res;
+  }
+  // First LENGTH bytes of data.
+  static TableEntry from_bytes(const unsigned char *data) {
+    TableEntry res;
+    std::copy(data, data + LENGTH, res.bytes.begin());
+    return res;
+  }
+
+  TableEntry operator^(const TableEntry &other) const {
+    TableEntry res;
+    kernels().xor_bytes(res.data(), this->data(), other.data(), LENGTH);
+    return res;
+  }
+  // Whether a decrypted entry ends in a zero tag.
+  bool tag_is_zero() const {
+    unsigned char tag = 0;
+    for (size_t i = Label<Bits>::LENGTH; i < LENGTH; i++)
+      tag |= this->bytes[i];
+    return tag == 0;
+  }
+  Label<Bits> label() const { return Label<Bits>::from_bytes(this->data()); }
+};
@@ -26,6 +26,8 @@ Possible severity levels (defined in trivial.hpp):
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/setup/file.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace logging = boost::log;
 namespace attrs = boost::log::attributes;
@@ -41,10 +43,17 @@ namespace keywords = boost::log::keywords;
           set_get_attrib("Line", __LINE__))(::boost::log::keywords::severity = \
                                                 (boost::log::trivial::sev)))
 
+// File/line attributes are shared by every thread that logs
+template <typename ValueType>
+using locked_mutable_constant =
+    attrs::mutable_constant<ValueType, boost::shared_mutex,
+                            boost::unique_lock<boost::shared_mutex>,
+                            boost::shared_lock<boost::shared_mutex>>;
+
 // Set attribute and return the new value
 template <typename ValueType>
 ValueType set_get_attrib(const char *name, ValueType value) {
-  auto attr = logging::attribute_cast<attrs::mutable_constant<ValueType>>(
+  auto attr = logging::attribute_cast<locked_mutable_constant<ValueType>>(
       logging::core::get()->get_global_attributes()[name]);
   attr.set(value);
   return attr.get();
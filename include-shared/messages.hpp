@@ -31,6 +31,11 @@ enum T {
   GarblerToEvaluator_GarblerInputs_Message = 7,
   EvaluatorToGarbler_FinalLabels_Message = 8,
   GarblerToEvaluator_FinalOutput_Message = 9,
+  ReceiverToSender_OTBatchPublicValues_Message = 10,
+  SenderToReceiver_OTBatchEncryptedValues_Message = 11,
+  GarblerToEvaluator_CircuitAnnouncement_Message = 12,
+  GarblerToEvaluator_StoredGarbling_Message = 13,
+  EvaluatorToGarbler_OutputQuery_Message = 14,
 };
 };
 MessageType::T get_message_type(std::vector<unsigned char> &data);
@@ -48,12 +53,18 @@ struct Serializable {
 int put_bool(bool b, std::vector<unsigned char> &data);
 int put_string(std::string s, std::vector<unsigned char> &data);
 int put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data);
+int put_label_length(std::vector<unsigned char> &data);
+int put_labels(const std::vector<GarbledWire> &labels,
+               std::vector<unsigned char> &data);
 
 // deserializers
 int get_bool(bool *b, std::vector<unsigned char> &data, int idx);
 int get_string(std::string *s, std::vector<unsigned char> &data, int idx);
 int get_integer(CryptoPP::Integer *i, std::vector<unsigned char> &data,
                 int idx);
+int get_label_length(std::vector<unsigned char> &data, int idx);
+int get_labels(std::vector<GarbledWire> *labels,
+               std::vector<unsigned char> &data, int idx);
 
 // ================================================
 // WRAPPERS
@@ -108,6 +119,22 @@ struct SenderToReceiver_OTEncryptedValues_Message : public Serializable {
   int deserialize(std::vector<unsigned char> &data);
 };
 
+// Batched OT: one sender public value for the whole batch, then one receiver
+// public value and one encrypted pair per transfer.
+struct ReceiverToSender_OTBatchPublicValues_Message : public Serializable {
+  std::vector<CryptoPP::SecByteBlock> public_values;
+
+  void serialize(std::vector<unsigned char> &data);
+  int deserialize(std::vector<unsigned char> &data);
+};
+
+struct SenderToReceiver_OTBatchEncryptedValues_Message : public Serializable {
+  std::vector<SenderToReceiver_OTEncryptedValues_Message> values;
+
+  void serialize(std::vector<unsigned char> &data);
+  int deserialize(std::vector<unsigned char> &data);
+};
+
 // ================================================
 // GARBLED CIRCUITS
 // ================================================
@@ -139,3 +166,42 @@ struct GarblerToEvaluator_FinalOutput_Message : public Serializable {
   void serialize(std::vector<unsigned char> &data);
   int deserialize(std::vector<unsigned char> &data);
 };
+
+// ================================================
+// SESSIONS
+// ================================================
+
+// Names the circuit of the next job in a session; an empty id ends the
+// session.
+struct GarblerToEvaluator_CircuitAnnouncement_Message : public Serializable {
+  std::string circuit_id;
+  std::string fingerprint;
+
+  void serialize(std::vector<unsigned char> &data);
+  int deserialize(std::vector<unsigned char> &data);
+};
+
+// ================================================
+// STORED GARBLINGS
+// ================================================
+
+// Names the garbling, made ahead of time, whose tables the evaluator should
+// load from disk instead of reading them off the channel.
+struct GarblerToEvaluator_StoredGarbling_Message : public Serializable {
+  std::string garbling_id;
+
+  void serialize(std::vector<unsigned char> &data);
+  int deserialize(std::vector<unsigned char> &data);
+};
+
+// ================================================
+// OUTPUT QUERIES
+// ================================================
+
+// Outputs the evaluator wants, by index; only their cone is garbled.
+struct EvaluatorToGarbler_OutputQuery_Message : public Serializable {
+  std::vector<int> outputs;
+
+  void serialize(std::vector<unsigned char> &data);
+  int deserialize(std::vector<unsigned char> &data);
+};
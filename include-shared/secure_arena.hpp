@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bytes a session arena maps at first; it grows by further chunks if needed.
+const size_t DEFAULT_ARENA_BYTES = 16 << 20;
+
+/*
+ * Memory for the short-lived buffers of a session, such as table entries
+ * and OT keys, which would otherwise each be a heap allocation. Chunks are
+ * page aligned, locked into RAM where the limit allows, kept out of core
+ * dumps, and mapped only on first use. Allocation bumps a pointer and
+ * nothing is freed on its own: an ArenaScope wipes and reclaims everything
+ * allocated in it when it ends. Not thread-safe; each session has its own.
+ */
+class SecureArena {
+public:
+  explicit SecureArena(size_t capacity = DEFAULT_ARENA_BYTES);
+  ~SecureArena();
+  SecureArena(const SecureArena &) = delete;
+  SecureArena &operator=(const SecureArena &) = delete;
+
+  // n bytes aligned to align, a power of two no larger than a page.
+  // @throws std::bad_alloc if no more memory can be mapped.
+  void *allocate(size_t n, size_t align);
+  size_t used() const;     // bytes allocated and not yet reclaimed
+  size_t capacity() const; // bytes mapped
+  bool locked() const;     // whether every chunk is locked into RAM
+
+  // Where allocation currently is, to rewind to.
+  struct Mark {
+    size_t chunk, offset;
+  };
+  Mark mark() const;
+  // Wipe everything allocated since mark and allocate from it again.
+  void rewind(Mark mark);
+
+  // The arena of the innermost ArenaScope on this thread, if any.
+  static SecureArena *current();
+
+private:
+  friend class ArenaScope;
+  struct Chunk {
+    unsigned char *base;
+    size_t size, used;
+    bool locked;
+  };
+  void add_chunk(size_t min_size);
+
+  size_t first_size;
+  std::vector<Chunk> chunks;
+  size_t active; // chunk allocated from
+};
+
+/*
+ * Makes arena current on this thread for its lifetime, then wipes and
+ * reclaims whatever was allocated from it meanwhile. Anything allocated in a
+ * scope must be gone before the scope ends, so declare the scope first.
+ */
+class ArenaScope {
+public:
+  explicit ArenaScope(SecureArena &arena);
+  ~ArenaScope();
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+  // Wipe and reclaim what was allocated so far, keeping the scope open.
+  void rewind();
+
+private:
+  SecureArena &arena;
+  SecureArena::Mark start;
+  SecureArena *previous;
+};
+
+// Wipe n bytes and free them from the heap, for allocations made outside
+// any scope.
+void wipe_and_free(void *p, size_t n);
+
+/*
+ * Allocator drawing from the arena current when it was made, or from the
+ * heap, wiping on free, outside any scope. Freeing into an arena does
+ * nothing; its scope reclaims the memory. Copies of a container draw from
+ * the arena current where they are made.
+ */
+template <class T> struct ArenaAllocator {
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  SecureArena *arena;
+
+  ArenaAllocator() : arena(SecureArena::current()) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    if (this->arena != nullptr)
+      return static_cast<T *>(this->arena->allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    if (this->arena == nullptr)
+      wipe_and_free(p, n * sizeof(T));
+  }
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+
+  template <class U> bool operator==(const ArenaAllocator<U> &other) const {
+    return this->arena == other.arena;
+  }
+  template <class U> bool operator!=(const ArenaAllocator<U> &other) const {
+    return this->arena != other.arena;
+  }
+};
+
+template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
@@ -40,3 +41,19 @@ std::vector<std::string> string_split(std::string str, char delimiter);
 
 // Input parser.
 std::vector<int> parse_input(std::string input_file);
+// Session jobs, one "[<circuit file>] <input>" per line, as (circuit, input);
+// lines without a circuit run default_circuit.
+std::vector<std::pair<std::string, std::vector<int>>>
+parse_session_jobs(std::string jobs_file, std::string default_circuit);
+
+// Read-only mapping of a whole file, unmapped on destruction.
+class MappedFile {
+public:
+  MappedFile(const std::string &filename);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const unsigned char *data;
+  size_t size;
+};
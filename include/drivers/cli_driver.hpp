@@ -3,6 +3,9 @@
 #include <cstdlib>
 #include <string>
 #include <sys/ioctl.h>
+#include <vector>
+
+#include "../../include-shared/bit_vector.hpp"
 
 class CLIDriver {
 public:
@@ -18,3 +21,8 @@ public:
 private:
   struct winsize size;
 };
+
+std::string format_output(const BitVector &output, bool hex);
+std::string format_output(const std::string &output, bool hex);
+void print_batch(const std::vector<BitVector> &outputs, double seconds,
+                 bool hex);
@@ -21,14 +21,29 @@ class NetworkDriverImpl : public NetworkDriver {
 public:
   NetworkDriverImpl();
   void listen(int port);
+  virtual void accept(boost::asio::ip::tcp::acceptor &acceptor);
   void connect(std::string address, int port);
   void disconnect();
   void send(std::vector<unsigned char> data);
   std::vector<unsigned char> read();
   std::string get_remote_info();
 
-private:
+protected:
   int port;
   boost::asio::io_context io_context;
   std::shared_ptr<boost::asio::ip::tcp::socket> socket;
 };
+
+/*
+ * Listens once and hands out a connected driver per incoming connection, for
+ * servers that talk to many peers.
+ */
+class NetworkListener {
+public:
+  NetworkListener(int port);
+  void accept(std::shared_ptr<NetworkDriverImpl> network_driver);
+
+private:
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor;
+};
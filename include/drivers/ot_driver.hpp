@@ -23,6 +23,7 @@
 #include <crypto++/rijndael.h>
 #include <crypto++/sha.h>
 
+#include "../../include-shared/bit_vector.hpp"
 #include "../../include-shared/messages.hpp"
 #include "../../include/drivers/cli_driver.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
@@ -36,6 +37,9 @@ public:
 
   void OT_send(std::string m0, std::string m1);
   std::string OT_recv(int choice_bit);
+  void OT_send_batch(
+      const std::vector<std::pair<std::string, std::string>> &messages);
+  std::vector<std::string> OT_recv_batch(const BitVector &choice_bits);
 
 private:
   std::shared_ptr<CryptoDriver> crypto_driver;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../include/drivers/network_driver.hpp"
+
+/*
+ * Single-producer/single-consumer byte ring. `head` and `tail` count the total
+ * number of bytes ever written and consumed, so the fill level is
+ * `head - tail` and neither side ever needs a lock. Lives in shared memory;
+ * the ring buffer itself follows the struct.
+ */
+struct ShmRing {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> closed;
+  uint64_t capacity;
+};
+
+/*
+ * Layout of the shared segment: a small header followed by two rings, one per
+ * direction. The listener writes into rings[0], the connector into rings[1].
+ * `owner_pid` lets a later listener tell a live segment from a crashed one.
+ */
+struct ShmSegment {
+  std::atomic<uint32_t> state;
+  int32_t owner_pid;
+  uint64_t ring_capacity;
+};
+
+class SharedMemoryNetworkDriver : public NetworkDriver {
+public:
+  static const size_t DEFAULT_RING_CAPACITY = 1 << 22; /* 4 MiB */
+
+  SharedMemoryNetworkDriver(size_t ring_capacity = DEFAULT_RING_CAPACITY);
+  ~SharedMemoryNetworkDriver();
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(std::vector<unsigned char> data);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+private:
+  void map_segment(int fd, bool create);
+  void remove_stale_segment();
+  ShmRing *ring(int idx);
+  void write_bytes(const unsigned char *src, size_t len);
+  void read_bytes(unsigned char *dst, size_t len);
+
+  std::string name;
+  size_t ring_capacity;
+  size_t segment_size;
+  void *segment;
+  ShmRing *tx;
+  ShmRing *rx;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../include/drivers/network_driver.hpp"
+
+/*
+ * Link parameters for WanEmulatedNetworkDriver. Zero disables a parameter.
+ */
+struct WanProfile {
+  double latency_ms = 0;     // one-way delay added to every message
+  double jitter_ms = 0;      // delay varies uniformly by +/- this much
+  double bandwidth_mbit = 0; // sustained rate in megabits per second
+  size_t burst_bytes = 64 * 1024; // bytes that may go out back to back
+};
+
+/*
+ * Wraps another driver and makes its outgoing direction behave like a slow
+ * link. Sends are paced by a token bucket (the caller blocks while the link
+ * is busy, as with a full socket buffer), then held back for the latency and
+ * handed to the wrapped driver by a delivery thread in send order. Reads are
+ * passed straight through, so both peers should wrap with the same profile.
+ */
+class WanEmulatedNetworkDriver : public NetworkDriver {
+public:
+  WanEmulatedNetworkDriver(std::shared_ptr<NetworkDriver> inner,
+                           WanProfile profile);
+  ~WanEmulatedNetworkDriver();
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(std::vector<unsigned char> data);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Delivery {
+    Clock::time_point due;
+    std::vector<unsigned char> data;
+  };
+
+  Clock::time_point take_tokens(size_t bytes);
+  void deliver();
+  void stop();
+
+  std::shared_ptr<NetworkDriver> inner;
+  WanProfile profile;
+
+  // Token bucket, in bytes; may go negative while a large message drains.
+  double tokens;
+  Clock::time_point refilled;
+  std::mt19937_64 jitter_rng;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Delivery> queue;
+  Clock::time_point last_due;
+  bool stopping;
+  std::exception_ptr error;
+  std::thread delivery_thread;
+};
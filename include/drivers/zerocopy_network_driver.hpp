@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "../../include/drivers/network_driver.hpp"
+
+/*
+ * TCP driver that hands large payloads to the kernel with MSG_ZEROCOPY, so
+ * the pages are transmitted straight from our buffer instead of being copied
+ * into the socket. A buffer stays owned (and pinned) by the driver until the
+ * kernel reports completion on the socket error queue. Payloads below the
+ * threshold, length prefixes and all reads use the regular TCP path. Falls
+ * back to the regular path where the kernel lacks SO_ZEROCOPY.
+ */
+class ZeroCopyNetworkDriver : public NetworkDriverImpl {
+public:
+  static const size_t DEFAULT_THRESHOLD = 64 * 1024;
+
+  ZeroCopyNetworkDriver(size_t threshold = DEFAULT_THRESHOLD);
+  ~ZeroCopyNetworkDriver();
+  void listen(int port);
+  void accept(boost::asio::ip::tcp::acceptor &acceptor);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(std::vector<unsigned char> data);
+  // Whether the kernel took SO_ZEROCOPY, so large payloads skip the copy.
+  bool using_zerocopy() const { return this->zerocopy_enabled; }
+
+private:
+  struct PendingSend {
+    uint32_t first_id;
+    uint32_t last_id;
+    uint32_t outstanding; // notifications still expected
+    bool sending;         // send() is still handing it to the kernel
+    std::vector<unsigned char> buffer;
+  };
+
+  void enable_zerocopy();
+  bool has_outstanding() const;
+  bool reap_completions(bool wait);
+
+  size_t threshold;
+  bool zerocopy_enabled;
+  uint32_t next_id; // id the kernel assigns to our next zerocopy send
+  std::list<PendingSend> pending;
+};
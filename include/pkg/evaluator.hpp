@@ -1,26 +1,59 @@
 #pragma once
 
+#include <optional>
+
 #include "../../include-shared/circuit.hpp"
 #include "../../include/drivers/cli_driver.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
 #include "../../include/drivers/network_driver.hpp"
 #include "../../include/drivers/ot_driver.hpp"
 
+struct SpecializedCircuit;
+
 class EvaluatorClient {
 public:
   EvaluatorClient(Circuit circuit,
                   std::shared_ptr<NetworkDriver> network_driver,
                   std::shared_ptr<CryptoDriver> crypto_driver);
+  EvaluatorClient(std::shared_ptr<const Circuit> circuit,
+                  std::shared_ptr<NetworkDriver> network_driver,
+                  std::shared_ptr<CryptoDriver> crypto_driver);
   std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> HandleKeyExchange();
-  std::string run(std::vector<int> input);
-  GarbledWire evaluate_gate(GarbledGate gate, GarbledWire lhs, GarbledWire rhs);
-  bool verify_decryption(CryptoPP::SecByteBlock decryption);
-  CryptoPP::SecByteBlock snip_decryption(CryptoPP::SecByteBlock decryption);
+  void use_session_keys(
+      std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> keys,
+      std::shared_ptr<OTDriver> ot_driver);
+  std::string run(const BitVector &input);
+  std::vector<BitVector> run_batch(const std::vector<BitVector> &inputs);
+  std::string run_query(const BitVector &input, std::vector<int> outputs);
+  void set_instances_per_pass(int k);
+  void set_specialized(bool enabled);
+  std::string run_stored(std::string table_file, const BitVector &input);
+  std::string run_reactive(const BitVector &input, const JobWiring &wiring,
+                           KeptLabels &kept);
+  GarbledWire evaluate_gate(const GarbledGate &gate, const GarbledWire &lhs,
+                            const GarbledWire &rhs);
+  bool verify_decryption(const GateEntry &decryption);
+  WireLabel snip_decryption(const GateEntry &decryption);
 
 private:
+  std::vector<GarbledWire>
+  evaluate_circuit(const std::vector<GarbledGate> &garbled_tables,
+                   std::vector<GarbledWire> &wires);
+  std::vector<GarbledWire> read_instance(CryptoPP::SecByteBlock AES_key,
+                                         CryptoPP::SecByteBlock HMAC_key,
+                                         std::vector<GarbledGate> &tables);
+
   Circuit circuit;
+  WireSlots slots;
+  const SpecializedCircuit *specialized; // generated code for circuit, if any
+  int instances_per_pass; // batch instances evaluated per pass over the gates
   std::shared_ptr<NetworkDriver> network_driver;
   std::shared_ptr<CryptoDriver> crypto_driver;
   std::shared_ptr<OTDriver> ot_driver;
+  // Keys agreed earlier on this channel; run skips key exchange if set.
+  std::optional<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>>
+      session_keys;
   std::shared_ptr<CLIDriver> cli_driver;
+  // Backs each run's short-lived buffers; every run opens a scope on it.
+  std::shared_ptr<SecureArena> arena;
 };
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <crypto++/secblock.h>
+#include <crypto++/sha.h>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/util.hpp"
+
+/*
+ * Garbled table file, version 4: one garbling of a circuit made ahead of
+ * time and shipped to the evaluator. Integers are little endian and every
+ * section starts on a 64-byte boundary:
+ *   header   GarbledTableHeader
+ *   tables   num_and AND tables in gate order, 4 entries of
+ *            2 * label_length bytes each
+ *   decode   output_length bytes, the point bit of each output's zero label
+ * fingerprint ties the file to one circuit and gate order, garbling_id
+ * (SHA-256 of the seed) to the key the garbler kept. The checksum is SHA-256
+ * over everything after the header, then the header with checksum zeroed.
+ *
+ * A garbling is good for one run only: running it again on other inputs
+ * gives away both labels of some input wires. The garbler deletes the key
+ * file before sending any labels, so a second run finds no key.
+ */
+struct GarbledTableHeader {
+  char magic[8]; // "YAOSGTAB"
+  uint32_t version;
+  uint32_t header_size;
+  int32_t num_gate, num_and, output_length;
+  uint32_t label_length; // bytes, LABEL_LENGTH of the build that wrote it
+  unsigned char fingerprint[32];
+  unsigned char garbling_id[32];
+  uint64_t tables_offset, decode_offset, file_size;
+  unsigned char checksum[32];
+};
+
+/*
+ * What the garbler keeps of a stored garbling: the seed its input labels
+ * and delta are derived from, and the zero labels of the outputs to decode
+ * with. Secret; never ship it with the tables.
+ */
+struct GarblingKey {
+  std::string fingerprint; // hex, as circuit_fingerprint
+  CryptoPP::SecByteBlock seed;
+  std::vector<GarbledWire> output_zeros;
+};
+
+const int GARBLING_SEED_LENGTH = 32;
+
+GarblingKey new_garbling_key(const Circuit &circuit);
+void write_garbling_key(const GarblingKey &key, std::string filename);
+GarblingKey load_garbling_key(std::string filename);
+// Delete filename so its garbling cannot run again. Call before sending any
+// labels. @throws error if the key is already gone or cannot be deleted.
+void use_up_garbling_key(std::string filename);
+// Hex SHA-256 of the seed, naming the garbling without giving it away.
+std::string garbling_id(const CryptoPP::SecByteBlock &seed);
+
+/*
+ * Input labels and delta of a stored garbling, in their slots. Zero label i
+ * is the first LABEL_LENGTH bytes of SHA-256(seed || "label" || i) and delta
+ * those of SHA-256(seed || "delta") with the point bit set, so the garbler
+ * can rebuild them from the seed when the evaluator comes online.
+ */
+GarbledLabels derive_input_labels(const Circuit &circuit,
+                                  const WireSlots &slots,
+                                  const CryptoPP::SecByteBlock &seed);
+
+/*
+ * Writes a garbled table file as tables are garbled, so they never all have
+ * to be in memory. The header goes in last, on finish.
+ */
+class GarbledTableWriter {
+public:
+  GarbledTableWriter(std::string filename, const Circuit &circuit,
+                     std::string garbling_id);
+  // Appends the AND tables among tables; tables of other gates are empty.
+  void write(const std::vector<GarbledGate> &tables);
+  // Writes the decode section from the output zero labels, then the header.
+  void finish(const std::vector<GarbledWire> &output_zeros);
+
+private:
+  std::string filename;
+  std::ofstream out;
+  GarbledTableHeader header;
+  CryptoPP::SHA256 hash;
+  uint64_t offset; // bytes written so far
+};
+
+/*
+ * A garbled table file mapped read-only. Tables stay on disk and are paged
+ * in as evaluation reaches them; the views live as long as `file`.
+ */
+struct GarbledTableFile {
+  std::shared_ptr<const MappedFile> file;
+  std::string fingerprint; // hex
+  std::string garbling_id; // hex
+  int num_and;
+  const unsigned char *tables;
+  std::span<const unsigned char> decode;
+};
+
+GarbledTableFile load_garbled_tables(std::string filename,
+                                     bool verify_checksum = true);
+
+/*
+ * Evaluate circuit with the tables in stored, starting from the input labels
+ * in wires, the garbler's then the evaluator's. Returns the output labels.
+ * @throws error if stored was garbled for another circuit, or no entry of an
+ * AND table decrypts under its input labels.
+ */
+std::vector<GarbledWire> evaluate_stored(const Circuit &circuit,
+                                         const WireSlots &slots,
+                                         const GarbledTableFile &stored,
+                                         const std::vector<GarbledWire> &wires);
+
+// Output bits of the final labels under the file's decode section.
+std::string decode_stored(const GarbledTableFile &stored,
+                          const std::vector<GarbledWire> &final_labels);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+struct GarbledPoolConfig {
+  int capacity = 4;              // garbled circuits kept ready
+  int refill_threads = 1;        // background garbling threads
+  double refill_per_second = 0;  // cap on garblings per second, 0 for none
+};
+
+/*
+ * Offline garbling. Background threads keep up to capacity garblings of one
+ * circuit ready, so a session only pays for key exchange, OT and transfer.
+ * Each garbling is handed out once. Thread-safe.
+ */
+class GarbledCircuitPool {
+public:
+  GarbledCircuitPool(std::shared_ptr<const Circuit> circuit,
+                     GarbledPoolConfig config);
+  ~GarbledCircuitPool();
+  GarbledCircuitPool(const GarbledCircuitPool &) = delete;
+  GarbledCircuitPool &operator=(const GarbledCircuitPool &) = delete;
+
+  // A ready garbling, or one garbled on the caller's thread if none is.
+  GarbledCircuit take();
+  // Garblings currently ready.
+  int ready_count();
+  // Fingerprint of the circuit this pool garbles.
+  const std::string &get_fingerprint() const;
+
+private:
+  void refill_loop();
+  void stop();
+
+  std::shared_ptr<const Circuit> circuit;
+  std::string fingerprint;
+  GarbledPoolConfig config;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<GarbledCircuit> ready;
+  int in_progress; // garblings started but not yet ready
+  bool stopping;
+  std::chrono::steady_clock::time_point next_start; // for refill_per_second
+  std::vector<std::thread> threads;
+};
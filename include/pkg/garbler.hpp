@@ -1,30 +1,82 @@
 #pragma once
 
+#include <optional>
+
 #include "../../include-shared/circuit.hpp"
 #include "../../include/drivers/cli_driver.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
 #include "../../include/drivers/network_driver.hpp"
 #include "../../include/drivers/ot_driver.hpp"
 
+struct SpecializedCircuit;
+class GarbledCircuitPool;
+
+/*
+ * One garbling of a circuit: the tables to send and the labels the session
+ * needs afterwards (input and output slots). Never reuse one across sessions.
+ */
+struct GarbledCircuit {
+  GarbledLabels labels;
+  std::vector<GarbledGate> tables;
+};
+
 class GarblerClient {
 public:
   GarblerClient(Circuit circuit, std::shared_ptr<NetworkDriver> network_driver,
                 std::shared_ptr<CryptoDriver> crypto_driver);
+  GarblerClient(std::shared_ptr<const Circuit> circuit,
+                std::shared_ptr<NetworkDriver> network_driver,
+                std::shared_ptr<CryptoDriver> crypto_driver);
   std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> HandleKeyExchange();
-  std::string run(std::vector<int> input);
-  GarbledLabels generate_labels(Circuit circuit);
-  std::vector<GarbledGate> generate_gates(Circuit circuit,
-                                          GarbledLabels labels);
-  CryptoPP::SecByteBlock encrypt_label(GarbledWire lhs, GarbledWire rhs,
-                                       GarbledWire output);
-  CryptoPP::SecByteBlock generate_label();
-  std::vector<GarbledWire> get_garbled_wires(GarbledLabels labels,
-                                             std::vector<int> input, int begin);
+  void use_session_keys(
+      std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> keys,
+      std::shared_ptr<OTDriver> ot_driver);
+  void use_session_delta(WireLabel delta);
+  std::string run(const BitVector &input);
+  std::vector<BitVector> run_batch(const std::vector<BitVector> &inputs);
+  std::string run_query(const BitVector &input);
+  void set_instances_per_pass(int k);
+  void set_specialized(bool enabled);
+  std::string run_reactive(const BitVector &input, const JobWiring &wiring,
+                           KeptLabels &kept);
+  void garble_to_file(std::string table_file, std::string key_file);
+  std::string run_stored(std::string key_file, const BitVector &input);
+  void set_pool(std::shared_ptr<GarbledCircuitPool> pool);
+  GarbledCircuit garble();
+  GarbledLabels generate_labels(const Circuit &circuit,
+                                const WireSlots &slots);
+  std::vector<GarbledGate> generate_gates(const Circuit &circuit,
+                                          const WireSlots &slots,
+                                          GarbledLabels &labels);
+  GateEntry encrypt_label(const GarbledWire &lhs, const GarbledWire &rhs,
+                          const GarbledWire &output);
+  WireLabel generate_label();
+  WireLabel generate_delta();
+  std::vector<GarbledWire> get_garbled_wires(const GarbledLabels &labels,
+                                             const BitVector &input,
+                                             int begin);
 
 private:
-  Circuit circuit;
+  GarbledLabels output_labels(const GarbledLabels &labels);
+  std::string decode_output(const GarbledLabels &outputs,
+                            const std::vector<GarbledWire> &final_labels,
+                            int begin);
+
+  // Read-only, so one parsed circuit can back many concurrent sessions.
+  std::shared_ptr<const Circuit> circuit;
+  WireSlots slots;
+  const SpecializedCircuit *specialized; // generated code for circuit, if any
+  int instances_per_pass; // batch instances garbled per pass over the gates
+  std::shared_ptr<GarbledCircuitPool> pool; // pre-garbled circuits, if any
   std::shared_ptr<NetworkDriver> network_driver;
   std::shared_ptr<CryptoDriver> crypto_driver;
   std::shared_ptr<OTDriver> ot_driver;
+  // Keys agreed earlier on this channel; run skips key exchange if set.
+  std::optional<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>>
+      session_keys;
+  // Free-XOR offset shared by every job of a session, so labels carry over.
+  std::optional<WireLabel> session_delta;
   std::shared_ptr<CLIDriver> cli_driver;
+  // Backs each run's short-lived buffers; every run opens a scope on it.
+  std::shared_ptr<SecureArena> arena;
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include/drivers/network_driver.hpp"
+#include "../../include/pkg/garbled_pool.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+/*
+ * Long-running garbler. Accepts evaluator connections on one port and serves
+ * each in its own session (fresh keys, fresh GarblerClient) on a thread pool.
+ * The parsed circuit and the garbler's input are shared by all sessions, as
+ * is the pool of pre-garbled circuits if one is given.
+ */
+class GarblerServer {
+public:
+  GarblerServer(std::shared_ptr<const Circuit> circuit, BitVector input,
+                int num_threads,
+                std::shared_ptr<GarbledCircuitPool> garbled_pool = nullptr);
+  void serve(int port,
+             std::function<std::shared_ptr<NetworkDriverImpl>()> make_driver =
+                 [] { return std::make_shared<NetworkDriverImpl>(); },
+             int max_sessions = 0);
+
+private:
+  void run_session(std::shared_ptr<NetworkDriver> network_driver,
+                   int session_id);
+
+  std::shared_ptr<const Circuit> circuit;
+  BitVector input;
+  int num_threads;
+  std::shared_ptr<GarbledCircuitPool> garbled_pool;
+  boost::asio::thread_pool pool;
+
+  // Sessions in flight; accepting stops while every worker is busy.
+  std::mutex active_mutex;
+  std::condition_variable active_cv;
+  int active_sessions;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "../../include-shared/circuit.hpp"
+
+/*
+ * Garbling and evaluation of k independent instances of one circuit in one
+ * pass over its gates. Labels of a slot are stored for all k instances back
+ * to back, so XOR and NOT gates run over k * LABEL_LENGTH contiguous bytes
+ * and each gate is decoded and dispatched once per k instances. Tables have
+ * the same format as generate_gates', so the two sides need not agree on k.
+ */
+
+// k used by batch runs unless set otherwise.
+const int DEFAULT_INSTANCES_PER_PASS = 8;
+
+/*
+ * Garble labels.size() instances. Each labels[j] comes from generate_labels,
+ * with its input labels and delta set; output labels are written into its
+ * slots as generate_gates does. Returns the tables of each instance.
+ */
+std::vector<std::vector<GarbledGate>>
+garble_instances(const Circuit &circuit, const WireSlots &slots,
+                 const std::vector<GarbledLabels *> &labels);
+
+/*
+ * Evaluate tables.size() instances from their input labels, the garbler's
+ * then the evaluator's. Returns the output labels of each instance.
+ * @throws error if an instance's tables or inputs do not fit the circuit, or
+ * no entry of an AND table decrypts under its input labels.
+ */
+std::vector<std::vector<GarbledWire>>
+evaluate_instances(const Circuit &circuit, const WireSlots &slots,
+                   const std::vector<const std::vector<GarbledGate> *> &tables,
+                   const std::vector<std::vector<GarbledWire>> &inputs);
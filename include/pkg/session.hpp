@@ -0,0 +1,124 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include/drivers/crypto_driver.hpp"
+#include "../../include/drivers/network_driver.hpp"
+#include "../../include/drivers/ot_driver.hpp"
+#include "../../include/pkg/evaluator.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+/*
+ * The circuits a session can run, by id, and the client made for each one on
+ * its first job and kept for the jobs after it.
+ */
+template <typename Client> class SessionCircuits {
+public:
+  /**
+   * Make circuit available to jobs as id, replacing any circuit and client
+   * already there.
+   */
+  void add(std::string id, std::shared_ptr<const Circuit> circuit) {
+    if (id.empty()) {
+      throw std::runtime_error("Circuit ids cannot be empty.");
+    }
+    this->circuits[id] = circuit;
+    this->clients.erase(id);
+  }
+
+  /**
+   * Circuit added as id.
+   */
+  const Circuit &at(const std::string &id) const {
+    return *this->circuits.at(id);
+  }
+
+  /**
+   * Client for id, created on first use.
+   * @throws error if no circuit was added as id.
+   */
+  Client &client(const std::string &id,
+                 std::shared_ptr<NetworkDriver> network_driver,
+                 std::shared_ptr<CryptoDriver> crypto_driver) {
+    auto it = this->clients.find(id);
+    if (it != this->clients.end()) {
+      return *it->second;
+    }
+    auto circuit = this->circuits.find(id);
+    if (circuit == this->circuits.end()) {
+      throw std::runtime_error("Unknown circuit " + id + ".");
+    }
+    auto client =
+        std::make_unique<Client>(circuit->second, network_driver, crypto_driver);
+    return *(this->clients[id] = std::move(client));
+  }
+
+private:
+  std::map<std::string, std::shared_ptr<const Circuit>> circuits;
+  std::map<std::string, std::unique_ptr<Client>> clients;
+};
+
+/*
+ * A connection that runs a stream of jobs, each one circuit on fresh inputs.
+ * Keys are exchanged before the first job and kept, along with the OT driver
+ * and one client per circuit (slot layout, generated code), for every job
+ * after it. Both parties register the same circuits under the same ids and
+ * run the same jobs in the same order; before each job the garbler announces
+ * the circuit's id and fingerprint and the evaluator checks them.
+ *
+ * Jobs given a JobWiring are reactive: chosen outputs stay as labels, kept by
+ * the session under a name, and later jobs take them as inputs without
+ * decoding or OT. Every circuit of a session is garbled with one delta so
+ * kept labels stay valid. Values stay hidden from both parties unless a
+ * later job reveals them.
+ */
+class GarblerSession {
+public:
+  GarblerSession(std::shared_ptr<NetworkDriver> network_driver,
+                 std::shared_ptr<CryptoDriver> crypto_driver);
+  void add_circuit(std::string id, std::shared_ptr<const Circuit> circuit);
+  std::string run_job(const std::string &circuit_id, const BitVector &input);
+  std::string run_job(const std::string &circuit_id, const BitVector &input,
+                      const JobWiring &wiring);
+  void close();
+
+private:
+  GarblerClient &start_job(const std::string &circuit_id);
+
+  std::shared_ptr<NetworkDriver> network_driver;
+  std::shared_ptr<CryptoDriver> crypto_driver;
+  SessionCircuits<GarblerClient> circuits;
+  std::optional<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>>
+      keys;
+  std::shared_ptr<OTDriver> ot_driver;
+  WireLabel delta;
+  KeptLabels kept;
+};
+
+class EvaluatorSession {
+public:
+  EvaluatorSession(std::shared_ptr<NetworkDriver> network_driver,
+                   std::shared_ptr<CryptoDriver> crypto_driver);
+  void add_circuit(std::string id, std::shared_ptr<const Circuit> circuit);
+  std::string run_job(const std::string &circuit_id, const BitVector &input);
+  std::string run_job(const std::string &circuit_id, const BitVector &input,
+                      const JobWiring &wiring);
+  void close();
+
+private:
+  EvaluatorClient &start_job(const std::string &circuit_id);
+  GarblerToEvaluator_CircuitAnnouncement_Message read_announcement();
+
+  std::shared_ptr<NetworkDriver> network_driver;
+  std::shared_ptr<CryptoDriver> crypto_driver;
+  SessionCircuits<EvaluatorClient> circuits;
+  std::optional<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>>
+      keys;
+  std::shared_ptr<OTDriver> ot_driver;
+  KeptLabels kept;
+};
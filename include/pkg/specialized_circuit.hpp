@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <crypto++/misc.h>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
+#include "../../include/pkg/evaluator.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+// ================================================
+// PER-GATE KERNELS
+// ================================================
+
+/*
+ * State for garbling one circuit; wire arguments below are label slots.
+ */
+struct GarbleContext {
+  GarblerClient &garbler;
+  GarbledLabels &labels;
+  std::vector<GarbledGate> &tables;
+};
+
+/*
+ * State for evaluating one circuit; gate is the index into tables.
+ */
+struct EvaluateContext {
+  EvaluatorClient &evaluator;
+  const std::vector<GarbledGate> &tables;
+  std::vector<GarbledWire> &wires;
+};
+
+/*
+ * Garble one gate: create the output labels in slot out and append its table.
+ * XOR outputs are lhs ^ rhs and NOT outputs swap lhs's labels, so neither
+ * needs a table. Shared by the generic loop and generated circuits.
+ */
+template <GateType::T Type>
+inline void garble_kernel(GarbleContext &ctx, int lhs, int rhs, int out) {
+  GarbledLabels &labels = ctx.labels;
+  GarbledWire z0, z1;
+  if constexpr (Type == GateType::XOR_GATE) {
+    z0.value = labels.zeros[lhs].value ^ labels.zeros[rhs].value;
+  } else if constexpr (Type == GateType::NOT_GATE) {
+    z0.value = labels.ones[lhs].value;
+  } else {
+    z0.value = ctx.garbler.generate_label();
+  }
+  z1.value = z0.value ^ labels.delta;
+
+  GarbledGate table;
+  if constexpr (Type == GateType::AND_GATE) {
+    const GarbledWire &x0 = labels.zeros[lhs], &x1 = labels.ones[lhs];
+    const GarbledWire &y0 = labels.zeros[rhs], &y1 = labels.ones[rhs];
+    table.entries = {ctx.garbler.encrypt_label(x0, y0, z0),
+                     ctx.garbler.encrypt_label(x0, y1, z0),
+                     ctx.garbler.encrypt_label(x1, y0, z0),
+                     ctx.garbler.encrypt_label(x1, y1, z1)};
+    // One engine per thread since sessions garble concurrently.
+    static thread_local std::mt19937 shuffle_rng{std::random_device{}()};
+    std::shuffle(table.entries.begin(), table.entries.end(), shuffle_rng);
+  }
+  ctx.tables.push_back(std::move(table));
+  labels.zeros[out] = std::move(z0);
+  labels.ones[out] = std::move(z1);
+}
+
+/*
+ * Garble gate with the kernel for its type, mapping wires to slots.
+ */
+inline void garble_gate(GarbleContext &ctx, const WireSlots &slots,
+                        const Gate &gate) {
+  int lhs = slots.slot[gate.lhs];
+  int out = slots.slot[gate.output];
+  switch (gate.type) {
+  case GateType::AND_GATE:
+    garble_kernel<GateType::AND_GATE>(ctx, lhs, slots.slot[gate.rhs], out);
+    break;
+  case GateType::XOR_GATE:
+    garble_kernel<GateType::XOR_GATE>(ctx, lhs, slots.slot[gate.rhs], out);
+    break;
+  case GateType::NOT_GATE:
+    garble_kernel<GateType::NOT_GATE>(ctx, lhs, lhs, out);
+    break;
+  default:
+    throw std::runtime_error("Invalid gate type! Aborted.");
+  }
+}
+
+/*
+ * Evaluate one gate into slot out.
+ */
+template <GateType::T Type>
+inline void evaluate_kernel(EvaluateContext &ctx, int gate, int lhs, int rhs,
+                            int out) {
+  std::vector<GarbledWire> &wires = ctx.wires;
+  if constexpr (Type == GateType::AND_GATE) {
+    wires[out] =
+        ctx.evaluator.evaluate_gate(ctx.tables[gate], wires[lhs], wires[rhs]);
+  } else if constexpr (Type == GateType::XOR_GATE) {
+    wires[out].value = wires[lhs].value ^ wires[rhs].value;
+  } else {
+    wires[out] = wires[lhs];
+  }
+}
+
+// ================================================
+// SPECIALIZED CIRCUITS
+// ================================================
+
+/*
+ * Straight-line garble and evaluate functions for one circuit, emitted by
+ * circuit_codegen with gate types and slots baked in. Generated files
+ * register themselves at startup; the clients pick one up when the circuit
+ * they are given has the same fingerprint.
+ */
+struct SpecializedCircuit {
+  std::string fingerprint;
+  void (*garble)(GarbleContext &ctx);
+  void (*evaluate)(EvaluateContext &ctx);
+};
+
+struct SpecializedCircuitRegistration {
+  SpecializedCircuitRegistration(SpecializedCircuit specialized);
+};
+
+// nullptr if no generated code matches the circuit.
+const SpecializedCircuit *find_specialized_circuit(const Circuit &circuit);
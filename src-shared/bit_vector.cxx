@@ -0,0 +1,272 @@
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "../include-shared/bit_vector.hpp"
+
+static_assert(std::endian::native == std::endian::little,
+              "binary inputs are stored little endian");
+
+namespace {
+const char MAGIC[8] = {'Y', 'A', 'O', 'S', 'B', 'I', 'T', 'S'};
+const uint32_t VERSION = 1;
+
+struct BinaryInputHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t width, count;
+};
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+} // namespace
+
+BitVector::BitVector() : num_bits(0) {}
+
+BitVector::BitVector(size_t num_bits)
+    : words((num_bits + 63) / 64, 0), num_bits(num_bits) {}
+
+/**
+ * @throws error if a value is neither 0 nor 1.
+ */
+BitVector::BitVector(const std::vector<int> &bits) : BitVector(bits.size()) {
+  for (size_t i = 0; i < bits.size(); i++) {
+    if (bits[i] != 0 && bits[i] != 1) {
+      throw std::runtime_error("Input bit " + std::to_string(i) +
+                               " is not 0 or 1.");
+    }
+    this->words[i / 64] |= (uint64_t)bits[i] << (i % 64);
+  }
+}
+
+BitVector BitVector::from_string(const std::string &bits) {
+  BitVector res;
+  for (char c : bits) {
+    if (c == '0' || c == '1')
+      res.push_back(c - '0');
+  }
+  return res;
+}
+
+/**
+ * @throws error on a character that is not a hex digit or whitespace.
+ */
+BitVector BitVector::from_hex(const std::string &hex) {
+  BitVector res;
+  for (char c : hex) {
+    int v = hex_value(c);
+    if (v < 0) {
+      if (std::isspace((unsigned char)c))
+        continue;
+      throw std::runtime_error(std::string("Invalid hex digit ") + c);
+    }
+    for (int b = 0; b < 4; b++)
+      res.push_back((v >> b) & 1);
+  }
+  return res;
+}
+
+BitVector BitVector::from_bytes(const unsigned char *data, size_t num_bits) {
+  BitVector res(num_bits);
+  size_t num_bytes = (num_bits + 7) / 8;
+  for (size_t i = 0; i < num_bytes; i++)
+    res.words[i / 8] |= (uint64_t)data[i] << (8 * (i % 8));
+  // Clear padding past the last bit so equal vectors compare equal.
+  if (num_bits % 64)
+    res.words.back() &= ~0ULL >> (64 - num_bits % 64);
+  return res;
+}
+
+void BitVector::set(size_t i, int bit) {
+  uint64_t mask = 1ULL << (i % 64);
+  if (bit)
+    this->words[i / 64] |= mask;
+  else
+    this->words[i / 64] &= ~mask;
+}
+
+void BitVector::push_back(int bit) {
+  if (this->num_bits % 64 == 0)
+    this->words.push_back(0);
+  this->num_bits++;
+  this->set(this->num_bits - 1, bit);
+}
+
+void BitVector::append(const BitVector &bits) {
+  this->reserve(this->num_bits + bits.num_bits);
+  for (size_t i = 0; i < bits.num_bits; i++)
+    this->push_back(bits[i]);
+}
+
+void BitVector::resize(size_t num_bits) {
+  this->words.resize((num_bits + 63) / 64, 0);
+  this->num_bits = num_bits;
+  if (num_bits % 64)
+    this->words.back() &= ~0ULL >> (64 - num_bits % 64);
+}
+
+void BitVector::reserve(size_t num_bits) {
+  this->words.reserve((num_bits + 63) / 64);
+}
+
+std::string BitVector::to_string() const {
+  std::string res(this->num_bits, '0');
+  for (size_t i = 0; i < this->num_bits; i++)
+    res[i] += (*this)[i];
+  return res;
+}
+
+/**
+ * Hex digits as from_hex reads them; the last digit is zero padded.
+ */
+std::string BitVector::to_hex() const {
+  const char *digits = "0123456789abcdef";
+  std::string res;
+  for (size_t i = 0; i < this->num_bits; i += 4)
+    res += digits[(this->words[i / 64] >> (i % 64)) & 0xf];
+  return res;
+}
+
+void BitVector::to_bytes(unsigned char *out) const {
+  size_t num_bytes = (this->num_bits + 7) / 8;
+  for (size_t i = 0; i < num_bytes; i++)
+    out[i] = this->words[i / 8] >> (8 * (i % 8));
+}
+
+std::vector<int> BitVector::to_ints() const {
+  std::vector<int> res(this->num_bits);
+  for (size_t i = 0; i < this->num_bits; i++)
+    res[i] = (*this)[i];
+  return res;
+}
+
+bool BitVector::operator==(const BitVector &other) const {
+  return this->num_bits == other.num_bits && this->words == other.words;
+}
+
+// ================================================
+// INPUT FILES
+// ================================================
+
+InputFormat::T parse_input_format(std::string name) {
+  if (name == "text")
+    return InputFormat::TEXT;
+  if (name == "hex")
+    return InputFormat::HEX;
+  if (name == "binary")
+    return InputFormat::BINARY;
+  throw std::runtime_error("Unknown input format " + name);
+}
+
+/**
+ * Open filename; binary files have their header checked against width.
+ * @throws error if the file cannot be read or is for another width.
+ */
+BatchInputReader::BatchInputReader(std::string filename, InputFormat::T format,
+                                   size_t width)
+    : filename(filename), format(format), width(width),
+      in(filename, std::ios::binary), remaining(0) {
+  if (!this->in) {
+    throw std::runtime_error("Could not open file " + filename);
+  }
+  if (format == InputFormat::BINARY) {
+    BinaryInputHeader header;
+    this->in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!this->in || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION) {
+      throw std::runtime_error(filename + ": not a binary input file");
+    }
+    if (header.width != width) {
+      throw std::runtime_error(filename + ": inputs are " +
+                               std::to_string(header.width) + " bits, not " +
+                               std::to_string(width));
+    }
+    this->remaining = header.count;
+  }
+}
+
+bool BatchInputReader::next(BitVector &input) {
+  if (this->format == InputFormat::BINARY) {
+    if (this->remaining == 0)
+      return false;
+    std::vector<unsigned char> record((this->width + 7) / 8);
+    this->in.read(reinterpret_cast<char *>(record.data()), record.size());
+    if (!this->in) {
+      throw std::runtime_error(this->filename + ": truncated input");
+    }
+    this->remaining--;
+    input = BitVector::from_bytes(record.data(), this->width);
+    return true;
+  }
+
+  // Text and hex: the next line with any bits on it.
+  std::string line;
+  while (std::getline(this->in, line)) {
+    if (this->format == InputFormat::TEXT) {
+      input = BitVector::from_string(line);
+    } else {
+      input = BitVector::from_hex(line);
+      for (size_t i = this->width; i < input.size(); i++) {
+        if (input[i]) {
+          throw std::runtime_error(this->filename + ": hex input " + line +
+                                   " is wider than " +
+                                   std::to_string(this->width) + " bits");
+        }
+      }
+      if (input.size() > this->width)
+        input.resize(this->width);
+    }
+    if (input.empty())
+      continue;
+    if (input.size() != this->width) {
+      throw std::runtime_error(this->filename + ": input " + line + " is not " +
+                               std::to_string(this->width) + " bits");
+    }
+    return true;
+  }
+  return false;
+}
+
+std::vector<BitVector> read_batch_input(std::string filename,
+                                        InputFormat::T format, size_t width) {
+  BatchInputReader reader(filename, format, width);
+  std::vector<BitVector> inputs;
+  BitVector input;
+  while (reader.next(input))
+    inputs.push_back(std::move(input));
+  return inputs;
+}
+
+/**
+ * @throws error if the inputs differ in width or the file cannot be written.
+ */
+void write_binary_input(std::string filename,
+                        const std::vector<BitVector> &inputs) {
+  BinaryInputHeader header = {};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = inputs.empty() ? 0 : inputs[0].size();
+  header.count = inputs.size();
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  std::vector<unsigned char> record((header.width + 7) / 8);
+  for (const BitVector &input : inputs) {
+    if (input.size() != header.width) {
+      throw std::runtime_error("Binary inputs must all have one width.");
+    }
+    input.to_bytes(record.data());
+    out.write(reinterpret_cast<const char *>(record.data()), record.size());
+  }
+  if (!out) {
+    throw std::runtime_error("Could not write inputs " + filename);
+  }
+}
@@ -1,38 +1,630 @@
+#include <algorithm>
+#include <cctype>
+#include <climits>
 #include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 
 #include "circuit.hpp"
 #include "crypto++/sha.h"
+#include "util.hpp"
+
+static_assert(sizeof(Gate) == 16 && std::is_standard_layout_v<Gate>,
+              "compiled circuits store Gate records as-is");
+
+namespace {
+/*
+ * Token reader over a mapped Bristol file. Keeps the line number for errors.
+ */
+class BristolScanner {
+public:
+  BristolScanner(const std::string &filename, const char *begin, size_t size)
+      : filename(filename), p(begin), end(begin + size), line(1) {}
+
+  [[noreturn]] void fail(const std::string &msg) {
+    throw std::runtime_error(this->filename + ":" + std::to_string(this->line) +
+                             ": " + msg);
+  }
+
+  bool at_end() {
+    this->skip_space();
+    return this->p == this->end;
+  }
+
+  int number(const char *what) {
+    this->skip_space();
+    if (this->p == this->end || !isdigit(static_cast<unsigned char>(*this->p)))
+      this->fail(std::string("expected ") + what);
+    long value = 0;
+    while (this->p != this->end && isdigit(static_cast<unsigned char>(*this->p))) {
+      value = value * 10 + (*this->p++ - '0');
+      if (value > INT_MAX)
+        this->fail(std::string(what) + " out of range");
+    }
+    return value;
+  }
+
+  std::string_view word() {
+    this->skip_space();
+    const char *start = this->p;
+    while (this->p != this->end && !isspace(static_cast<unsigned char>(*this->p)))
+      this->p++;
+    if (start == this->p)
+      this->fail("expected gate type");
+    return std::string_view(start, this->p - start);
+  }
+
+  /*
+   * All numbers on the next non-blank line.
+   */
+  std::vector<int> number_line(const char *what) {
+    std::vector<int> values;
+    this->skip_space();
+    while (true) {
+      while (this->p != this->end && *this->p != '\n' &&
+             isspace(static_cast<unsigned char>(*this->p)))
+        this->p++;
+      if (this->p == this->end || *this->p == '\n')
+        return values;
+      values.push_back(this->number(what));
+    }
+  }
+
+  /*
+   * Whether the next non-blank line holds only numbers. Gate lines always end
+   * in a gate name. Does not consume anything.
+   */
+  bool numbers_line_next() {
+    const char *q = this->p;
+    while (q != this->end && isspace(static_cast<unsigned char>(*q)))
+      q++;
+    if (q == this->end)
+      return false;
+    for (; q != this->end && *q != '\n'; q++) {
+      if (!isdigit(static_cast<unsigned char>(*q)) &&
+          !isspace(static_cast<unsigned char>(*q)))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  void skip_space() {
+    while (this->p != this->end && isspace(static_cast<unsigned char>(*this->p))) {
+      if (*this->p == '\n')
+        this->line++;
+      this->p++;
+    }
+  }
+
+  const std::string &filename;
+  const char *p;
+  const char *end;
+  int line;
+};
+
+/*
+ * Topological checks shared by parse_circuit and validate_circuit: the header
+ * fits in num_wire wires, every wire is in range, read only after it is
+ * assigned and assigned at most once, and every output gets assigned. Inputs
+ * are assigned up front. fail reports a problem and does not return.
+ */
+template <typename Fail> class WireChecker {
+public:
+  WireChecker(const Circuit &circuit, long num_gate, Fail fail)
+      : num_wire(circuit.num_wire), output_length(circuit.output_length),
+        fail(fail) {
+    long num_inputs =
+        (long)circuit.garbler_input_length + circuit.evaluator_input_length;
+    if (circuit.garbler_input_length < 0 ||
+        circuit.evaluator_input_length < 0 || circuit.output_length < 0 ||
+        num_inputs + num_gate > circuit.num_wire ||
+        circuit.output_length > circuit.num_wire)
+      this->fail("header does not fit in " + std::to_string(circuit.num_wire) +
+                 " wires");
+    this->assigned.assign(circuit.num_wire, false);
+    std::fill(this->assigned.begin(), this->assigned.begin() + num_inputs,
+              true);
+  }
+
+  int use(int wire) {
+    if (wire < 0 || wire >= this->num_wire)
+      this->fail("wire " + std::to_string(wire) + " out of range");
+    if (!this->assigned[wire])
+      this->fail("wire " + std::to_string(wire) +
+                 " used before it is assigned");
+    return wire;
+  }
+
+  int assign(int wire) {
+    if (wire < 0 || wire >= this->num_wire)
+      this->fail("wire " + std::to_string(wire) + " out of range");
+    if (this->assigned[wire])
+      this->fail("wire " + std::to_string(wire) + " assigned twice");
+    this->assigned[wire] = true;
+    return wire;
+  }
+
+  // Outputs are the last output_length wires.
+  void check_outputs() {
+    for (int w = this->num_wire - this->output_length; w < this->num_wire; w++) {
+      if (!this->assigned[w])
+        this->fail("output wire " + std::to_string(w) + " is never assigned");
+    }
+  }
+
+private:
+  int num_wire, output_length;
+  std::vector<bool> assigned;
+  Fail fail;
+};
+} // namespace
 
 /*
- * Parse circuit from file in Bristol format.
+ * Parse circuit from file in Bristol format. The file is memory mapped and
+ * checked in the same pass: wire indices must be in range, every gate input
+ * must already be assigned and every wire assigned at most once, so the gate
+ * list is in topological order.
+ *
+ * Both the classic header ("garbler evaluator outputs") and Bristol Fashion
+ * ("groups width..." for inputs, then for outputs) are accepted. In Bristol
+ * Fashion the garbler owns the first input group and the evaluator the rest.
+ * Its extra gates are lowered to AND/XOR/NOT, all free except AND:
+ *   MAND  -> one AND per output, emitted together
+ *   EQ 0  -> in0 ^ in0
+ *   EQ 1  -> !zero
+ *   EQW   -> src ^ zero
+ * where zero is one extra wire set to in0 ^ in0 by the first gate. The extra
+ * wire is numbered just before the outputs, which stay the last wires.
+ * @throws error naming the file and line of the first problem.
  */
 Circuit parse_circuit(std::string filename) {
+  MappedFile file(filename);
+  BristolScanner in(filename, reinterpret_cast<const char *>(file.data),
+                    file.size);
+  Circuit circuit;
+
+  // Header.
+  int num_gate = in.number("gate count");
+  circuit.num_wire = in.number("wire count");
+  std::vector<int> inputs = in.number_line("input length");
+  if (in.numbers_line_next()) {
+    std::vector<int> outputs = in.number_line("output length");
+    if (inputs.empty() || inputs[0] != inputs.size() - 1)
+      in.fail("input groups do not match their count");
+    if (outputs.empty() || outputs[0] != outputs.size() - 1)
+      in.fail("output groups do not match their count");
+    long evaluator = 0, output = 0;
+    for (int i = 2; i < inputs.size(); i++)
+      evaluator += inputs[i];
+    for (int i = 1; i < outputs.size(); i++)
+      output += outputs[i];
+    if (evaluator > circuit.num_wire || output > circuit.num_wire)
+      in.fail("header does not fit in " + std::to_string(circuit.num_wire) +
+              " wires");
+    circuit.garbler_input_length = inputs.size() > 1 ? inputs[1] : 0;
+    circuit.evaluator_input_length = evaluator;
+    circuit.output_length = output;
+  } else {
+    if (inputs.size() != 3)
+      in.fail("expected garbler, evaluator and output lengths");
+    circuit.garbler_input_length = inputs[0];
+    circuit.evaluator_input_length = inputs[1];
+    circuit.output_length = inputs[2];
+  }
+  long num_inputs =
+      (long)circuit.garbler_input_length + circuit.evaluator_input_length;
+  WireChecker checker(circuit, num_gate,
+                            [&](const std::string &msg) { in.fail(msg); });
+  auto use = [&](int wire) { return checker.use(wire); };
+  auto assign = [&](int wire) { return checker.assign(wire); };
+  // Constants are derived from input 0. The zero wire gets index num_wire
+  // until the final renumbering.
+  auto constant_source = [&]() {
+    if (num_inputs == 0)
+      in.fail("constant gate in a circuit without inputs");
+    return 0;
+  };
+  bool need_zero = false;
+  auto zero = [&]() {
+    constant_source();
+    need_zero = true;
+    return circuit.num_wire;
+  };
+
+  // Gates.
+  std::vector<Gate> gates;
+  gates.reserve(num_gate);
+  std::vector<int> wires;
+  for (int i = 0; i < num_gate; ++i) {
+    if (in.at_end())
+      in.fail("expected " + std::to_string(num_gate) + " gates, found " +
+              std::to_string(i));
+    int num_in = in.number("gate input count");
+    int num_out = in.number("gate output count");
+    if (num_in < 1 || num_out < 1 || num_out > num_in ||
+        num_in > circuit.num_wire)
+      in.fail("unsupported gate arity " + std::to_string(num_in) + " " +
+              std::to_string(num_out));
+    wires.resize(num_in + num_out);
+    for (int &wire : wires)
+      wire = in.number("wire");
+    std::string_view type = in.word();
+    int out = num_in;
+    if (num_in == 2 && num_out == 1 && type == "AND")
+      gates.push_back({GateType::AND_GATE, use(wires[0]), use(wires[1]),
+                       assign(wires[out])});
+    else if (num_in == 2 && num_out == 1 && type == "XOR")
+      gates.push_back({GateType::XOR_GATE, use(wires[0]), use(wires[1]),
+                       assign(wires[out])});
+    else if (num_in == 1 && num_out == 1 && (type == "INV" || type == "NOT"))
+      gates.push_back({GateType::NOT_GATE, use(wires[0]), 0,
+                       assign(wires[out])});
+    else if (num_in == 2 * num_out && type == "MAND") {
+      for (int j = 0; j < num_out; j++)
+        gates.push_back({GateType::AND_GATE, use(wires[j]),
+                         use(wires[num_out + j]), assign(wires[out + j])});
+    } else if (num_in == 1 && num_out == 1 && type == "EQ") {
+      if (wires[0] > 1)
+        in.fail("EQ constant must be 0 or 1");
+      if (wires[0] == 0)
+        gates.push_back({GateType::XOR_GATE, constant_source(),
+                         constant_source(), assign(wires[out])});
+      else
+        gates.push_back({GateType::NOT_GATE, zero(), 0, assign(wires[out])});
+    } else if (num_in == 1 && num_out == 1 && type == "EQW")
+      gates.push_back({GateType::XOR_GATE, use(wires[0]), zero(),
+                       assign(wires[out])});
+    else
+      in.fail("unsupported gate " + std::string(type) + " with " +
+              std::to_string(num_in) + " inputs");
+  }
+  if (!in.at_end())
+    in.fail("trailing data after " + std::to_string(num_gate) + " gates");
+
+  checker.check_outputs();
+  int first_output = circuit.num_wire - circuit.output_length;
+
+  if (need_zero) {
+    int zero_wire = circuit.num_wire;
+    auto renumber = [&](int &wire) {
+      if (wire == zero_wire)
+        wire = first_output;
+      else if (wire >= first_output)
+        wire++;
+    };
+    for (Gate &gate : gates) {
+      renumber(gate.lhs);
+      if (gate.type != GateType::NOT_GATE)
+        renumber(gate.rhs);
+      renumber(gate.output);
+    }
+    gates.insert(gates.begin(), {GateType::XOR_GATE, 0, 0, first_output});
+    circuit.num_wire++;
+  }
+  circuit.num_gate = gates.size();
+  circuit.set_gates(std::move(gates));
+  return circuit;
+}
+
+/*
+ * Apply parse_circuit's topological checks to a circuit read some other way,
+ * e.g. a compiled file. NOT gates have no rhs to check.
+ * @throws error naming the first bad gate.
+ */
+void validate_circuit(const Circuit &circuit) {
+  long i = -1;
+  auto fail = [&](const std::string &msg) {
+    throw std::runtime_error(i < 0 ? msg
+                                   : "gate " + std::to_string(i) + ": " + msg);
+  };
+  WireChecker checker(circuit, circuit.gates.size(), fail);
+  if (circuit.num_gate != (long)circuit.gates.size())
+    fail("gate count does not match the header");
+  for (i = 0; i < (long)circuit.gates.size(); i++) {
+    const Gate &gate = circuit.gates[i];
+    if (gate.type < GateType::AND_GATE || gate.type > GateType::NOT_GATE)
+      fail("unsupported gate type " + std::to_string(gate.type));
+    checker.use(gate.lhs);
+    if (gate.type != GateType::NOT_GATE)
+      checker.use(gate.rhs);
+    checker.assign(gate.output);
+  }
+  i = -1;
+  checker.check_outputs();
+}
+
+/*
+ * Parse circuit from file in Bristol format with stdio, without structural
+ * checks. Kept as the baseline for parser benchmarks.
+ * @throws error if the file cannot be opened or has an unknown gate.
+ */
+Circuit parse_circuit_stdio(std::string filename) {
   Circuit circuit;
 
   // Open file, scan header.
   FILE *f = fopen(filename.c_str(), "r");
+  if (f == nullptr) {
+    throw std::runtime_error("Could not open circuit file " + filename);
+  }
   (void)fscanf(f, "%d%d\n", &circuit.num_gate, &circuit.num_wire);
   (void)fscanf(f, "%d%d%d\n", &circuit.garbler_input_length,
                &circuit.evaluator_input_length, &circuit.output_length);
   (void)fscanf(f, "\n");
 
   // Scan gates.
-  circuit.gates.resize(circuit.num_gate);
+  std::vector<Gate> gates(circuit.num_gate);
   int tmp, lhs, rhs, output;
   char str[10];
   for (int i = 0; i < circuit.num_gate; ++i) {
-    (void)fscanf(f, "%d", &tmp);
+    bool known = false;
+    if (fscanf(f, "%d", &tmp) != 1) {
+      tmp = 0;
+    }
     if (tmp == 2) {
-      (void)fscanf(f, "%d%d%d%d%s", &tmp, &lhs, &rhs, &output, str);
-      if (str[0] == 'A')
-        circuit.gates[i] = {GateType::AND_GATE, lhs, rhs, output};
-      else if (str[0] == 'X')
-        circuit.gates[i] = {GateType::XOR_GATE, lhs, rhs, output};
+      (void)fscanf(f, "%d%d%d%d%9s", &tmp, &lhs, &rhs, &output, str);
+      known = true;
+      if (std::string(str) == "AND")
+        gates[i] = {GateType::AND_GATE, lhs, rhs, output};
+      else if (std::string(str) == "XOR")
+        gates[i] = {GateType::XOR_GATE, lhs, rhs, output};
+      else
+        known = false;
     } else if (tmp == 1) {
-      (void)fscanf(f, "%d%d%d%s", &tmp, &lhs, &output, str);
-      circuit.gates[i] = {GateType::NOT_GATE, lhs, 0, output};
+      (void)fscanf(f, "%d%d%d%9s", &tmp, &lhs, &output, str);
+      known = std::string(str) == "INV" || std::string(str) == "NOT";
+      gates[i] = {GateType::NOT_GATE, lhs, 0, output};
+    }
+    if (!known) {
+      fclose(f);
+      throw std::runtime_error("Unsupported gate " + std::to_string(i) +
+                               " in circuit file " + filename);
     }
   }
 
+  fclose(f);
+  circuit.set_gates(std::move(gates));
   return circuit;
 }
+
+/*
+ * Write circuit to file in Bristol format.
+ */
+void write_circuit(const Circuit &circuit, std::string filename) {
+  std::ofstream out(filename, std::ios::trunc);
+  out << circuit.gates.size() << " " << circuit.num_wire << "\n"
+      << circuit.garbler_input_length << " " << circuit.evaluator_input_length
+      << " " << circuit.output_length << "\n\n";
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::NOT_GATE)
+      out << "1 1 " << gate.lhs << " " << gate.output << " INV\n";
+    else
+      out << "2 1 " << gate.lhs << " " << gate.rhs << " " << gate.output
+          << (gate.type == GateType::AND_GATE ? " AND\n" : " XOR\n");
+  }
+  if (!out) {
+    throw std::runtime_error("Could not write circuit file " + filename);
+  }
+}
+
+/*
+ * Take ownership of gates and point the view at them.
+ */
+void Circuit::set_gates(std::vector<Gate> gates) {
+  auto owned = std::make_shared<const std::vector<Gate>>(std::move(gates));
+  this->gates = std::span<const Gate>(*owned);
+  this->storage = owned;
+}
+
+/*
+ * Gate level: 0 for gates that read only inputs, otherwise one more than the
+ * deepest gate feeding it. Gates of one level are independent of each other.
+ */
+std::vector<uint32_t> compute_gate_levels(const Circuit &circuit) {
+  std::vector<uint32_t> wire_depth(circuit.num_wire, 0);
+  std::vector<uint32_t> levels(circuit.gates.size());
+  for (size_t i = 0; i < circuit.gates.size(); i++) {
+    const Gate &gate = circuit.gates[i];
+    uint32_t level = wire_depth[gate.lhs];
+    if (gate.type != GateType::NOT_GATE)
+      level = std::max(level, wire_depth[gate.rhs]);
+    levels[i] = level;
+    wire_depth[gate.output] = level + 1;
+  }
+  return levels;
+}
+
+/*
+ * Index of the last gate reading each wire; its label can be dropped after.
+ */
+std::vector<uint32_t> compute_wire_last_use(const Circuit &circuit) {
+  std::vector<uint32_t> last_use(circuit.num_wire, 0);
+  for (size_t i = 0; i < circuit.gates.size(); i++) {
+    last_use[circuit.gates[i].output] = i;
+  }
+  for (size_t i = 0; i < circuit.gates.size(); i++) {
+    const Gate &gate = circuit.gates[i];
+    last_use[gate.lhs] = i;
+    if (gate.type != GateType::NOT_GATE)
+      last_use[gate.rhs] = i;
+  }
+  for (int w = circuit.num_wire - circuit.output_length; w < circuit.num_wire;
+       w++) {
+    last_use[w] = circuit.gates.size();
+  }
+  return last_use;
+}
+
+/*
+ * Fingerprint circuit; see circuit.hpp. The unused rhs of NOT gates is
+ * hashed as 0 so it cannot tell equal circuits apart.
+ */
+std::string circuit_fingerprint(const Circuit &circuit) {
+  CryptoPP::SHA256 hash;
+  int32_t header[4] = {circuit.num_wire, circuit.garbler_input_length,
+                       circuit.evaluator_input_length, circuit.output_length};
+  hash.Update(reinterpret_cast<const CryptoPP::byte *>(header), sizeof(header));
+  for (const Gate &gate : circuit.gates) {
+    int32_t fields[4] = {gate.type, gate.lhs,
+                         gate.type == GateType::NOT_GATE ? 0 : gate.rhs,
+                         gate.output};
+    hash.Update(reinterpret_cast<const CryptoPP::byte *>(fields),
+                sizeof(fields));
+  }
+  CryptoPP::SecByteBlock digest(CryptoPP::SHA256::DIGESTSIZE);
+  hash.Final(digest);
+  return hex_encode(byteblock_to_string(digest));
+}
+
+/*
+ * Assign label slots; see circuit.hpp. A gate's output slot is taken before
+ * its operands' slots are released, so output and operands never share one.
+ */
+WireSlots assign_wire_slots(const Circuit &circuit) {
+  std::vector<uint32_t> last_use = compute_wire_last_use(circuit);
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  int first_output = circuit.num_wire - circuit.output_length;
+
+  WireSlots slots;
+  slots.slot.assign(circuit.num_wire, -1);
+  slots.num_slots = num_inputs;
+  for (int w = 0; w < num_inputs; w++)
+    slots.slot[w] = w;
+
+  // Most recently freed first, so a reused slot is likely still cached.
+  std::vector<int> free_slots;
+  auto release = [&](int wire, uint32_t gate) {
+    if (wire >= num_inputs && wire < first_output && last_use[wire] == gate)
+      free_slots.push_back(slots.slot[wire]);
+  };
+  for (uint32_t i = 0; i < circuit.gates.size(); i++) {
+    const Gate &gate = circuit.gates[i];
+    if (free_slots.empty()) {
+      slots.slot[gate.output] = slots.num_slots++;
+    } else {
+      slots.slot[gate.output] = free_slots.back();
+      free_slots.pop_back();
+    }
+    release(gate.lhs, i);
+    if (gate.type != GateType::NOT_GATE && gate.rhs != gate.lhs)
+      release(gate.rhs, i);
+    release(gate.output, i); // never read
+  }
+  return slots;
+}
+
+/*
+ * Schedule circuit; see circuit.hpp. Within a level, gates are sorted by
+ * their (already renumbered) operands so neighbouring gates read
+ * neighbouring labels, and outputs are numbered in that order.
+ */
+Circuit schedule_circuit(const Circuit &circuit) {
+  std::vector<uint32_t> levels = compute_gate_levels(circuit);
+  int num_levels = 0;
+  for (uint32_t level : levels)
+    num_levels = std::max<int>(num_levels, level + 1);
+
+  // Bucket gates by level, keeping their order.
+  std::vector<int> level_offsets(num_levels + 1, 0);
+  for (uint32_t level : levels)
+    level_offsets[level + 1]++;
+  for (int l = 0; l < num_levels; l++)
+    level_offsets[l + 1] += level_offsets[l];
+  std::vector<int> order(circuit.gates.size());
+  std::vector<int> fill(level_offsets.begin(), level_offsets.end() - 1);
+  for (int i = 0; i < circuit.gates.size(); i++)
+    order[fill[levels[i]]++] = i;
+
+  // Inputs keep their wires, outputs stay last, the rest follow gate order.
+  const int UNNUMBERED = -1;
+  std::vector<int> wire_map(circuit.num_wire, UNNUMBERED);
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  int first_output = circuit.num_wire - circuit.output_length;
+  if (first_output < num_inputs)
+    throw std::runtime_error("Cannot schedule a circuit whose outputs are inputs.");
+  int internal = 0;
+  for (const Gate &gate : circuit.gates)
+    internal += gate.output < first_output;
+  for (int w = 0; w < num_inputs; w++)
+    wire_map[w] = w;
+  for (int w = first_output; w < circuit.num_wire; w++)
+    wire_map[w] = num_inputs + internal + (w - first_output);
+  int next_wire = num_inputs;
+
+  std::vector<Gate> gates;
+  gates.reserve(circuit.gates.size());
+  for (int l = 0; l < num_levels; l++) {
+    auto begin = order.begin() + level_offsets[l];
+    auto end = order.begin() + level_offsets[l + 1];
+    auto operands = [&](int i) {
+      const Gate &gate = circuit.gates[i];
+      int lhs = wire_map[gate.lhs];
+      int rhs = gate.type == GateType::NOT_GATE ? lhs : wire_map[gate.rhs];
+      return std::make_pair(std::min(lhs, rhs), std::max(lhs, rhs));
+    };
+    std::stable_sort(begin, end,
+                     [&](int a, int b) { return operands(a) < operands(b); });
+    for (auto it = begin; it != end; it++) {
+      Gate gate = circuit.gates[*it];
+      if (wire_map[gate.output] == UNNUMBERED)
+        wire_map[gate.output] = next_wire++;
+      gate.lhs = wire_map[gate.lhs];
+      gate.rhs = gate.type == GateType::NOT_GATE ? 0 : wire_map[gate.rhs];
+      gate.output = wire_map[gate.output];
+      gates.push_back(gate);
+    }
+  }
+
+  Circuit scheduled = circuit;
+  scheduled.num_wire = num_inputs + internal + circuit.output_length;
+  scheduled.set_gates(std::move(gates));
+  scheduled.level_offsets = std::move(level_offsets);
+  return scheduled;
+}
+
+/*
+ * Bind inputs; see circuit.hpp. An input wire bound twice is an error.
+ */
+std::vector<const GarbledWire *>
+bind_inputs(const Circuit &circuit, const JobWiring &wiring,
+            const KeptLabels &kept) {
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<const GarbledWire *> bound(num_inputs, nullptr);
+  for (const BoundInput &input : wiring.inputs) {
+    auto value = kept.find(input.name);
+    if (value == kept.end()) {
+      throw std::runtime_error("No kept value " + input.name + ".");
+    }
+    int length = value->second.size();
+    if (input.first_input < 0 || input.first_input + length > num_inputs) {
+      throw std::runtime_error("Value " + input.name +
+                               " does not fit the circuit's inputs.");
+    }
+    for (int i = 0; i < length; i++) {
+      if (bound[input.first_input + i] != nullptr) {
+        throw std::runtime_error("Input wire bound twice.");
+      }
+      bound[input.first_input + i] = &value->second[i];
+    }
+  }
+  return bound;
+}
+
+std::vector<bool> kept_outputs(const Circuit &circuit,
+                               const JobWiring &wiring) {
+  std::vector<bool> kept(circuit.output_length, false);
+  for (const KeptOutput &output : wiring.outputs) {
+    if (output.name.empty() || output.first_output < 0 || output.length < 0 ||
+        output.first_output + output.length > circuit.output_length) {
+      throw std::runtime_error("Kept value " + output.name +
+                               " does not fit the circuit's outputs.");
+    }
+    for (int i = 0; i < output.length; i++) {
+      kept[output.first_output + i] = true;
+    }
+  }
+  return kept;
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "circuit_builder.hpp"
+#include "circuit_optimizer.hpp"
+
+namespace {
+// Below this width the schoolbook multiplier uses fewer ANDs than a
+// Karatsuba step (3 half-size products plus the adds that combine them).
+const int KARATSUBA_MIN_BITS = 14;
+} // namespace
+
+/*
+ * Constructor. Inputs are wires 0..garbler_input_length-1 for the garbler,
+ * then the evaluator's.
+ */
+CircuitBuilder::CircuitBuilder(int garbler_input_length,
+                               int evaluator_input_length)
+    : garbler_input_length(garbler_input_length),
+      evaluator_input_length(evaluator_input_length),
+      num_wire(garbler_input_length + evaluator_input_length) {}
+
+CircuitBuilder::Bits CircuitBuilder::garbler_input() const {
+  Bits bits(this->garbler_input_length);
+  for (int i = 0; i < bits.size(); i++)
+    bits[i] = i;
+  return bits;
+}
+
+CircuitBuilder::Bits CircuitBuilder::evaluator_input() const {
+  Bits bits(this->evaluator_input_length);
+  for (int i = 0; i < bits.size(); i++)
+    bits[i] = this->garbler_input_length + i;
+  return bits;
+}
+
+CircuitBuilder::Bit CircuitBuilder::AND(Bit a, Bit b) {
+  if (a == ZERO || b == ZERO)
+    return ZERO;
+  if (a == ONE || a == b)
+    return b;
+  if (b == ONE)
+    return a;
+  auto it = this->negation.find(a);
+  if (it != this->negation.end() && it->second == b)
+    return ZERO;
+  return this->emit(GateType::AND_GATE, a, b);
+}
+
+CircuitBuilder::Bit CircuitBuilder::XOR(Bit a, Bit b) {
+  if (a == ZERO)
+    return b;
+  if (b == ZERO)
+    return a;
+  if (a == ONE)
+    return this->NOT(b);
+  if (b == ONE)
+    return this->NOT(a);
+  if (a == b)
+    return ZERO;
+  auto it = this->negation.find(a);
+  if (it != this->negation.end() && it->second == b)
+    return ONE;
+  return this->emit(GateType::XOR_GATE, a, b);
+}
+
+CircuitBuilder::Bit CircuitBuilder::NOT(Bit a) {
+  if (a == ZERO || a == ONE)
+    return a == ZERO ? ONE : ZERO;
+  auto it = this->negation.find(a);
+  if (it != this->negation.end())
+    return it->second;
+  Bit out = this->emit(GateType::NOT_GATE, a, 0);
+  this->negation[a] = out;
+  this->negation[out] = a;
+  return out;
+}
+
+/*
+ * a | b = a ^ b ^ (a & b), one AND.
+ */
+CircuitBuilder::Bit CircuitBuilder::OR(Bit a, Bit b) {
+  return this->XOR(this->XOR(a, b), this->AND(a, b));
+}
+
+/*
+ * s ? a : b = b ^ (s & (a ^ b)), one AND.
+ */
+CircuitBuilder::Bit CircuitBuilder::MUX(Bit s, Bit a, Bit b) {
+  return this->XOR(b, this->AND(s, this->XOR(a, b)));
+}
+
+/*
+ * Append a gate writing a new wire.
+ */
+CircuitBuilder::Bit CircuitBuilder::emit(GateType::T type, Bit lhs, Bit rhs) {
+  this->gates.push_back({type, lhs, rhs, this->num_wire});
+  return this->num_wire++;
+}
+
+/*
+ * Finish circuit; see circuit_builder.hpp. Each output is copied onto a new
+ * wire so outputs are the last wires even if they repeat, are inputs or are
+ * constants; optimize_circuit then removes the copies and dead gates.
+ */
+Circuit CircuitBuilder::finish(const Bits &outputs) {
+  int num_inputs = this->garbler_input_length + this->evaluator_input_length;
+  Bit zero = -1;
+  auto materialize = [&](Bit bit) {
+    if (bit >= 0)
+      return bit;
+    if (num_inputs == 0)
+      throw std::runtime_error("Constant output in a circuit without inputs.");
+    if (zero < 0)
+      zero = this->emit(GateType::XOR_GATE, 0, 0);
+    return bit == ZERO ? zero : this->emit(GateType::NOT_GATE, zero, 0);
+  };
+  std::vector<Bit> wires;
+  for (Bit bit : outputs)
+    wires.push_back(materialize(bit));
+  Bit copy_zero = materialize(ZERO);
+  for (Bit wire : wires)
+    this->emit(GateType::XOR_GATE, wire, copy_zero);
+
+  Circuit circuit;
+  circuit.num_gate = this->gates.size();
+  circuit.num_wire = this->num_wire;
+  circuit.garbler_input_length = this->garbler_input_length;
+  circuit.evaluator_input_length = this->evaluator_input_length;
+  circuit.output_length = outputs.size();
+  circuit.set_gates(this->gates);
+  return optimize_circuit(circuit);
+}
+
+namespace circuits {
+namespace {
+Bit bit_at(const Bits &x, int i) {
+  return i < x.size() ? x[i] : CircuitBuilder::ZERO;
+}
+
+/*
+ * Low width bits of x + y + carry. Bit i of the sum is x ^ y ^ c and the next
+ * carry is c ^ ((x ^ c) & (y ^ c)), one AND per bit.
+ */
+Bits ripple_add(CircuitBuilder &b, const Bits &x, const Bits &y, Bit carry,
+                int width) {
+  Bits sum(width);
+  for (int i = 0; i < width; i++) {
+    Bit xi = bit_at(x, i), yi = bit_at(y, i);
+    sum[i] = b.XOR(b.XOR(xi, yi), carry);
+    if (i + 1 < width)
+      carry = b.XOR(carry, b.AND(b.XOR(xi, carry), b.XOR(yi, carry)));
+  }
+  return sum;
+}
+
+Bits negate_bits(CircuitBuilder &b, const Bits &x, int width) {
+  Bits out(width);
+  for (int i = 0; i < width; i++)
+    out[i] = b.NOT(bit_at(x, i));
+  return out;
+}
+
+/*
+ * x (shifted left by offset) added into acc in place, modulo 2^acc.size().
+ */
+void accumulate(CircuitBuilder &b, Bits &acc, const Bits &x, int offset) {
+  if (offset >= acc.size())
+    return;
+  Bits high(acc.begin() + offset, acc.end());
+  Bits sum = ripple_add(b, high, x, CircuitBuilder::ZERO, high.size());
+  std::copy(sum.begin(), sum.end(), acc.begin() + offset);
+}
+
+Bits schoolbook_multiply(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  Bits acc(x.size() + y.size(), CircuitBuilder::ZERO);
+  for (int j = 0; j < y.size(); j++) {
+    Bits row(x.size());
+    for (int i = 0; i < x.size(); i++)
+      row[i] = b.AND(x[i], y[j]);
+    // Rows only reach one bit past their top, so the carry stops there.
+    Bits window(acc.begin() + j, acc.begin() + j + x.size());
+    Bits sum = ripple_add(b, window, row, CircuitBuilder::ZERO, x.size() + 1);
+    std::copy(sum.begin(), sum.end(), acc.begin() + j);
+  }
+  return acc;
+}
+
+/*
+ * x * y = z2 * 2^2h + z1 * 2^h + z0 with z0 = x0 * y0, z2 = x1 * y1 and
+ * z1 = (x0 + x1)(y0 + y1) - z0 - z2, which fits in n + 1 bits.
+ */
+Bits karatsuba_multiply(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = x.size(), h = n / 2;
+  Bits x0(x.begin(), x.begin() + h), x1(x.begin() + h, x.end());
+  Bits y0(y.begin(), y.begin() + h), y1(y.begin() + h, y.end());
+  Bits z0 = multiply(b, x0, y0);
+  Bits z2 = multiply(b, x1, y1);
+  Bits z1 = multiply(b, add(b, x0, x1), add(b, y0, y1));
+  z1.resize(n + 1);
+  z1 = ripple_add(b, z1, negate_bits(b, z0, n + 1), CircuitBuilder::ONE, n + 1);
+  z1 = ripple_add(b, z1, negate_bits(b, z2, n + 1), CircuitBuilder::ONE, n + 1);
+
+  Bits product = z0;
+  product.insert(product.end(), z2.begin(), z2.end());
+  accumulate(b, product, z1, h);
+  return product;
+}
+} // namespace
+
+Bits add(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  return ripple_add(b, x, y, CircuitBuilder::ZERO, n + 1);
+}
+
+/*
+ * Sklansky parallel prefix over (generate, propagate) pairs. Group generate
+ * and propagate never both hold, so combining uses XOR in place of OR.
+ */
+Bits add_lookahead(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  Bits p(n), g(n);
+  for (int i = 0; i < n; i++) {
+    p[i] = b.XOR(bit_at(x, i), bit_at(y, i));
+    g[i] = b.AND(bit_at(x, i), bit_at(y, i));
+  }
+  Bits gp = g, pp = p; // prefix over [start of block, i]
+  for (int d = 1; d < n; d *= 2) {
+    for (int i = 0; i < n; i++) {
+      if (!(i & d))
+        continue;
+      int block = i & ~(2 * d - 1);
+      int j = block + d - 1;
+      gp[i] = b.XOR(gp[i], b.AND(pp[i], gp[j]));
+      // Prefixes reaching bit 0 never need their propagate again.
+      if (block != 0)
+        pp[i] = b.AND(pp[i], pp[j]);
+    }
+  }
+  Bits sum(n + 1);
+  for (int i = 0; i < n; i++)
+    sum[i] = i == 0 ? p[0] : b.XOR(p[i], gp[i - 1]);
+  sum[n] = n == 0 ? CircuitBuilder::ZERO : gp[n - 1];
+  return sum;
+}
+
+Bits subtract(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  return ripple_add(b, x, negate_bits(b, y, n), CircuitBuilder::ONE, n);
+}
+
+Bits multiply(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  if (std::min(x.size(), y.size()) < KARATSUBA_MIN_BITS)
+    return schoolbook_multiply(b, x, y);
+  Bits xp = x, yp = y;
+  xp.resize(n, CircuitBuilder::ZERO);
+  yp.resize(n, CircuitBuilder::ZERO);
+  Bits product = karatsuba_multiply(b, xp, yp);
+  product.resize(x.size() + y.size());
+  return product;
+}
+
+/*
+ * x < y exactly when x + ~y + 1 does not carry out of the top bit.
+ */
+Bit less_than(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  Bits sum = ripple_add(b, x, negate_bits(b, y, n), CircuitBuilder::ONE, n + 1);
+  return b.NOT(sum[n]);
+}
+
+Bit greater_than(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  return less_than(b, y, x);
+}
+
+/*
+ * AND of the bitwise XNORs, n - 1 ANDs.
+ */
+Bit equal(CircuitBuilder &b, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  Bits same(n);
+  for (int i = 0; i < n; i++)
+    same[i] = b.NOT(b.XOR(bit_at(x, i), bit_at(y, i)));
+  // Balanced tree keeps the depth logarithmic.
+  while (same.size() > 1) {
+    Bits next;
+    for (int i = 0; i + 1 < same.size(); i += 2)
+      next.push_back(b.AND(same[i], same[i + 1]));
+    if (same.size() % 2)
+      next.push_back(same.back());
+    same = next;
+  }
+  return same.empty() ? CircuitBuilder::ONE : same[0];
+}
+
+Bits mux(CircuitBuilder &b, Bit s, const Bits &x, const Bits &y) {
+  int n = std::max(x.size(), y.size());
+  Bits out(n);
+  for (int i = 0; i < n; i++)
+    out[i] = b.MUX(s, bit_at(x, i), bit_at(y, i));
+  return out;
+}
+} // namespace circuits
@@ -0,0 +1,578 @@
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "circuit_optimizer.hpp"
+
+namespace {
+/*
+ * Literals name a node and a polarity: lit = 2 * node + negated. Node 0 is
+ * the constant false, so literal 0 is false and literal 1 is true. Nodes
+ * 1..num_inputs are the inputs; later nodes are AND/XOR gates over literals.
+ * NOT gates are just a flipped literal, so NOT pairs cancel for free.
+ */
+const int FALSE_LIT = 0;
+const int TRUE_LIT = 1;
+
+int node_of(int lit) { return lit >> 1; }
+bool negated(int lit) { return lit & 1; }
+
+struct Node {
+  GateType::T type;
+  int lhs, rhs; // literals, lhs < rhs
+};
+
+/*
+ * Hash-consed AND/XOR graph that simplifies as it is built.
+ */
+class LogicGraph {
+public:
+  LogicGraph(int num_inputs) : nodes(num_inputs + 1) {}
+
+  int input(int i) { return 2 * (i + 1); }
+
+  int make_and(int a, int b) {
+    if (a == FALSE_LIT || b == FALSE_LIT || a == (b ^ 1))
+      return FALSE_LIT;
+    if (a == TRUE_LIT || a == b)
+      return b;
+    if (b == TRUE_LIT)
+      return a;
+    return this->make_node(GateType::AND_GATE, a, b);
+  }
+
+  int make_xor(int a, int b) {
+    if (node_of(a) == node_of(b))
+      return FALSE_LIT ^ negated(a) ^ negated(b);
+    if (node_of(a) == 0)
+      return b ^ a;
+    if (node_of(b) == 0)
+      return a ^ b;
+    // !a ^ !b == a ^ b. A single negation stays on its input, since moving it
+    // to the output can cost a NOT gate where none was needed.
+    if (negated(a) && negated(b)) {
+      a ^= 1;
+      b ^= 1;
+    }
+    return this->make_node(GateType::XOR_GATE, a, b);
+  }
+
+  std::vector<Node> nodes;
+
+private:
+  int make_node(GateType::T type, int a, int b) {
+    if (a > b)
+      std::swap(a, b);
+    uint64_t key = (uint64_t(a) << 33) | (uint64_t(b) << 1) |
+                   (type == GateType::XOR_GATE);
+    auto it = this->cache.find(key);
+    if (it != this->cache.end())
+      return it->second;
+    int lit = 2 * this->nodes.size();
+    this->nodes.push_back({type, a, b});
+    this->cache.emplace(key, lit);
+    return lit;
+  }
+
+  std::unordered_map<uint64_t, int> cache;
+};
+
+/*
+ * Writes the live part of a LogicGraph back out as gates. Wires are numbered
+ * as they are created and fixed up at the end: internal wires follow the
+ * inputs and output i becomes wire num_wire - output_length + i.
+ */
+class GateEmitter {
+public:
+  GateEmitter(const LogicGraph &graph, int num_inputs)
+      : graph(graph), num_inputs(num_inputs), num_internal(0),
+        node_wire(graph.nodes.size(), UNSET), not_wire(graph.nodes.size(), UNSET),
+        not_emitted(graph.nodes.size(), false), zero_wire(UNSET) {
+    for (int i = 0; i < num_inputs; i++)
+      this->node_wire[i + 1] = i;
+  }
+
+  // Let the gate computing lit write output wire index.
+  void claim_output(int lit, int index) {
+    if (negated(lit))
+      this->not_wire[node_of(lit)] = output_wire(index);
+    else
+      this->node_wire[node_of(lit)] = output_wire(index);
+  }
+  bool claimed(int lit) {
+    return (negated(lit) ? this->not_wire : this->node_wire)[node_of(lit)] !=
+           UNSET;
+  }
+
+  void emit_node(int node) {
+    const Node &n = this->graph.nodes[node];
+    if (this->node_wire[node] == UNSET)
+      this->node_wire[node] = this->new_wire();
+    int lhs = this->wire(n.lhs), rhs = this->wire(n.rhs);
+    this->gates.push_back({n.type, lhs, rhs, this->node_wire[node]});
+  }
+
+  // Drive output wire index from lit, unless its gate already writes it.
+  void emit_output(int lit, int index) {
+    int out = output_wire(index);
+    int node = node_of(lit);
+    if (!negated(lit) && node != 0 && this->node_wire[node] == out)
+      return;
+    if (negated(lit) && node != 0 && this->not_wire[node] == out) {
+      this->wire(lit);
+      return;
+    }
+    if (lit == FALSE_LIT) {
+      this->gates.push_back({GateType::XOR_GATE, this->first_input(),
+                             this->first_input(), out});
+    } else if (negated(lit)) {
+      int src = node == 0 ? this->zero() : this->node_wire[node];
+      this->gates.push_back({GateType::NOT_GATE, src, 0, out});
+    } else {
+      // Copy with a free XOR against zero.
+      this->gates.push_back(
+          {GateType::XOR_GATE, this->node_wire[node], this->zero(), out});
+    }
+  }
+
+  Circuit finish(int garbler_input_length, int evaluator_input_length,
+                 int output_length) {
+    Circuit circuit;
+    circuit.garbler_input_length = garbler_input_length;
+    circuit.evaluator_input_length = evaluator_input_length;
+    circuit.output_length = output_length;
+    circuit.num_wire = this->num_inputs + this->num_internal + output_length;
+    int first_output = this->num_inputs + this->num_internal;
+    auto fix = [&](int w) { return w < 0 ? first_output + (-w - 1) : w; };
+    for (Gate &gate : this->gates) {
+      gate.lhs = fix(gate.lhs);
+      gate.rhs = fix(gate.rhs);
+      gate.output = fix(gate.output);
+    }
+    circuit.num_gate = this->gates.size();
+    circuit.set_gates(std::move(this->gates));
+    return circuit;
+  }
+
+private:
+  static constexpr int UNSET = INT_MIN;
+
+  static int output_wire(int index) { return -(index + 1); }
+
+  int new_wire() { return this->num_inputs + this->num_internal++; }
+
+  // Wire carrying lit, adding a NOT gate the first time a negation is needed.
+  int wire(int lit) {
+    int node = node_of(lit);
+    if (!negated(lit))
+      return this->node_wire[node];
+    if (!this->not_emitted[node]) {
+      if (this->not_wire[node] == UNSET)
+        this->not_wire[node] = this->new_wire();
+      this->gates.push_back(
+          {GateType::NOT_GATE, this->node_wire[node], 0, this->not_wire[node]});
+      this->not_emitted[node] = true;
+    }
+    return this->not_wire[node];
+  }
+
+  // A wire that is always 0, from x ^ x on the first input.
+  int zero() {
+    if (this->zero_wire == UNSET) {
+      this->zero_wire = this->new_wire();
+      this->gates.push_back({GateType::XOR_GATE, this->first_input(),
+                             this->first_input(), this->zero_wire});
+    }
+    return this->zero_wire;
+  }
+
+  int first_input() {
+    if (this->num_inputs == 0)
+      throw std::runtime_error("Circuit without inputs has constant outputs.");
+    return 0;
+  }
+
+  const LogicGraph &graph;
+  int num_inputs;
+  int num_internal;
+  std::vector<int> node_wire;
+  std::vector<int> not_wire;
+  std::vector<bool> not_emitted;
+  int zero_wire;
+  std::vector<Gate> gates;
+};
+
+/*
+ * Rebuild circuit as a simplified graph; fills output_lits.
+ */
+LogicGraph build_graph(const Circuit &circuit, std::vector<int> &output_lits) {
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  LogicGraph graph(num_inputs);
+  std::vector<int> wire_lit(circuit.num_wire, FALSE_LIT);
+  for (int i = 0; i < num_inputs; i++)
+    wire_lit[i] = graph.input(i);
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::AND_GATE)
+      wire_lit[gate.output] =
+          graph.make_and(wire_lit[gate.lhs], wire_lit[gate.rhs]);
+    else if (gate.type == GateType::XOR_GATE)
+      wire_lit[gate.output] =
+          graph.make_xor(wire_lit[gate.lhs], wire_lit[gate.rhs]);
+    else
+      wire_lit[gate.output] = wire_lit[gate.lhs] ^ 1;
+  }
+  output_lits.assign(wire_lit.end() - circuit.output_length, wire_lit.end());
+  return graph;
+}
+
+/*
+ * Write out the part of graph the outputs depend on, with the input and
+ * output layout of shape.
+ */
+Circuit emit_graph(const LogicGraph &graph, const std::vector<int> &output_lits,
+                   const Circuit &shape) {
+  int num_inputs = shape.garbler_input_length + shape.evaluator_input_length;
+
+  // Keep only gates some output depends on.
+  std::vector<bool> live(graph.nodes.size(), false);
+  for (int lit : output_lits)
+    live[node_of(lit)] = true;
+  for (int node = graph.nodes.size() - 1; node > num_inputs; node--) {
+    if (live[node]) {
+      live[node_of(graph.nodes[node].lhs)] = true;
+      live[node_of(graph.nodes[node].rhs)] = true;
+    }
+  }
+
+  // Emit, letting each output's gate write its output wire directly.
+  GateEmitter emitter(graph, num_inputs);
+  for (int i = 0; i < output_lits.size(); i++) {
+    int lit = output_lits[i];
+    bool computed = negated(lit) ? node_of(lit) != 0 : node_of(lit) > num_inputs;
+    if (computed && !emitter.claimed(lit))
+      emitter.claim_output(lit, i);
+  }
+  for (int node = num_inputs + 1; node < graph.nodes.size(); node++) {
+    if (live[node])
+      emitter.emit_node(node);
+  }
+  for (int i = 0; i < output_lits.size(); i++)
+    emitter.emit_output(output_lits[i], i);
+  return emitter.finish(shape.garbler_input_length,
+                        shape.evaluator_input_length, shape.output_length);
+}
+
+// ================================================
+// MULTIPLICATIVE COMPLEXITY
+// ================================================
+
+/*
+ * Any function of three inputs x0, x1, x2 can be written with at most two
+ * ANDs. Affine functions are 4-bit masks: bits 0-2 select inputs, bit 3 adds
+ * the constant 1. A recipe is one of
+ *   0 ANDs: f = A3
+ *   1 AND:  f = (A1 & A2) ^ A3
+ *   2 ANDs: f = (((A1 & A2) ^ A3) & A4) ^ A5
+ */
+struct Recipe {
+  int ands;
+  uint8_t a1, a2, a3, a4, a5;
+};
+
+uint8_t affine_table(int mask) {
+  return (mask & 1 ? 0xAA : 0) ^ (mask & 2 ? 0xCC : 0) ^ (mask & 4 ? 0xF0 : 0) ^
+         (mask & 8 ? 0xFF : 0);
+}
+
+/*
+ * Cheapest recipe for every 3-input truth table, found by exhaustive search.
+ */
+const std::vector<Recipe> &recipes() {
+  static const std::vector<Recipe> table = [] {
+    std::vector<int> affine_mask(256, -1);
+    for (int m = 0; m < 16; m++)
+      affine_mask[affine_table(m)] = m;
+
+    std::vector<Recipe> table(256, Recipe{3, 0, 0, 0, 0, 0});
+    for (int f = 0; f < 256; f++) {
+      if (affine_mask[f] >= 0)
+        table[f] = {0, 0, 0, (uint8_t)affine_mask[f], 0, 0};
+    }
+    for (int a1 = 1; a1 < 8; a1++) {
+      for (int a2 = a1 + 1; a2 < 8; a2++) {
+        uint8_t prod = affine_table(a1) & affine_table(a2);
+        for (int a3 = 0; a3 < 16; a3++) {
+          uint8_t f = prod ^ affine_table(a3);
+          if (table[f].ands > 1)
+            table[f] = {1, (uint8_t)a1, (uint8_t)a2, (uint8_t)a3, 0, 0};
+        }
+      }
+    }
+    for (int a1 = 1; a1 < 8; a1++) {
+      for (int a2 = a1 + 1; a2 < 8; a2++) {
+        for (int a3 = 0; a3 < 16; a3++) {
+          uint8_t t = (affine_table(a1) & affine_table(a2)) ^ affine_table(a3);
+          for (int a4 = 1; a4 < 16; a4++) {
+            for (int a5 = 0; a5 < 16; a5++) {
+              uint8_t f = (t & affine_table(a4)) ^ affine_table(a5);
+              if (table[f].ands > 2)
+                table[f] = {2,           (uint8_t)a1, (uint8_t)a2,
+                            (uint8_t)a3, (uint8_t)a4, (uint8_t)a5};
+            }
+          }
+        }
+      }
+    }
+    return table;
+  }();
+  return table;
+}
+
+const int MAX_CUT = 3;
+const int MAX_CUTS_PER_NODE = 12;
+
+// Sorted leaf nodes; unused slots are 0.
+struct Cut {
+  int size;
+  int leaves[MAX_CUT];
+};
+
+/*
+ * Enumerate cuts of up to three leaves for every node, bottom up.
+ */
+std::vector<std::vector<Cut>> enumerate_cuts(const LogicGraph &graph,
+                                             int num_inputs) {
+  std::vector<std::vector<Cut>> cuts(graph.nodes.size());
+  for (int node = 1; node < graph.nodes.size(); node++) {
+    cuts[node].push_back({1, {node, 0, 0}});
+    if (node <= num_inputs)
+      continue;
+    const Node &n = graph.nodes[node];
+    for (const Cut &c1 : cuts[node_of(n.lhs)]) {
+      for (const Cut &c2 : cuts[node_of(n.rhs)]) {
+        // Merge two sorted leaf lists.
+        Cut merged = {0, {0, 0, 0}};
+        int i = 0, j = 0;
+        bool fits = true;
+        while (fits && (i < c1.size || j < c2.size)) {
+          int next;
+          if (j == c2.size || (i < c1.size && c1.leaves[i] < c2.leaves[j]))
+            next = c1.leaves[i++];
+          else if (i == c1.size || c2.leaves[j] < c1.leaves[i])
+            next = c2.leaves[j++];
+          else
+            next = (i++, c2.leaves[j++]);
+          if (merged.size == MAX_CUT)
+            fits = false;
+          else
+            merged.leaves[merged.size++] = next;
+        }
+        if (!fits)
+          continue;
+        bool seen = false;
+        for (const Cut &c : cuts[node]) {
+          seen = seen || (c.size == merged.size &&
+                          std::equal(c.leaves, c.leaves + c.size,
+                                     merged.leaves));
+        }
+        if (!seen && cuts[node].size() < MAX_CUTS_PER_NODE)
+          cuts[node].push_back(merged);
+      }
+    }
+  }
+  return cuts;
+}
+
+/*
+ * Truth table of node over the leaves of cut.
+ */
+uint8_t cone_table(const LogicGraph &graph, int node, const Cut &cut) {
+  for (int i = 0; i < cut.size; i++) {
+    if (cut.leaves[i] == node)
+      return affine_table(1 << i);
+  }
+  if (node == 0)
+    return 0;
+  const Node &n = graph.nodes[node];
+  uint8_t lhs = cone_table(graph, node_of(n.lhs), cut) ^ (negated(n.lhs) ? 0xFF : 0);
+  uint8_t rhs = cone_table(graph, node_of(n.rhs), cut) ^ (negated(n.rhs) ? 0xFF : 0);
+  return n.type == GateType::AND_GATE ? lhs & rhs : lhs ^ rhs;
+}
+
+/*
+ * ANDs that would become dead if node were no longer used: the AND gates of
+ * its maximum fanout-free cone above the cut. Leaves refs as it found them.
+ */
+int mffc_ands(const LogicGraph &graph, int node, const Cut &cut,
+              std::vector<int> &refs, std::vector<int> &touched) {
+  const Node &n = graph.nodes[node];
+  int count = n.type == GateType::AND_GATE;
+  for (int lit : {n.lhs, n.rhs}) {
+    int child = node_of(lit);
+    if (child == 0 || std::find(cut.leaves, cut.leaves + cut.size, child) !=
+                          cut.leaves + cut.size)
+      continue;
+    touched.push_back(child);
+    if (--refs[child] == 0)
+      count += mffc_ands(graph, child, cut, refs, touched);
+  }
+  return count;
+}
+
+/*
+ * One round of cut rewriting: rebuild graph, replacing a node's cone by a
+ * recipe wherever that frees more ANDs than the recipe needs.
+ */
+LogicGraph rewrite_round(const LogicGraph &graph, std::vector<int> &output_lits,
+                         int num_inputs) {
+  std::vector<int> refs(graph.nodes.size(), 0);
+  for (int node = num_inputs + 1; node < graph.nodes.size(); node++) {
+    refs[node_of(graph.nodes[node].lhs)]++;
+    refs[node_of(graph.nodes[node].rhs)]++;
+  }
+  for (int lit : output_lits)
+    refs[node_of(lit)]++;
+  std::vector<std::vector<Cut>> cuts = enumerate_cuts(graph, num_inputs);
+
+  LogicGraph rewritten(num_inputs);
+  std::vector<int> new_lit(graph.nodes.size());
+  new_lit[0] = FALSE_LIT;
+  for (int i = 0; i < num_inputs; i++)
+    new_lit[i + 1] = rewritten.input(i);
+  auto map = [&](int lit) { return new_lit[node_of(lit)] ^ negated(lit); };
+
+  std::vector<int> touched;
+  for (int node = num_inputs + 1; node < graph.nodes.size(); node++) {
+    const Node &n = graph.nodes[node];
+    const Cut *best = nullptr;
+    int best_gain = 0;
+    for (const Cut &cut : cuts[node]) {
+      if (cut.size == 1)
+        continue;
+      const Recipe &recipe = recipes()[cone_table(graph, node, cut)];
+      touched.clear();
+      int freed = mffc_ands(graph, node, cut, refs, touched);
+      for (int child : touched)
+        refs[child]++;
+      if (freed - recipe.ands > best_gain) {
+        best_gain = freed - recipe.ands;
+        best = &cut;
+      }
+    }
+    if (best == nullptr) {
+      new_lit[node] = n.type == GateType::AND_GATE
+                          ? rewritten.make_and(map(n.lhs), map(n.rhs))
+                          : rewritten.make_xor(map(n.lhs), map(n.rhs));
+      continue;
+    }
+
+    const Recipe &recipe = recipes()[cone_table(graph, node, *best)];
+    int leaves[MAX_CUT] = {FALSE_LIT, FALSE_LIT, FALSE_LIT};
+    for (int i = 0; i < best->size; i++)
+      leaves[i] = new_lit[best->leaves[i]];
+    auto affine = [&](int mask) {
+      int lit = mask & 8 ? TRUE_LIT : FALSE_LIT;
+      for (int i = 0; i < MAX_CUT; i++) {
+        if (mask & (1 << i))
+          lit = rewritten.make_xor(lit, leaves[i]);
+      }
+      return lit;
+    };
+    int lit = affine(recipe.a3);
+    if (recipe.ands >= 1)
+      lit = rewritten.make_xor(
+          rewritten.make_and(affine(recipe.a1), affine(recipe.a2)), lit);
+    if (recipe.ands == 2)
+      lit = rewritten.make_xor(rewritten.make_and(lit, affine(recipe.a4)),
+                               affine(recipe.a5));
+    new_lit[node] = lit;
+  }
+  for (int &lit : output_lits)
+    lit = map(lit);
+  return rewritten;
+}
+
+int count_live_ands(const LogicGraph &graph, const std::vector<int> &output_lits,
+                    int num_inputs) {
+  std::vector<bool> live(graph.nodes.size(), false);
+  for (int lit : output_lits)
+    live[node_of(lit)] = true;
+  int ands = 0;
+  for (int node = graph.nodes.size() - 1; node > num_inputs; node--) {
+    if (live[node]) {
+      ands += graph.nodes[node].type == GateType::AND_GATE;
+      live[node_of(graph.nodes[node].lhs)] = true;
+      live[node_of(graph.nodes[node].rhs)] = true;
+    }
+  }
+  return ands;
+}
+} // namespace
+
+/*
+ * Count gates by type.
+ */
+GateCounts count_gates(const Circuit &circuit) {
+  GateCounts counts = {0, 0, 0};
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::AND_GATE)
+      counts.and_gates++;
+    else if (gate.type == GateType::XOR_GATE)
+      counts.xor_gates++;
+    else
+      counts.not_gates++;
+  }
+  return counts;
+}
+
+/*
+ * Optimize circuit; see circuit_optimizer.hpp.
+ */
+Circuit optimize_circuit(const Circuit &circuit) {
+  std::vector<int> output_lits;
+  LogicGraph graph = build_graph(circuit, output_lits);
+  return emit_graph(graph, output_lits, circuit);
+}
+
+/*
+ * Cone of outputs; see circuit_optimizer.hpp. emit_graph already keeps only
+ * what the outputs it is given depend on.
+ */
+Circuit output_cone(const Circuit &circuit, const std::vector<int> &outputs) {
+  std::vector<int> output_lits;
+  LogicGraph graph = build_graph(circuit, output_lits);
+  std::vector<int> chosen;
+  for (int output : outputs) {
+    if (output < 0 || output >= circuit.output_length)
+      throw std::runtime_error("No output " + std::to_string(output) +
+                               " in circuit.");
+    chosen.push_back(output_lits[output]);
+  }
+  Circuit shape = circuit;
+  shape.output_length = outputs.size();
+  return emit_graph(graph, chosen, shape);
+}
+
+/*
+ * Reduce AND gates; see circuit_optimizer.hpp.
+ */
+Circuit minimize_and_gates(const Circuit &circuit, int max_rounds) {
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<int> output_lits;
+  LogicGraph graph = build_graph(circuit, output_lits);
+  int ands = count_live_ands(graph, output_lits, num_inputs);
+  for (int round = 0; round < max_rounds; round++) {
+    std::vector<int> next_lits = output_lits;
+    LogicGraph next = rewrite_round(graph, next_lits, num_inputs);
+    int next_ands = count_live_ands(next, next_lits, num_inputs);
+    if (next_ands >= ands)
+      break;
+    graph = std::move(next);
+    output_lits = std::move(next_lits);
+    ands = next_ands;
+  }
+  return emit_graph(graph, output_lits, circuit);
+}
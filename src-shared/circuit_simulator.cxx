@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "circuit_simulator.hpp"
+
+namespace {
+typedef uint64_t Word256 __attribute__((vector_size(32)));
+
+// The 256-lane kernel is also built for AVX2 and picked at load time.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMULATOR_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMULATOR_TARGETS
+#endif
+
+template <typename Word>
+[[gnu::always_inline]] inline void evaluate(const Gate *ops, size_t n,
+                                            Word *w) {
+  for (size_t i = 0; i < n; i++) {
+    const Gate &g = ops[i];
+    if (g.type == GateType::AND_GATE)
+      w[g.output] = w[g.lhs] & w[g.rhs];
+    else if (g.type == GateType::XOR_GATE)
+      w[g.output] = w[g.lhs] ^ w[g.rhs];
+    else
+      w[g.output] = ~w[g.lhs];
+  }
+}
+
+void evaluate64(const Gate *ops, size_t n, uint64_t *w) {
+  evaluate(ops, n, w);
+}
+
+SIMULATOR_TARGETS void evaluate256(const Gate *ops, size_t n, Word256 *w) {
+  evaluate(ops, n, w);
+}
+} // namespace
+
+/*
+ * Constructor. Rewrites the gates onto label slots once up front.
+ */
+CircuitSimulator::CircuitSimulator(const Circuit &circuit) {
+  WireSlots slots = assign_wire_slots(circuit);
+  this->num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  this->num_slots = slots.num_slots;
+  this->ops.reserve(circuit.gates.size());
+  for (const Gate &gate : circuit.gates) {
+    int rhs = gate.type == GateType::NOT_GATE ? 0 : slots.slot[gate.rhs];
+    this->ops.push_back(
+        {gate.type, slots.slot[gate.lhs], rhs, slots.slot[gate.output]});
+  }
+  for (int w = circuit.num_wire - circuit.output_length; w < circuit.num_wire;
+       w++)
+    this->output_slots.push_back(slots.slot[w]);
+}
+
+std::vector<int> CircuitSimulator::run(const std::vector<int> &input) const {
+  std::vector<uint64_t> words(input.begin(), input.end());
+  std::vector<uint64_t> output = this->run64(words);
+  std::vector<int> bits(output.size());
+  for (int i = 0; i < output.size(); i++)
+    bits[i] = output[i] & 1;
+  return bits;
+}
+
+std::vector<uint64_t>
+CircuitSimulator::run64(const std::vector<uint64_t> &input) const {
+  if (input.size() != this->num_inputs)
+    throw std::runtime_error("Simulator input does not match the circuit.");
+  std::vector<uint64_t> wires(this->num_slots);
+  std::copy(input.begin(), input.end(), wires.begin());
+  evaluate64(this->ops.data(), this->ops.size(), wires.data());
+  std::vector<uint64_t> output;
+  output.reserve(this->output_slots.size());
+  for (int slot : this->output_slots)
+    output.push_back(wires[slot]);
+  return output;
+}
+
+std::vector<uint64_t>
+CircuitSimulator::run256(const std::vector<uint64_t> &input) const {
+  if (input.size() != 4 * this->num_inputs)
+    throw std::runtime_error("Simulator input does not match the circuit.");
+  // new[] honours the vector type's alignment; std::vector drops it.
+  std::unique_ptr<Word256[]> wires(new Word256[this->num_slots]());
+  std::memcpy(wires.get(), input.data(), input.size() * sizeof(uint64_t));
+  evaluate256(this->ops.data(), this->ops.size(), wires.get());
+  std::vector<uint64_t> output(4 * this->output_slots.size());
+  for (int i = 0; i < this->output_slots.size(); i++)
+    std::memcpy(&output[4 * i], &wires[this->output_slots[i]],
+                sizeof(Word256));
+  return output;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <crypto++/sha.h>
+
+#include "compiled_circuit.hpp"
+#include "util.hpp"
+
+static_assert(std::endian::native == std::endian::little,
+              "compiled circuits are stored little endian");
+
+namespace {
+const char MAGIC[8] = {'Y', 'A', 'O', 'S', 'C', 'I', 'R', 'C'};
+const uint32_t VERSION = 2;
+const uint64_t SECTION_ALIGN = 64;
+
+uint64_t align_up(uint64_t n) {
+  return (n + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+void sha256(const unsigned char *data, size_t size, unsigned char *digest) {
+  CryptoPP::SHA256 hash;
+  hash.Update(data, size);
+  hash.Final(digest);
+}
+} // namespace
+
+/*
+ * Write circuit to filename in the compiled format, with its levels and wire
+ * liveness precomputed.
+ */
+void compile_circuit(const Circuit &circuit, std::string filename) {
+  std::vector<uint32_t> levels = compute_gate_levels(circuit);
+  std::vector<uint32_t> last_use = compute_wire_last_use(circuit);
+
+  CompiledCircuitHeader header = {};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.header_size = sizeof(CompiledCircuitHeader);
+  header.num_gate = circuit.gates.size();
+  header.num_wire = circuit.num_wire;
+  header.garbler_input_length = circuit.garbler_input_length;
+  header.evaluator_input_length = circuit.evaluator_input_length;
+  header.output_length = circuit.output_length;
+  header.num_levels = 0;
+  for (uint32_t level : levels)
+    header.num_levels = std::max(header.num_levels, level + 1);
+  header.flags = circuit.level_offsets.empty() ? 0 : COMPILED_SCHEDULED;
+  header.gates_offset = align_up(sizeof(CompiledCircuitHeader));
+  header.levels_offset =
+      align_up(header.gates_offset + circuit.gates.size() * sizeof(Gate));
+  header.last_use_offset =
+      align_up(header.levels_offset + levels.size() * sizeof(uint32_t));
+  header.file_size = header.last_use_offset + last_use.size() * sizeof(uint32_t);
+
+  std::vector<unsigned char> file(header.file_size, 0);
+  std::memcpy(file.data() + header.gates_offset, circuit.gates.data(),
+              circuit.gates.size_bytes());
+  std::memcpy(file.data() + header.levels_offset, levels.data(),
+              levels.size() * sizeof(uint32_t));
+  std::memcpy(file.data() + header.last_use_offset, last_use.data(),
+              last_use.size() * sizeof(uint32_t));
+  sha256(file.data() + sizeof(header), file.size() - sizeof(header),
+         header.checksum);
+  std::memcpy(file.data(), &header, sizeof(header));
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(file.data()), file.size());
+  if (!out) {
+    throw std::runtime_error("Could not write compiled circuit " + filename);
+  }
+}
+
+/*
+ * Map a compiled circuit and check its gates as parse_circuit does. The
+ * checksum is only verified when verify_checksum is set.
+ * @throws error if the file is not a valid compiled circuit.
+ */
+CompiledCircuit load_compiled_circuit(std::string filename,
+                                      bool verify_checksum) {
+  auto file = std::make_shared<const MappedFile>(filename);
+  auto fail = [&](std::string msg) {
+    throw std::runtime_error(filename + ": " + msg);
+  };
+  if (file->size < sizeof(CompiledCircuitHeader))
+    fail("too short for a compiled circuit");
+
+  CompiledCircuitHeader header;
+  std::memcpy(&header, file->data, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    fail("not a compiled circuit");
+  if (header.version != VERSION)
+    fail("unsupported compiled circuit version " +
+         std::to_string(header.version));
+  if (header.header_size != sizeof(CompiledCircuitHeader) ||
+      header.file_size != file->size)
+    fail("corrupt header");
+  if (header.num_gate < 0 || header.num_wire < 0 ||
+      header.garbler_input_length < 0 || header.evaluator_input_length < 0 ||
+      header.output_length < 0 || header.output_length > header.num_wire ||
+      header.garbler_input_length + (int64_t)header.evaluator_input_length >
+          header.num_wire)
+    fail("corrupt header");
+  // Every level holds at least one gate.
+  if (header.num_levels > (uint32_t)header.num_gate ||
+      (header.num_levels == 0 && header.num_gate > 0))
+    fail("corrupt level count");
+
+  // Sections must be aligned, in order and inside the file.
+  if (header.gates_offset > file->size || header.levels_offset > file->size ||
+      header.last_use_offset > file->size)
+    fail("corrupt section table");
+  uint64_t gates_end = header.gates_offset + header.num_gate * sizeof(Gate);
+  uint64_t levels_end =
+      header.levels_offset + header.num_gate * sizeof(uint32_t);
+  uint64_t last_use_end =
+      header.last_use_offset + header.num_wire * sizeof(uint32_t);
+  if (header.gates_offset % SECTION_ALIGN != 0 ||
+      header.levels_offset % SECTION_ALIGN != 0 ||
+      header.last_use_offset % SECTION_ALIGN != 0 ||
+      header.gates_offset < sizeof(header) ||
+      header.levels_offset < gates_end ||
+      header.last_use_offset < levels_end || last_use_end > file->size)
+    fail("corrupt section table");
+
+  CompiledCircuit compiled;
+  Circuit &circuit = compiled.circuit;
+  circuit.num_gate = header.num_gate;
+  circuit.num_wire = header.num_wire;
+  circuit.garbler_input_length = header.garbler_input_length;
+  circuit.evaluator_input_length = header.evaluator_input_length;
+  circuit.output_length = header.output_length;
+  circuit.gates = std::span<const Gate>(
+      reinterpret_cast<const Gate *>(file->data + header.gates_offset),
+      header.num_gate);
+  circuit.storage = file;
+  compiled.num_levels = header.num_levels;
+  compiled.gate_levels = std::span<const uint32_t>(
+      reinterpret_cast<const uint32_t *>(file->data + header.levels_offset),
+      header.num_gate);
+  compiled.wire_last_use = std::span<const uint32_t>(
+      reinterpret_cast<const uint32_t *>(file->data + header.last_use_offset),
+      header.num_wire);
+
+  if (verify_checksum) {
+    unsigned char digest[sizeof(header.checksum)];
+    sha256(file->data + sizeof(header), file->size - sizeof(header), digest);
+    if (std::memcmp(digest, header.checksum, sizeof(digest)) != 0)
+      fail("checksum mismatch");
+  }
+  // A matching checksum only says the file is intact, not that the writer
+  // produced a sound circuit, so the gate list is checked on every load.
+  try {
+    validate_circuit(circuit);
+  } catch (const std::runtime_error &e) {
+    fail(e.what());
+  }
+
+  if (header.flags & COMPILED_SCHEDULED) {
+    std::vector<int> &offsets = circuit.level_offsets;
+    offsets.assign((size_t)header.num_levels + 1, header.num_gate);
+    for (int i = header.num_gate - 1; i >= 0; i--) {
+      uint32_t level = compiled.gate_levels[i];
+      if (level >= header.num_levels ||
+          (i + 1 < header.num_gate && level > compiled.gate_levels[i + 1]))
+        fail("scheduled circuit is not sorted by level");
+      offsets[level] = i;
+    }
+    // Levels are non-empty, but be safe about gaps.
+    for (int l = header.num_levels - 1; l >= 0; l--)
+      offsets[l] = std::min(offsets[l], offsets[l + 1]);
+  }
+  return compiled;
+}
+
+/*
+ * Whether filename starts with the compiled circuit magic.
+ */
+bool is_compiled_circuit(std::string filename) {
+  char magic[sizeof(MAGIC)] = {};
+  std::ifstream in(filename, std::ios::binary);
+  in.read(magic, sizeof(magic));
+  return in && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/*
+ * Load a circuit from either a Bristol text file or a compiled file.
+ */
+Circuit load_circuit(std::string filename) {
+  if (is_compiled_circuit(filename))
+    return load_compiled_circuit(filename).circuit;
+  return parse_circuit(filename);
+}
+
+/*
+ * Load a circuit as load_circuit does and put its gates in level order, the
+ * order the garbler, evaluator and generated code all expect. Compiled
+ * circuits may already be scheduled.
+ */
+Circuit load_scheduled_circuit(std::string filename) {
+  Circuit circuit = load_circuit(filename);
+  if (circuit.level_offsets.empty())
+    circuit = schedule_circuit(circuit);
+  return circuit;
+}
@@ -0,0 +1,421 @@
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <crypto++/aes.h>
+#include <crypto++/misc.h>
+#include <crypto++/osrng.h>
+
+#include "../include-shared/kernels.hpp"
+
+// x86 kernels are built for their instruction sets and picked at run time,
+// so one binary runs on every host.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define YAOS_X86_KERNELS 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define YAOS_X86_KERNELS 0
+#endif
+
+namespace {
+// PRG blocks under one key before drawing a fresh one from the OS.
+const uint64_t PRG_REKEY_BLOCKS = 1 << 24;
+
+// Fixed, public key of the garbling hash: the first fractional hex digits
+// of pi, so nothing is up anyone's sleeve.
+const unsigned char HASH_KEY[16] = {0x24, 0x3f, 0x6a, 0x88, 0x85, 0xa3,
+                                    0x08, 0xd3, 0x13, 0x19, 0x8a, 0x2e,
+                                    0x03, 0x70, 0x73, 0x44};
+
+CpuFeatures detect_cpu_features() {
+  CpuFeatures features = {};
+#if YAOS_X86_KERNELS
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return features;
+  features.aes = ecx & bit_AES;
+  // The OS must save YMM (and for AVX-512, ZMM and mask) state too.
+  uint64_t xcr0 = 0;
+  if (ecx & bit_OSXSAVE) {
+    uint32_t lo, hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    xcr0 = ((uint64_t)hi << 32) | lo;
+  }
+  bool ymm = (xcr0 & 0x06) == 0x06, zmm = (xcr0 & 0xe6) == 0xe6;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    features.avx2 = ymm && (ebx & bit_AVX2);
+    features.avx512f = zmm && (ebx & bit_AVX512F);
+    features.vaes = ymm && (ecx & bit_VAES);
+  }
+#endif
+  return features;
+}
+
+// ================================================
+// XOR
+// ================================================
+
+void xor_scalar(unsigned char *out, const unsigned char *a,
+                const unsigned char *b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    x ^= y;
+    std::memcpy(out + i, &x, 8);
+  }
+  for (; i < n; i++)
+    out[i] = a[i] ^ b[i];
+}
+
+// Crypto++ picks its own AES implementation, which gives the same blocks.
+void aes_hash_scalar(const unsigned char *in, unsigned char *out, size_t n) {
+  thread_local CryptoPP::AES::Encryption cipher(HASH_KEY, sizeof(HASH_KEY));
+  for (size_t i = 0; i < n; i++)
+    cipher.ProcessAndXorBlock(in + 16 * i, in + 16 * i, out + 16 * i);
+}
+
+#if YAOS_X86_KERNELS
+__attribute__((target("sse2"))) void
+xor_sse2(unsigned char *out, const unsigned char *a, const unsigned char *b,
+         size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_xor_si128(x, y));
+  }
+  xor_scalar(out + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+xor_avx2(unsigned char *out, const unsigned char *a, const unsigned char *b,
+         size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_xor_si256(x, y));
+  }
+  xor_scalar(out + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void
+xor_avx512(unsigned char *out, const unsigned char *a, const unsigned char *b,
+           size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i x = _mm512_loadu_si512(a + i);
+    __m512i y = _mm512_loadu_si512(b + i);
+    _mm512_storeu_si512(out + i, _mm512_xor_si512(x, y));
+  }
+  xor_scalar(out + i, a + i, b + i, n - i);
+}
+
+// ================================================
+// AES
+// ================================================
+
+__attribute__((target("aes,sse2"))) inline __m128i
+aes_expand_step(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+// The round constant must be an immediate, hence a macro.
+#define AES_EXPAND_ROUND(rk, i, rcon)                                          \
+  rk[i] = aes_expand_step(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+__attribute__((target("aes,sse2"))) void aes_expand_ni(const unsigned char *key,
+                                                       AesKey &out) {
+  __m128i rk[11];
+  rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key));
+  AES_EXPAND_ROUND(rk, 1, 0x01);
+  AES_EXPAND_ROUND(rk, 2, 0x02);
+  AES_EXPAND_ROUND(rk, 3, 0x04);
+  AES_EXPAND_ROUND(rk, 4, 0x08);
+  AES_EXPAND_ROUND(rk, 5, 0x10);
+  AES_EXPAND_ROUND(rk, 6, 0x20);
+  AES_EXPAND_ROUND(rk, 7, 0x40);
+  AES_EXPAND_ROUND(rk, 8, 0x80);
+  AES_EXPAND_ROUND(rk, 9, 0x1b);
+  AES_EXPAND_ROUND(rk, 10, 0x36);
+  for (int i = 0; i < 11; i++)
+    _mm_store_si128(reinterpret_cast<__m128i *>(out.round_keys[i]), rk[i]);
+}
+
+// Four independent blocks at a time keep the AES unit's pipeline full.
+__attribute__((target("aes,sse2"))) void
+aes_encrypt_ni(const AesKey &key, const unsigned char *in, unsigned char *out,
+               size_t n) {
+  __m128i rk[11];
+  for (int r = 0; r < 11; r++)
+    rk[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(key.round_keys[r]));
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x[4];
+    for (int j = 0; j < 4; j++) {
+      x[j] = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(in) + i + j),
+          rk[0]);
+    }
+    for (int r = 1; r < 10; r++) {
+      for (int j = 0; j < 4; j++)
+        x[j] = _mm_aesenc_si128(x[j], rk[r]);
+    }
+    for (int j = 0; j < 4; j++) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i + j,
+                       _mm_aesenclast_si128(x[j], rk[10]));
+    }
+  }
+  for (; i < n; i++) {
+    __m128i x = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in) + i), rk[0]);
+    for (int r = 1; r < 10; r++)
+      x = _mm_aesenc_si128(x, rk[r]);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i,
+                     _mm_aesenclast_si128(x, rk[10]));
+  }
+}
+
+// Each 512-bit register holds four blocks; sixteen are in flight at once.
+__attribute__((target("aes,sse2,avx512f,vaes"))) void
+aes_encrypt_vaes(const AesKey &key, const unsigned char *in,
+                 unsigned char *out, size_t n) {
+  __m512i rk[11];
+  for (int r = 0; r < 11; r++) {
+    rk[r] = _mm512_broadcast_i32x4(
+        _mm_load_si128(reinterpret_cast<const __m128i *>(key.round_keys[r])));
+  }
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x[4];
+    for (int j = 0; j < 4; j++)
+      x[j] = _mm512_xor_si512(_mm512_loadu_si512(in + 16 * (i + 4 * j)), rk[0]);
+    for (int r = 1; r < 10; r++) {
+      for (int j = 0; j < 4; j++)
+        x[j] = _mm512_aesenc_epi128(x[j], rk[r]);
+    }
+    for (int j = 0; j < 4; j++) {
+      _mm512_storeu_si512(out + 16 * (i + 4 * j),
+                          _mm512_aesenclast_epi128(x[j], rk[10]));
+    }
+  }
+  aes_encrypt_ni(key, in + 16 * i, out + 16 * i, n - i);
+}
+
+const AesKey &hash_key_ni() {
+  static const AesKey key = [] {
+    AesKey expanded;
+    aes_expand_ni(HASH_KEY, expanded);
+    return expanded;
+  }();
+  return key;
+}
+
+void aes_hash_ni(const unsigned char *in, unsigned char *out, size_t n) {
+  aes_encrypt_ni(hash_key_ni(), in, out, n);
+  xor_sse2(out, out, in, 16 * n);
+}
+
+void aes_hash_vaes(const unsigned char *in, unsigned char *out, size_t n) {
+  aes_encrypt_vaes(hash_key_ni(), in, out, n);
+  xor_avx512(out, out, in, 16 * n);
+}
+#endif
+
+// ================================================
+// REGISTRY
+// ================================================
+
+const Kernels SCALAR = {"scalar", xor_scalar, nullptr, nullptr,
+                        aes_hash_scalar};
+#if YAOS_X86_KERNELS
+const Kernels AESNI = {"aesni", xor_sse2, aes_expand_ni, aes_encrypt_ni,
+                       aes_hash_ni};
+const Kernels AVX2 = {"avx2", xor_avx2, aes_expand_ni, aes_encrypt_ni,
+                      aes_hash_ni};
+const Kernels VAES = {"vaes", xor_avx512, aes_expand_ni, aes_encrypt_vaes,
+                      aes_hash_vaes};
+const Kernels *ALL[] = {&SCALAR, &AESNI, &AVX2, &VAES};
+#else
+const Kernels *ALL[] = {&SCALAR};
+#endif
+
+bool can_run(const Kernels *k, const CpuFeatures &f) {
+#if YAOS_X86_KERNELS
+  if (k == &AESNI)
+    return f.aes;
+  if (k == &AVX2)
+    return f.aes && f.avx2;
+  if (k == &VAES)
+    return f.aes && f.avx512f && f.vaes;
+#endif
+  return true;
+}
+
+const Kernels *best_kernels() {
+  const Kernels *best = &SCALAR;
+  for (const Kernels *k : ALL) {
+    if (can_run(k, cpu_features()))
+      best = k;
+  }
+  return best;
+}
+
+std::atomic<const Kernels *> selected{nullptr};
+
+/*
+ * Per-thread PRG: AES-128 in counter mode, rekeyed from the OS every
+ * PRG_REKEY_BLOCKS blocks.
+ */
+struct PrgState {
+  AesKey key;
+  uint64_t counter = 0;
+  uint64_t remaining = 0; // blocks left under key
+};
+thread_local PrgState prg;
+
+void prg_rekey(const Kernels &k) {
+  unsigned char seed[16];
+  CryptoPP::OS_GenerateRandomBlock(false, seed, sizeof(seed));
+  k.aes_expand(seed, prg.key);
+  CryptoPP::SecureWipeArray(seed, sizeof(seed));
+  prg.counter = 0;
+  prg.remaining = PRG_REKEY_BLOCKS;
+}
+
+// x = 2x in GF(2^128), x a little-endian 128-bit number.
+void gf_double(unsigned char *x) {
+  unsigned char carry = x[15] >> 7;
+  for (int i = 15; i > 0; i--)
+    x[i] = (x[i] << 1) | (x[i - 1] >> 7);
+  x[0] = (x[0] << 1) ^ (carry * 0x87);
+}
+
+// Counter blocks counter, counter + 1, ... into out, little endian.
+void fill_counters(unsigned char *out, size_t n, uint64_t counter) {
+  std::memset(out, 0, 16 * n);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t c = counter + i;
+    std::memcpy(out + 16 * i, &c, sizeof(c));
+  }
+}
+} // namespace
+
+const CpuFeatures &cpu_features() {
+  static const CpuFeatures features = detect_cpu_features();
+  return features;
+}
+
+const Kernels &kernels() {
+  const Kernels *k = selected.load(std::memory_order_acquire);
+  if (k == nullptr) {
+    k = best_kernels();
+    selected.store(k, std::memory_order_release);
+  }
+  return *k;
+}
+
+void select_kernels(const std::string &name) {
+  if (name == "auto") {
+    selected.store(best_kernels(), std::memory_order_release);
+    return;
+  }
+  for (const Kernels *k : ALL) {
+    if (name != k->name)
+      continue;
+    if (!can_run(k, cpu_features())) {
+      throw std::runtime_error("This CPU cannot run the " + name +
+                               " kernels.");
+    }
+    selected.store(k, std::memory_order_release);
+    return;
+  }
+  throw std::runtime_error("Unknown kernels " + name);
+}
+
+std::vector<std::string> supported_kernels() {
+  std::vector<std::string> names;
+  for (const Kernels *k : ALL) {
+    if (can_run(k, cpu_features()))
+      names.push_back(k->name);
+  }
+  return names;
+}
+
+/*
+ * E.g. "vaes (cpu: aes avx2 avx512f vaes)".
+ */
+std::string describe_kernels() {
+  const CpuFeatures &f = cpu_features();
+  std::string cpu;
+  for (auto [flag, name] : {std::pair{f.aes, "aes"}, {f.avx2, "avx2"},
+                            {f.avx512f, "avx512f"}, {f.vaes, "vaes"}}) {
+    if (flag)
+      cpu += std::string(cpu.empty() ? "" : " ") + name;
+  }
+  return std::string(kernels().name) + " (cpu: " +
+         (cpu.empty() ? "baseline" : cpu) + ")";
+}
+
+void random_bytes(unsigned char *out, size_t n) {
+  const Kernels &k = kernels();
+  if (k.aes_encrypt == nullptr) {
+    CryptoPP::OS_GenerateRandomBlock(false, out, n);
+    return;
+  }
+  size_t blocks = (n + 15) / 16;
+  if (prg.remaining < blocks) {
+    if (blocks > PRG_REKEY_BLOCKS) {
+      throw std::runtime_error("Too many random bytes in one call.");
+    }
+    prg_rekey(k);
+  }
+  // Whole blocks are encrypted in place; a partial last block goes through
+  // a scratch block.
+  size_t whole = n / 16;
+  fill_counters(out, whole, prg.counter);
+  k.aes_encrypt(prg.key, out, out, whole);
+  if (whole < blocks) {
+    unsigned char last[16];
+    fill_counters(last, 1, prg.counter + whole);
+    k.aes_encrypt(prg.key, last, last, 1);
+    std::memcpy(out + 16 * whole, last, n - 16 * whole);
+    CryptoPP::SecureWipeArray(last, sizeof(last));
+  }
+  prg.counter += blocks;
+  prg.remaining -= blocks;
+}
+
+void garbling_hash(const unsigned char *x, const unsigned char *y,
+                   size_t label_length, unsigned char *out,
+                   size_t out_length) {
+  if (label_length > 16 || out_length > 32) {
+    throw std::runtime_error("Garbling hash is for labels of up to 16 bytes.");
+  }
+  // K = 2X ^ 4Y, then one block per tweak j.
+  alignas(16) unsigned char in[2][16] = {}, y4[16] = {};
+  alignas(16) unsigned char hashed[2][16];
+  std::memcpy(in[0], x, label_length);
+  std::memcpy(y4, y, label_length);
+  gf_double(in[0]);
+  gf_double(y4);
+  gf_double(y4);
+  xor_scalar(in[0], in[0], y4, 16);
+  std::memcpy(in[1], in[0], 16);
+  in[1][0] ^= 1;
+  size_t blocks = (out_length + 15) / 16;
+  kernels().aes_hash(in[0], hashed[0], blocks);
+  std::memcpy(out, hashed, out_length);
+  CryptoPP::SecureWipeArray(&in[0][0], sizeof(in));
+  CryptoPP::SecureWipeArray(y4, sizeof(y4));
+  CryptoPP::SecureWipeArray(&hashed[0][0], sizeof(hashed));
+}
@@ -1,26 +1,34 @@
+#include <mutex>
+
 #include "logger.hpp"
 
 /**
  * Initialize logger.
  */
 void initLogger(logging::trivial::severity_level level) {
-  // New attributes that hold filename and line number
-  logging::core::get()->add_global_attribute(
-      "File", attrs::mutable_constant<std::string>(""));
-  logging::core::get()->add_global_attribute("Line",
-                                             attrs::mutable_constant<int>(0));
-
   // Exclude logs below the specified level
   logging::core::get()->set_filter(logging::trivial::severity >= level);
 
-  // A console log with severity, filename, line and message
-  logging::add_console_log(
-      std::clog,
-      keywords::format =
-          (expr::stream << "<" << boost::log::trivial::severity << "> " << '['
-                        << expr::attr<std::string>("File") << ':'
-                        << expr::attr<int>("Line") << "] " << expr::smessage));
-  logging::add_common_attributes();
+  // Attributes and the console sink are process wide; every client calls
+  // initLogger, so only set them up the first time.
+  static std::once_flag initialized;
+  std::call_once(initialized, [] {
+    // New attributes that hold filename and line number
+    logging::core::get()->add_global_attribute(
+        "File", locked_mutable_constant<std::string>(""));
+    logging::core::get()->add_global_attribute(
+        "Line", locked_mutable_constant<int>(0));
+
+    // A console log with severity, filename, line and message
+    logging::add_console_log(
+        std::clog,
+        keywords::format =
+            (expr::stream << "<" << boost::log::trivial::severity << "> "
+                          << '[' << expr::attr<std::string>("File") << ':'
+                          << expr::attr<int>("Line") << "] "
+                          << expr::smessage));
+    logging::add_common_attributes();
+  });
 }
 
 /**
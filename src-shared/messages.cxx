@@ -46,6 +46,45 @@ int put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data) {
   return put_string(CryptoPP::IntToString(i), data);
 }
 
+/**
+ * Puts the label width into the end of data, so a peer built with another
+ * YAOS_LABEL_BITS is caught before its labels are read.
+ */
+int put_label_length(std::vector<unsigned char> &data) {
+  data.push_back(LABEL_LENGTH);
+  return 1;
+}
+
+/**
+ * Puts the labels into the end of data: their count, the label width and
+ * then the raw labels, LABEL_LENGTH bytes each.
+ */
+int put_labels(const std::vector<GarbledWire> &labels,
+               std::vector<unsigned char> &data) {
+  int idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_labels = labels.size();
+  std::memcpy(&data[idx], &num_labels, sizeof(size_t));
+  put_label_length(data);
+  for (const GarbledWire &label : labels) {
+    data.insert(data.end(), label.value.bytes.begin(), label.value.bytes.end());
+  }
+  return data.size() - idx;
+}
+
+/**
+ * Checks the label width at index idx matches this build's.
+ * @throws error if it does not.
+ */
+int get_label_length(std::vector<unsigned char> &data, int idx) {
+  if (data[idx] != LABEL_LENGTH) {
+    throw std::runtime_error("Peer uses " + std::to_string(8 * data[idx]) +
+                             "-bit labels, not " +
+                             std::to_string(YAOS_LABEL_BITS));
+  }
+  return 1;
+}
+
 /**
  * Puts the nest bool from data at index idx into b.
  */
@@ -69,6 +108,24 @@ int get_string(std::string *s, std::vector<unsigned char> &data, int idx) {
   return sizeof(size_t) + str_size;
 }
 
+/**
+ * Puts the labels from data at index idx into labels, as put_labels wrote
+ * them.
+ */
+int get_labels(std::vector<GarbledWire> *labels,
+               std::vector<unsigned char> &data, int idx) {
+  size_t num_labels;
+  std::memcpy(&num_labels, &data[idx], sizeof(size_t));
+  int n = sizeof(size_t);
+  n += get_label_length(data, idx + n);
+  labels->resize(num_labels);
+  for (size_t i = 0; i < num_labels; i++) {
+    (*labels)[i].value = WireLabel::from_bytes(&data[idx + n]);
+    n += LABEL_LENGTH;
+  }
+  return n;
+}
+
 /**
  * Puts the next integer from data at index idx into i.
  */
@@ -237,6 +294,89 @@ int SenderToReceiver_OTEncryptedValues_Message::deserialize(
   return n;
 }
 
+void ReceiverToSender_OTBatchPublicValues_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::ReceiverToSender_OTBatchPublicValues_Message);
+
+  // Put number of values.
+  int idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->public_values.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each value.
+  for (int i = 0; i < num_values; i++) {
+    put_string(byteblock_to_string(this->public_values[i]), data);
+  }
+}
+
+int ReceiverToSender_OTBatchPublicValues_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::ReceiverToSender_OTBatchPublicValues_Message);
+
+  // Get number of values.
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  int n = 1 + sizeof(size_t);
+  this->public_values.resize(num_values);
+  for (int i = 0; i < num_values; i++) {
+    std::string public_integer;
+    n += get_string(&public_integer, data, n);
+    this->public_values[i] = string_to_byteblock(public_integer);
+  }
+  return n;
+}
+
+void SenderToReceiver_OTBatchEncryptedValues_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back(
+      (char)MessageType::SenderToReceiver_OTBatchEncryptedValues_Message);
+
+  // Put number of pairs.
+  int idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->values.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each pair.
+  for (int i = 0; i < num_values; i++) {
+    put_string(this->values[i].e0, data);
+    put_string(this->values[i].e1, data);
+    put_string(byteblock_to_string(this->values[i].iv0), data);
+    put_string(byteblock_to_string(this->values[i].iv1), data);
+  }
+}
+
+int SenderToReceiver_OTBatchEncryptedValues_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] ==
+         MessageType::SenderToReceiver_OTBatchEncryptedValues_Message);
+
+  // Get number of pairs.
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  int n = 1 + sizeof(size_t);
+  this->values.resize(num_values);
+  for (int i = 0; i < num_values; i++) {
+    n += get_string(&this->values[i].e0, data, n);
+    n += get_string(&this->values[i].e1, data, n);
+    std::string iv0, iv1;
+    n += get_string(&iv0, data, n);
+    n += get_string(&iv1, data, n);
+    this->values[i].iv0 = string_to_byteblock(iv0);
+    this->values[i].iv1 = string_to_byteblock(iv1);
+  }
+  return n;
+}
+
 // ================================================
 // GARBLED CIRCUITS
 // ================================================
@@ -246,21 +386,18 @@ void GarblerToEvaluator_GarbledTables_Message::serialize(
   // Add message type.
   data.push_back((char)MessageType::GarblerToEvaluator_GarbledTables_Message);
 
-  // Put length of garbled tables.
+  // Put length of garbled tables and the label width.
   int idx = data.size();
   data.resize(idx + sizeof(size_t));
   size_t num_tables = this->garbled_tables.size();
   std::memcpy(&data[idx], &num_tables, sizeof(size_t));
+  put_label_length(data);
 
-  // Put each table.
-  for (int i = 0; i < num_tables; i++) {
-    // Put num entries.
-    CryptoPP::Integer num_entries = this->garbled_tables[i].entries.size();
-    put_integer(num_entries, data);
-    for (int j = 0; j < num_entries; j++) {
-      std::string entry =
-          byteblock_to_string(this->garbled_tables[i].entries[j]);
-      put_string(entry, data);
+  // Put each table: its entry count, then the raw fixed-width entries.
+  for (const GarbledGate &table : this->garbled_tables) {
+    data.push_back(table.entries.size());
+    for (const GateEntry &entry : table.entries) {
+      data.insert(data.end(), entry.bytes.begin(), entry.bytes.end());
     }
   }
 }
@@ -276,16 +413,15 @@ int GarblerToEvaluator_GarbledTables_Message::deserialize(
 
   // Get fields.
   int n = 1 + sizeof(size_t);
-  for (int i = 0; i < num_tables; i++) {
-    GarbledGate gate;
-    CryptoPP::Integer num_entries;
-    n += get_integer(&num_entries, data, n);
-    for (int j = 0; j < num_entries; j++) {
-      std::string entry;
-      n += get_string(&entry, data, n);
-      gate.entries.push_back(string_to_byteblock(entry));
+  n += get_label_length(data, n);
+  this->garbled_tables.resize(num_tables);
+  for (GarbledGate &gate : this->garbled_tables) {
+    int num_entries = data[n++];
+    gate.entries.resize(num_entries);
+    for (GateEntry &entry : gate.entries) {
+      entry = GateEntry::from_bytes(&data[n]);
+      n += GateEntry::LENGTH;
     }
-    this->garbled_tables.push_back(gate);
   }
   return n;
 }
@@ -295,17 +431,8 @@ void GarblerToEvaluator_GarblerInputs_Message::serialize(
   // Add message type.
   data.push_back((char)MessageType::GarblerToEvaluator_GarblerInputs_Message);
 
-  // Put length of garbled inputs.
-  int idx = data.size();
-  data.resize(idx + sizeof(size_t));
-  size_t num_inputs = this->garbler_inputs.size();
-  std::memcpy(&data[idx], &num_inputs, sizeof(size_t));
-
-  // Put each table.
-  for (int i = 0; i < num_inputs; i++) {
-    std::string entry = byteblock_to_string(this->garbler_inputs[i].value);
-    put_string(entry, data);
-  }
+  // Add fields.
+  put_labels(this->garbler_inputs, data);
 }
 
 int GarblerToEvaluator_GarblerInputs_Message::deserialize(
@@ -313,18 +440,9 @@ int GarblerToEvaluator_GarblerInputs_Message::deserialize(
   // Check correct message type.
   assert(data[0] == MessageType::GarblerToEvaluator_GarblerInputs_Message);
 
-  // Get length
-  size_t num_inputs;
-  std::memcpy(&num_inputs, &data[1], sizeof(size_t));
-
   // Get fields.
-  int n = 1 + sizeof(size_t);
-  this->garbler_inputs.resize(num_inputs);
-  for (int i = 0; i < num_inputs; i++) {
-    std::string entry;
-    n += get_string(&entry, data, n);
-    this->garbler_inputs[i].value = string_to_byteblock(entry);
-  }
+  int n = 1;
+  n += get_labels(&this->garbler_inputs, data, n);
   return n;
 }
 
@@ -333,17 +451,8 @@ void EvaluatorToGarbler_FinalLabels_Message::serialize(
   // Add message type.
   data.push_back((char)MessageType::EvaluatorToGarbler_FinalLabels_Message);
 
-  // Put length of garbled inputs.
-  int idx = data.size();
-  data.resize(idx + sizeof(size_t));
-  size_t num_labels = this->final_labels.size();
-  std::memcpy(&data[idx], &num_labels, sizeof(size_t));
-
-  // Put each table.
-  for (int i = 0; i < num_labels; i++) {
-    std::string entry = byteblock_to_string(this->final_labels[i].value);
-    put_string(entry, data);
-  }
+  // Add fields.
+  put_labels(this->final_labels, data);
 }
 
 int EvaluatorToGarbler_FinalLabels_Message::deserialize(
@@ -351,18 +460,9 @@ int EvaluatorToGarbler_FinalLabels_Message::deserialize(
   // Check correct message type.
   assert(data[0] == MessageType::EvaluatorToGarbler_FinalLabels_Message);
 
-  // Get length
-  size_t num_labels;
-  std::memcpy(&num_labels, &data[1], sizeof(size_t));
-
   // Get fields.
-  int n = 1 + sizeof(size_t);
-  this->final_labels.resize(num_labels);
-  for (int i = 0; i < num_labels; i++) {
-    std::string entry;
-    n += get_string(&entry, data, n);
-    this->final_labels[i].value = string_to_byteblock(entry);
-  }
+  int n = 1;
+  n += get_labels(&this->final_labels, data, n);
   return n;
 }
 
@@ -385,3 +485,105 @@ int GarblerToEvaluator_FinalOutput_Message::deserialize(
   n += get_string(&this->final_output, data, n);
   return n;
 }
+
+// ================================================
+// SESSIONS
+// ================================================
+
+void GarblerToEvaluator_CircuitAnnouncement_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back(
+      (char)MessageType::GarblerToEvaluator_CircuitAnnouncement_Message);
+
+  // Add fields.
+  put_string(this->circuit_id, data);
+  put_string(this->fingerprint, data);
+}
+
+int GarblerToEvaluator_CircuitAnnouncement_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] ==
+         MessageType::GarblerToEvaluator_CircuitAnnouncement_Message);
+
+  // Get fields.
+  int n = 1;
+  n += get_string(&this->circuit_id, data, n);
+  n += get_string(&this->fingerprint, data, n);
+  return n;
+}
+
+// ================================================
+// STORED GARBLINGS
+// ================================================
+
+void GarblerToEvaluator_StoredGarbling_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::GarblerToEvaluator_StoredGarbling_Message);
+
+  // Add fields.
+  put_string(this->garbling_id, data);
+}
+
+int GarblerToEvaluator_StoredGarbling_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::GarblerToEvaluator_StoredGarbling_Message);
+
+  // Get fields.
+  int n = 1;
+  n += get_string(&this->garbling_id, data, n);
+  return n;
+}
+
+// ================================================
+// OUTPUT QUERIES
+// ================================================
+
+void EvaluatorToGarbler_OutputQuery_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::EvaluatorToGarbler_OutputQuery_Message);
+
+  // Put number of outputs, then each index.
+  int idx = data.size();
+  size_t num_outputs = this->outputs.size();
+  data.resize(idx + sizeof(size_t) + num_outputs * sizeof(int32_t));
+  std::memcpy(&data[idx], &num_outputs, sizeof(size_t));
+  for (int i = 0; i < num_outputs; i++) {
+    int32_t output = this->outputs[i];
+    std::memcpy(&data[idx + sizeof(size_t) + i * sizeof(int32_t)], &output,
+                sizeof(int32_t));
+  }
+}
+
+int EvaluatorToGarbler_OutputQuery_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  const size_t header = 1 + sizeof(size_t);
+  if (data.size() < header) {
+    throw std::runtime_error("Truncated output query.");
+  }
+  // Check correct message type.
+  assert(data[0] == MessageType::EvaluatorToGarbler_OutputQuery_Message);
+
+  // Get number of outputs, bounded by what the message can hold so a huge
+  // count cannot overflow the length check.
+  size_t num_outputs;
+  std::memcpy(&num_outputs, &data[1], sizeof(size_t));
+  if (num_outputs > (data.size() - header) / sizeof(int32_t)) {
+    throw std::runtime_error("Truncated output query.");
+  }
+
+  // Get fields.
+  int n = 1 + sizeof(size_t);
+  this->outputs.resize(num_outputs);
+  for (int i = 0; i < num_outputs; i++) {
+    int32_t output;
+    std::memcpy(&output, &data[n], sizeof(int32_t));
+    this->outputs[i] = output;
+    n += sizeof(int32_t);
+  }
+  return n;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <crypto++/misc.h>
+
+#include "../include-shared/secure_arena.hpp"
+
+namespace {
+thread_local SecureArena *current_arena = nullptr;
+
+size_t page_size() {
+  static const size_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+} // namespace
+
+SecureArena::SecureArena(size_t capacity)
+    : first_size(capacity), active(0) {}
+
+SecureArena::~SecureArena() {
+  for (Chunk &chunk : this->chunks) {
+    CryptoPP::SecureWipeBuffer(chunk.base, chunk.used);
+    if (chunk.locked)
+      munlock(chunk.base, chunk.size);
+    munmap(chunk.base, chunk.size);
+  }
+}
+
+/**
+ * Map a chunk of at least min_size bytes and make it active. Locking is
+ * best effort, since RLIMIT_MEMLOCK is often small; see locked.
+ * @throws std::bad_alloc if the chunk cannot be mapped.
+ */
+void SecureArena::add_chunk(size_t min_size) {
+  size_t page = page_size();
+  size_t size = (min_size + page - 1) / page * page;
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    throw std::bad_alloc();
+#ifdef MADV_DONTDUMP
+  madvise(base, size, MADV_DONTDUMP);
+#endif
+  bool locked = mlock(base, size) == 0;
+  this->chunks.push_back({static_cast<unsigned char *>(base), size, 0, locked});
+  this->active = this->chunks.size() - 1;
+}
+
+void *SecureArena::allocate(size_t n, size_t align) {
+  if (align == 0 || (align & (align - 1)) != 0 || align > page_size())
+    throw std::bad_alloc();
+  if (this->chunks.empty())
+    this->add_chunk(std::max(this->first_size, n));
+  while (true) {
+    Chunk &chunk = this->chunks[this->active];
+    size_t offset = (chunk.used + align - 1) & ~(align - 1);
+    if (offset <= chunk.size && n <= chunk.size - offset) {
+      chunk.used = offset + n;
+      return chunk.base + offset;
+    }
+    // Chunks after the active one are empty, having been rewound.
+    if (this->active + 1 < this->chunks.size()) {
+      this->active++;
+    } else {
+      this->add_chunk(std::max(2 * chunk.size, n));
+    }
+  }
+}
+
+size_t SecureArena::used() const {
+  size_t total = 0;
+  for (const Chunk &chunk : this->chunks)
+    total += chunk.used;
+  return total;
+}
+
+size_t SecureArena::capacity() const {
+  size_t total = 0;
+  for (const Chunk &chunk : this->chunks)
+    total += chunk.size;
+  return total;
+}
+
+bool SecureArena::locked() const {
+  return !this->chunks.empty() &&
+         std::all_of(this->chunks.begin(), this->chunks.end(),
+                     [](const Chunk &chunk) { return chunk.locked; });
+}
+
+SecureArena::Mark SecureArena::mark() const {
+  if (this->chunks.empty())
+    return {0, 0};
+  return {this->active, this->chunks[this->active].used};
+}
+
+/**
+ * Chunks mapped since mark stay mapped, empty, for the next allocations.
+ */
+void SecureArena::rewind(Mark mark) {
+  if (this->chunks.empty())
+    return;
+  for (size_t i = mark.chunk; i <= this->active; i++) {
+    Chunk &chunk = this->chunks[i];
+    size_t from = i == mark.chunk ? mark.offset : 0;
+    CryptoPP::SecureWipeBuffer(chunk.base + from, chunk.used - from);
+    chunk.used = from;
+  }
+  this->active = mark.chunk;
+}
+
+SecureArena *SecureArena::current() { return current_arena; }
+
+// ================================================
+// SCOPES
+// ================================================
+
+ArenaScope::ArenaScope(SecureArena &arena)
+    : arena(arena), start(arena.mark()), previous(current_arena) {
+  current_arena = &arena;
+}
+
+ArenaScope::~ArenaScope() {
+  this->arena.rewind(this->start);
+  current_arena = this->previous;
+}
+
+void ArenaScope::rewind() { this->arena.rewind(this->start); }
+
+void wipe_and_free(void *p, size_t n) {
+  CryptoPP::SecureWipeBuffer(static_cast<unsigned char *>(p), n);
+  ::operator delete(p);
+}
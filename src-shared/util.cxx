@@ -1,3 +1,9 @@
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "../include-shared/util.hpp"
 
 /**
@@ -134,3 +140,71 @@ std::vector<int> parse_input(std::string input_file) {
   }
   return res;
 }
+
+/**
+ * Parse a file of session jobs; see util.hpp.
+ */
+std::vector<std::pair<std::string, std::vector<int>>>
+parse_session_jobs(std::string jobs_file, std::string default_circuit) {
+  std::string jobs_str;
+  CryptoPP::FileSource(jobs_file.c_str(), true,
+                       new CryptoPP::StringSink(jobs_str));
+
+  std::vector<std::pair<std::string, std::vector<int>>> res;
+  for (std::string line : string_split(jobs_str, '\n')) {
+    std::istringstream words(line);
+    std::string first, second;
+    if (!(words >> first)) {
+      continue;
+    }
+    std::string circuit = default_circuit, input = first;
+    if (words >> second) {
+      circuit = first;
+      input = second;
+    }
+    std::vector<int> bits;
+    for (char c : input) {
+      if (c != '0' && c != '1') {
+        throw std::runtime_error("Invalid job input: " + line);
+      }
+      bits.push_back(c - '0');
+    }
+    res.emplace_back(circuit, bits);
+  }
+  return res;
+}
+
+/**
+ * Map a file read-only. Empty files map to data == nullptr, size == 0.
+ * @throws error if the file cannot be opened or mapped.
+ */
+MappedFile::MappedFile(const std::string &filename) : data(nullptr), size(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open file " + filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not stat file " + filename);
+  }
+  this->size = st.st_size;
+  if (this->size > 0) {
+    void *addr = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Could not map file " + filename);
+    }
+    madvise(addr, this->size, MADV_SEQUENTIAL);
+    this->data = static_cast<const unsigned char *>(addr);
+  }
+  close(fd);
+}
+
+/**
+ * Unmap the file.
+ */
+MappedFile::~MappedFile() {
+  if (this->data != nullptr)
+    munmap(const_cast<unsigned char *>(this->data), this->size);
+}
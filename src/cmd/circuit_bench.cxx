@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/circuit_simulator.hpp"
+
+namespace {
+const char *USAGE = "Usage: ./circuit_bench <circuit file> [repeats]";
+
+/*
+ * Parse the file repeats times and print gates per second.
+ */
+Circuit time_parser(const char *name, Circuit (*parse)(std::string),
+                    std::string circuit_file, int repeats) {
+  Circuit circuit;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; i++) {
+    circuit = parse(circuit_file);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  std::cout << name << ": " << circuit.num_gate << " gates, "
+            << seconds / repeats * 1e3 << " ms/parse, "
+            << (double)circuit.num_gate * repeats / seconds << " gates/s"
+            << std::endl;
+  return circuit;
+}
+
+/*
+ * Run the plaintext simulator repeats times on random lanes and print gate
+ * evaluations per second, the floor any garbled evaluation is measured
+ * against.
+ */
+void time_simulator(const Circuit &circuit, int repeats) {
+  CircuitSimulator sim(circuit);
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<uint64_t> input(4 * num_inputs);
+  for (int i = 0; i < input.size(); i++)
+    input[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+  for (int lanes : {64, 256}) {
+    uint64_t check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+      input[0] += i; // keep runs from being folded together
+      std::vector<uint64_t> output =
+          lanes == 64 ? sim.run64(std::vector<uint64_t>(
+                            input.begin(), input.begin() + num_inputs))
+                      : sim.run256(input);
+      check ^= output.empty() ? 0 : output[0];
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::cout << "simulate x" << lanes << ": "
+              << seconds / repeats * 1e6 << " us/run, "
+              << (double)circuit.num_gate * lanes * repeats / seconds
+              << " gate evals/s (" << (check & 1) << ")" << std::endl;
+  }
+}
+
+bool same_gates(const Circuit &a, const Circuit &b) {
+  if (a.gates.size() != b.gates.size())
+    return false;
+  for (int i = 0; i < a.gates.size(); i++) {
+    const Gate &x = a.gates[i], &y = b.gates[i];
+    if (x.type != y.type || x.lhs != y.lhs || x.output != y.output ||
+        (x.type != GateType::NOT_GATE && x.rhs != y.rhs))
+      return false;
+  }
+  return true;
+}
+} // namespace
+
+/*
+ * Usage: ./circuit_bench <circuit file> [repeats]
+ *
+ * Compares the mmap parser against the stdio one on the same file, then
+ * times bit-sliced plaintext evaluation of the circuit.
+ */
+int main(int argc, char *argv[]) {
+  if (argc != 2 && argc != 3) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  int repeats = argc == 3 ? atoi(argv[2]) : 10;
+  if (repeats < 1) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+
+  try {
+    Circuit stdio = time_parser("stdio", parse_circuit_stdio, circuit_file,
+                                repeats);
+    Circuit mapped = time_parser("mmap ", parse_circuit, circuit_file, repeats);
+    if (!same_gates(stdio, mapped)) {
+      std::cout << "parsers disagree" << std::endl;
+      return 1;
+    }
+    time_simulator(mapped, repeats * 100);
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
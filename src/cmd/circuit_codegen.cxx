@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+
+namespace {
+const char *USAGE = "Usage: ./circuit_codegen <circuit file> <output file>";
+
+// Gates per generated function; keeps each function small enough for the
+// compiler to optimize in reasonable time.
+const int GATES_PER_CHUNK = 512;
+
+const char *type_name(GateType::T type) {
+  switch (type) {
+  case GateType::AND_GATE:
+    return "AND";
+  case GateType::XOR_GATE:
+    return "XOR";
+  case GateType::NOT_GATE:
+    return "NOT";
+  }
+  throw std::runtime_error("Invalid gate type.");
+}
+
+/*
+ * Emit one function per phase and chunk, then a driver calling them in
+ * order, then the registration.
+ */
+void write_specialized(const Circuit &circuit, const std::string &source,
+                       std::ostream &out) {
+  WireSlots slots = assign_wire_slots(circuit);
+  int num_chunks = (circuit.gates.size() + GATES_PER_CHUNK - 1) /
+                   GATES_PER_CHUNK;
+
+  out << "// Generated by circuit_codegen from " << source
+      << ". Do not edit.\n"
+      << "#include \"pkg/specialized_circuit.hpp\"\n\n"
+      << "namespace {\n"
+      << "constexpr GateType::T AND = GateType::AND_GATE;\n"
+      << "constexpr GateType::T XOR = GateType::XOR_GATE;\n"
+      << "constexpr GateType::T NOT = GateType::NOT_GATE;\n";
+  for (const char *phase : {"garble", "evaluate"}) {
+    bool garble = phase[0] == 'g';
+    const char *context = garble ? "GarbleContext" : "EvaluateContext";
+    for (int c = 0; c < num_chunks; c++) {
+      out << "\nvoid " << phase << "_" << c << "(" << context << " &c) {\n";
+      int end = std::min<int>(circuit.gates.size(), (c + 1) * GATES_PER_CHUNK);
+      for (int i = c * GATES_PER_CHUNK; i < end; i++) {
+        const Gate &gate = circuit.gates[i];
+        int lhs = slots.slot[gate.lhs];
+        int rhs =
+            gate.type == GateType::NOT_GATE ? lhs : slots.slot[gate.rhs];
+        out << "  " << phase << "_kernel<" << type_name(gate.type) << ">(c, ";
+        if (!garble)
+          out << i << ", ";
+        out << lhs << ", " << rhs << ", " << slots.slot[gate.output]
+            << ");\n";
+      }
+      out << "}\n";
+    }
+    out << "\nvoid " << phase << "(" << context << " &c) {\n";
+    for (int c = 0; c < num_chunks; c++)
+      out << "  " << phase << "_" << c << "(c);\n";
+    out << "}\n";
+  }
+  out << "\nconst SpecializedCircuitRegistration registration({\""
+      << circuit_fingerprint(circuit) << "\", garble, evaluate});\n"
+      << "} // namespace\n";
+}
+} // namespace
+
+/*
+ * Usage: ./circuit_codegen <circuit file> <output file>
+ *
+ * Writes a C++ source file with straight-line garble and evaluate functions
+ * for the circuit. Linking it into the garbler and evaluator makes them use
+ * it for this circuit; see YAOS_SPECIALIZE in CMakeLists.txt.
+ */
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  std::string output_file = argv[2];
+
+  try {
+    // Same circuit the garbler and evaluator run, so the fingerprints match.
+    Circuit circuit = load_scheduled_circuit(circuit_file);
+    std::ofstream out(output_file, std::ios::trunc);
+    write_specialized(circuit, circuit_file, out);
+    if (!out) {
+      throw std::runtime_error("Could not write " + output_file);
+    }
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+
+namespace {
+const char *USAGE = "Usage: ./circuit_compiler <bristol file> <output file>";
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+} // namespace
+
+/*
+ * Usage: ./circuit_compiler <bristol file> <output file>
+ *
+ * Schedules and compiles a Bristol circuit for yaos_garbler / yaos_evaluator,
+ * which accept either format.
+ */
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  std::string output_file = argv[2];
+
+  try {
+    auto start = std::chrono::steady_clock::now();
+    Circuit circuit = parse_circuit(circuit_file);
+    double parse_ms = ms_since(start);
+    circuit = schedule_circuit(circuit);
+    compile_circuit(circuit, output_file);
+
+    start = std::chrono::steady_clock::now();
+    CompiledCircuit compiled = load_compiled_circuit(output_file, false);
+    double load_ms = ms_since(start);
+    start = std::chrono::steady_clock::now();
+    load_compiled_circuit(output_file, true);
+    double verify_ms = ms_since(start);
+
+    std::cout << output_file << ": " << compiled.circuit.num_gate << " gates, "
+              << compiled.circuit.num_wire << " wires, " << compiled.num_levels
+              << " levels" << std::endl;
+    std::cout << "text parse " << parse_ms << " ms, mapped load " << load_ms
+              << " ms, verified load " << verify_ms << " ms" << std::endl;
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/circuit_builder.hpp"
+#include "../../include-shared/circuit_optimizer.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+
+namespace {
+const char *USAGE =
+    "Usage: ./circuit_generate <add|add_cla|sub|mult|lt|gt|eq|max> <bits> "
+    "<output file> [--compiled]";
+
+using Bits = CircuitBuilder::Bits;
+} // namespace
+
+/*
+ * Usage: ./circuit_generate <kind> <bits> <output file> [--compiled]
+ *
+ * Writes a circuit over two <bits>-bit operands, the garbler's and the
+ * evaluator's, as Bristol text or in the compiled format. max outputs the
+ * larger operand.
+ */
+int main(int argc, char *argv[]) {
+  if (argc < 4 || argc > 5 ||
+      (argc == 5 && std::string(argv[4]) != "--compiled")) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string kind = argv[1];
+  int bits = std::atoi(argv[2]);
+  std::string output_file = argv[3];
+  bool compiled = argc == 5;
+  if (bits < 1) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+
+  auto body = [&](CircuitBuilder &b, const Bits &x, const Bits &y) -> Bits {
+    if (kind == "add")
+      return circuits::add(b, x, y);
+    if (kind == "add_cla")
+      return circuits::add_lookahead(b, x, y);
+    if (kind == "sub")
+      return circuits::subtract(b, x, y);
+    if (kind == "mult")
+      return circuits::multiply(b, x, y);
+    if (kind == "lt")
+      return {circuits::less_than(b, x, y)};
+    if (kind == "gt")
+      return {circuits::greater_than(b, x, y)};
+    if (kind == "eq")
+      return {circuits::equal(b, x, y)};
+    if (kind == "max")
+      return circuits::mux(b, circuits::less_than(b, x, y), y, x);
+    throw std::runtime_error("Unknown circuit kind " + kind);
+  };
+
+  try {
+    Circuit circuit = build_circuit(bits, bits, body);
+    GateCounts counts = count_gates(circuit);
+    std::cout << kind << " " << bits << ": " << circuit.num_gate << " gates ("
+              << counts.and_gates << " AND, " << counts.xor_gates << " XOR, "
+              << counts.not_gates << " NOT), " << circuit.num_wire << " wires"
+              << std::endl;
+    if (compiled)
+      compile_circuit(circuit, output_file);
+    else
+      write_circuit(circuit, output_file);
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
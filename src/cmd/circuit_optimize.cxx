@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/circuit_optimizer.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+
+namespace {
+const char *USAGE = "Usage: ./circuit_optimize <circuit file> <output file> "
+                    "[--mc] [--compiled]";
+
+void print_counts(const char *name, const Circuit &circuit) {
+  GateCounts counts = count_gates(circuit);
+  std::cout << name << ": " << circuit.num_gate << " gates ("
+            << counts.and_gates << " AND, " << counts.xor_gates << " XOR, "
+            << counts.not_gates << " NOT), " << circuit.num_wire << " wires"
+            << std::endl;
+}
+} // namespace
+
+/*
+ * Usage: ./circuit_optimize <circuit file> <output file> [--mc] [--compiled]
+ *
+ * Writes the optimized circuit as Bristol text, or in the compiled format
+ * with --compiled. --mc also rewrites cones to use fewer AND gates. Garbler
+ * and evaluator must both use the output.
+ */
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  std::string output_file = argv[2];
+  bool compiled = false;
+  bool mc = false;
+  for (int i = 3; i < argc; i++) {
+    std::string flag = argv[i];
+    if (flag == "--compiled") {
+      compiled = true;
+    } else if (flag == "--mc") {
+      mc = true;
+    } else {
+      std::cout << USAGE << std::endl;
+      return 1;
+    }
+  }
+
+  try {
+    Circuit circuit = load_circuit(circuit_file);
+    Circuit optimized =
+        mc ? minimize_and_gates(circuit) : optimize_circuit(circuit);
+    print_counts("before", circuit);
+    print_counts("after ", optimized);
+    if (compiled)
+      compile_circuit(optimized, output_file);
+    else
+      write_circuit(optimized, output_file);
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
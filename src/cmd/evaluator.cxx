@@ -1,49 +1,262 @@
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <set>
 #include <string>
 
+#include "../../include-shared/bit_vector.hpp"
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+#include "../../include-shared/kernels.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/drivers/cli_driver.hpp"
+#include "../../include/drivers/shm_network_driver.hpp"
+#include "../../include/drivers/wan_network_driver.hpp"
+#include "../../include/drivers/zerocopy_network_driver.hpp"
 #include "../../include/pkg/evaluator.hpp"
+#include "../../include/pkg/multi_instance.hpp"
+#include "../../include/pkg/session.hpp"
+
+namespace {
+src::severity_logger<logging::trivial::severity_level> lg;
+
+const char *USAGE = "Usage: ./yaos_evaluator <circuit file> <input file> "
+                    "<address> <port> [--transport tcp|shm|zerocopy] "
+                    "[--latency <ms>] [--jitter <ms>] [--bandwidth <mbit>] "
+                    "[--mode single|batch|session|stored|query] "
+                    "[--tables <file>] [--outputs <list>] "
+                    "[--instances-per-pass <k>] "
+                    "[--input-format text|hex|binary] "
+                    "[--output-format text|hex] "
+                    "[--kernels auto|scalar|aesni|avx2|vaes]";
+
+/*
+ * Output indices from a list like "0-7,31": indices and inclusive ranges,
+ * comma separated.
+ */
+std::vector<int> parse_output_list(std::string list) {
+  std::vector<int> outputs;
+  for (const std::string &item : string_split(list, ',')) {
+    size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last =
+        dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+    for (int i = first; i <= last; i++) {
+      outputs.push_back(i);
+    }
+  }
+  return outputs;
+}
+} // namespace
 
 /*
  * Usage: ./yaos_evaluator <circuit file> <input file> <address> <port>
+ *                         [--transport tcp|shm|zerocopy]
+ *                         [--latency <ms>] [--jitter <ms>] [--bandwidth <mbit>]
+ *                         [--mode single|batch|session|stored|query]
+ *                         [--tables <table file>] [--outputs <list>]
+ *                         [--instances-per-pass <k>]
+ *                         [--input-format text|hex|binary]
+ *                         [--output-format text|hex]
+ *                         [--kernels auto|scalar|aesni|avx2|vaes]
+ *
+ * Input and output formats and --kernels are as for the garbler.
+ * With --mode batch, the input file holds one input per line and the circuit
+ * is run once per line, evaluating <k> instances per pass over the gates.
+ * With --mode session, it holds one job per line;
+ * see the garbler.
+ * With --mode stored, tables are loaded from <table file>, made ahead of
+ * time by yaos_garble_offline, instead of received from the garbler.
+ * With --mode query, only the outputs in <list> (e.g. "0-7,31") are computed,
+ * and only the gates they depend on are garbled and evaluated.
  */
 int main(int argc, char *argv[]) {
   // Initialize logger
   initLogger(logging::trivial::severity_level::trace);
 
   // Parse args
-  if (!(argc == 5)) {
-    std::cout << "Usage: ./yaos_evaluator <circuit file> <input file> "
-                 "<address> <port>"
-              << std::endl;
+  if (argc < 5 || (argc - 5) % 2 != 0) {
+    std::cout << USAGE << std::endl;
     return 1;
   }
   std::string circuit_file = argv[1];
   std::string input_file = argv[2];
   std::string address = argv[3];
   int port = atoi(argv[4]);
+  std::string transport = "tcp";
+  WanProfile wan;
+  std::string mode = "single";
+  std::string table_file;
+  std::vector<int> query_outputs;
+  InputFormat::T input_format = InputFormat::TEXT;
+  bool hex_output = false;
+  int instances_per_pass = DEFAULT_INSTANCES_PER_PASS;
+  for (int i = 5; i < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--transport") {
+      transport = argv[i + 1];
+    } else if (flag == "--latency") {
+      wan.latency_ms = atof(argv[i + 1]);
+    } else if (flag == "--jitter") {
+      wan.jitter_ms = atof(argv[i + 1]);
+    } else if (flag == "--bandwidth") {
+      wan.bandwidth_mbit = atof(argv[i + 1]);
+    } else if (flag == "--input-format") {
+      try {
+        input_format = parse_input_format(argv[i + 1]);
+      } catch (std::runtime_error &) {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--output-format") {
+      hex_output = std::string(argv[i + 1]) == "hex";
+      if (!hex_output && std::string(argv[i + 1]) != "text") {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--kernels") {
+      try {
+        select_kernels(argv[i + 1]);
+      } catch (std::runtime_error &e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+      }
+    } else if (flag == "--instances-per-pass") {
+      instances_per_pass = atoi(argv[i + 1]);
+      if (instances_per_pass < 1) {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--mode") {
+      mode = argv[i + 1];
+      if (mode != "single" && mode != "batch" && mode != "session" &&
+          mode != "stored" && mode != "query") {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--tables") {
+      table_file = argv[i + 1];
+    } else if (flag == "--outputs") {
+      query_outputs = parse_output_list(argv[i + 1]);
+    } else {
+      std::cout << USAGE << std::endl;
+      return 1;
+    }
+  }
+  if ((mode == "stored") != !table_file.empty()) {
+    std::cout << "--mode stored goes with --tables" << std::endl;
+    return 1;
+  }
+  if ((mode == "query") != !query_outputs.empty()) {
+    std::cout << "--mode query goes with --outputs" << std::endl;
+    return 1;
+  }
 
-  // Parse circuit.
-  Circuit circuit = parse_circuit(circuit_file);
+  CUSTOM_LOG(lg, info) << "kernels: " << describe_kernels();
 
-  // Parse input.
-  std::vector<int> input = parse_input(input_file);
+  // Parse circuit and put gates in level order; compiled circuits may
+  // already be.
+  Circuit circuit = load_scheduled_circuit(circuit_file);
+
+  // Parse input; batch inputs are read one at a time and kept packed, and
+  // run_batch works on them in place.
+  BitVector input;
+  std::vector<BitVector> batch_inputs;
+  std::vector<std::pair<std::string, std::vector<int>>> jobs;
+  if (mode == "batch") {
+    batch_inputs = read_batch_input(input_file, input_format,
+                                    circuit.evaluator_input_length);
+  } else if (mode == "session") {
+    jobs = parse_session_jobs(input_file, circuit_file);
+  } else if (input_format == InputFormat::TEXT) {
+    input = BitVector(parse_input(input_file));
+  } else {
+    // Only the first input of the file is used.
+    BatchInputReader reader(input_file, input_format,
+                            circuit.evaluator_input_length);
+    if (!reader.next(input)) {
+      std::cout << "No input in " << input_file << std::endl;
+      return 1;
+    }
+  }
 
   // Connect to network driver.
-  std::shared_ptr<NetworkDriver> network_driver =
-      std::make_shared<NetworkDriverImpl>();
+  std::shared_ptr<NetworkDriver> network_driver;
+  if (transport == "tcp") {
+    network_driver = std::make_shared<NetworkDriverImpl>();
+  } else if (transport == "shm") {
+    network_driver = std::make_shared<SharedMemoryNetworkDriver>();
+  } else if (transport == "zerocopy") {
+    network_driver = std::make_shared<ZeroCopyNetworkDriver>();
+  } else {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  // Emulate a slow link on top of the chosen transport.
+  if (wan.latency_ms > 0 || wan.jitter_ms > 0 || wan.bandwidth_mbit > 0) {
+    network_driver =
+        std::make_shared<WanEmulatedNetworkDriver>(network_driver, wan);
+  }
   network_driver->connect(address, port);
   std::shared_ptr<CryptoDriver> crypto_driver =
       std::make_shared<CryptoDriver>();
 
+  // Run each job of a session on its circuit, loading each circuit once.
+  if (mode == "session") {
+    EvaluatorSession session(network_driver, crypto_driver);
+    session.add_circuit(circuit_file, std::make_shared<const Circuit>(circuit));
+    std::set<std::string> loaded = {circuit_file};
+    for (auto &job : jobs) {
+      if (loaded.insert(job.first).second) {
+        session.add_circuit(job.first, std::make_shared<const Circuit>(
+                                           load_scheduled_circuit(job.first)));
+      }
+    }
+    std::vector<BitVector> outputs;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &[circuit_id, job_input] : jobs) {
+      outputs.push_back(BitVector::from_string(
+          session.run_job(circuit_id, BitVector(job_input))));
+    }
+    session.close();
+    print_batch(outputs, std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count(),
+                hex_output);
+    return 0;
+  }
+
   // Create garbler then run.
   EvaluatorClient evaluator =
       EvaluatorClient(circuit, network_driver, crypto_driver);
+  if (mode == "batch") {
+    auto start = std::chrono::steady_clock::now();
+    evaluator.set_instances_per_pass(instances_per_pass);
+    std::vector<BitVector> outputs = evaluator.run_batch(batch_inputs);
+    print_batch(outputs, std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count(),
+                hex_output);
+    return 0;
+  }
+  if (mode == "stored") {
+    std::cout << "output: "
+              << format_output(evaluator.run_stored(table_file, input),
+                               hex_output)
+              << std::endl;
+    return 0;
+  }
+  if (mode == "query") {
+    std::cout << "output: "
+              << format_output(evaluator.run_query(input, query_outputs),
+                               hex_output)
+              << std::endl;
+    return 0;
+  }
 //   evaluator.run(input);
-  std::cout << "output: "<< evaluator.run(input) <<std::endl;
+  std::cout << "output: " << format_output(evaluator.run(input), hex_output)
+            << std::endl;
   return 0;
 }
@@ -0,0 +1,54 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+#include "../../include-shared/logger.hpp"
+#include "../../include/drivers/crypto_driver.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+namespace {
+const char *USAGE =
+    "Usage: ./yaos_garble_offline <circuit file> <table file> <key file>";
+} // namespace
+
+/*
+ * Usage: ./yaos_garble_offline <circuit file> <table file> <key file>
+ *
+ * Garbles a circuit without an evaluator. Ship the table file to the
+ * evaluator and keep the key file; later run
+ *   yaos_garbler ... --mode stored --key <key file>
+ *   yaos_evaluator ... --mode stored --tables <table file>
+ * Each pair of files is good for one run; the garbler deletes the key file
+ * as the run starts.
+ */
+int main(int argc, char *argv[]) {
+  initLogger(logging::trivial::severity_level::trace);
+  if (argc != 4) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  std::string table_file = argv[2];
+  std::string key_file = argv[3];
+
+  try {
+    // Same gate order as yaos_garbler and yaos_evaluator use.
+    Circuit circuit = load_scheduled_circuit(circuit_file);
+    auto start = std::chrono::steady_clock::now();
+    GarblerClient garbler(circuit, nullptr, std::make_shared<CryptoDriver>());
+    garbler.garble_to_file(table_file, key_file);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::cout << table_file << ": "
+              << std::filesystem::file_size(table_file) << " bytes, garbled in "
+              << seconds << " s" << std::endl;
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,47 +1,313 @@
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <set>
 #include <string>
 
+#include "../../include-shared/bit_vector.hpp"
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/compiled_circuit.hpp"
+#include "../../include-shared/kernels.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/drivers/cli_driver.hpp"
+#include "../../include/drivers/shm_network_driver.hpp"
+#include "../../include/drivers/wan_network_driver.hpp"
+#include "../../include/drivers/zerocopy_network_driver.hpp"
+#include "../../include/pkg/garbled_pool.hpp"
 #include "../../include/pkg/garbler.hpp"
+#include "../../include/pkg/garbler_server.hpp"
+#include "../../include/pkg/multi_instance.hpp"
+#include "../../include/pkg/session.hpp"
+
+namespace {
+src::severity_logger<logging::trivial::severity_level> lg;
+
+const char *USAGE = "Usage: ./yaos_garbler <circuit file> <input file> "
+                    "<address> <port> [--transport tcp|shm|zerocopy] "
+                    "[--latency <ms>] [--jitter <ms>] [--bandwidth <mbit>] "
+                    "[--mode single|batch|session|stored|query] [--key <file>] "
+                    "[--instances-per-pass <k>] "
+                    "[--input-format text|hex|binary] "
+                    "[--output-format text|hex] "
+                    "[--kernels auto|scalar|aesni|avx2|vaes] "
+                    "[--server <threads>] [--pool <size>] "
+                    "[--refill-threads <n>] [--refill-rate <per second>]";
+} // namespace
 
 /*
  * Usage: ./yaos_garbler <circuit file> <input file> <address> <port>
+ *                       [--transport tcp|shm|zerocopy]
+ *                       [--latency <ms>] [--jitter <ms>] [--bandwidth <mbit>]
+ *                       [--mode single|batch|session|stored|query]
+ *                       [--key <key file>]
+ *                       [--instances-per-pass <k>]
+ *                       [--input-format text|hex|binary]
+ *                       [--output-format text|hex]
+ *                       [--kernels auto|scalar|aesni|avx2|vaes]
+ *                       [--server <threads>]
+ *                       [--pool <size>]
+ *                       [--refill-threads <n>] [--refill-rate <per second>]
+ *
+ * Input files hold 0s and 1s; with --input-format hex, hex digits, each
+ * giving four bits lowest first, or with binary, packed bits as written by
+ * write_binary_input. Batch outputs are printed as 0s and 1s, or as hex
+ * digits the same way with --output-format hex.
+ *
+ * With --mode batch, the input file holds one input per line and the circuit
+ * is run once per line over one connection, with one key exchange and one
+ * batch of OTs; the evaluator's file must have as many lines. Instances are
+ * garbled <k> per pass over the gates.
+ *
+ * With --mode session, the input file holds one job per line, an input
+ * optionally preceded by the circuit file to run it on (default: <circuit
+ * file>). Jobs run in order over one connection and one key exchange; the
+ * evaluator's file must list the same circuits, named the same way.
+ *
+ * With --mode stored, runs a garbling made by yaos_garble_offline, whose key
+ * file is <key file>; the evaluator loads the matching table file.
+ *
+ * With --mode query, the evaluator picks which outputs to compute and only
+ * the gates they depend on are garbled.
+ *
+ * --kernels overrides the XOR and PRG kernels picked for this CPU, e.g. to
+ * benchmark one against another; see kernels.hpp.
+ *
+ * With --server, keeps accepting evaluators and serves up to <threads> of
+ * them at once instead of exiting after one run.
+ *
+ * With --pool, garbles ahead of time: <n> background threads keep <size>
+ * garbled circuits ready, at most <per second> garblings a second (0 for no
+ * limit), and sessions take one instead of garbling.
  */
 int main(int argc, char *argv[]) {
   // Initialize logger
   initLogger(logging::trivial::severity_level::trace);
 
   // Parse args
-  if (!(argc == 5)) {
-    std::cout
-        << "Usage: ./yaos_garbler <circuit file> <input file> <address> <port>"
-        << std::endl;
+  if (argc < 5 || (argc - 5) % 2 != 0) {
+    std::cout << USAGE << std::endl;
     return 1;
   }
   std::string circuit_file = argv[1];
   std::string input_file = argv[2];
   std::string address = argv[3];
   int port = atoi(argv[4]);
+  std::string transport = "tcp";
+  WanProfile wan;
+  std::string mode = "single";
+  std::string key_file;
+  InputFormat::T input_format = InputFormat::TEXT;
+  bool hex_output = false;
+  int instances_per_pass = DEFAULT_INSTANCES_PER_PASS;
+  int server_threads = 0;
+  GarbledPoolConfig pool_config;
+  bool use_pool = false;
+  for (int i = 5; i < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--transport") {
+      transport = argv[i + 1];
+    } else if (flag == "--latency") {
+      wan.latency_ms = atof(argv[i + 1]);
+    } else if (flag == "--jitter") {
+      wan.jitter_ms = atof(argv[i + 1]);
+    } else if (flag == "--bandwidth") {
+      wan.bandwidth_mbit = atof(argv[i + 1]);
+    } else if (flag == "--input-format") {
+      try {
+        input_format = parse_input_format(argv[i + 1]);
+      } catch (std::runtime_error &) {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--output-format") {
+      hex_output = std::string(argv[i + 1]) == "hex";
+      if (!hex_output && std::string(argv[i + 1]) != "text") {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--kernels") {
+      try {
+        select_kernels(argv[i + 1]);
+      } catch (std::runtime_error &e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+      }
+    } else if (flag == "--instances-per-pass") {
+      instances_per_pass = atoi(argv[i + 1]);
+      if (instances_per_pass < 1) {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--mode") {
+      mode = argv[i + 1];
+      if (mode != "single" && mode != "batch" && mode != "session" &&
+          mode != "stored" && mode != "query") {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--key") {
+      key_file = argv[i + 1];
+    } else if (flag == "--server") {
+      server_threads = atoi(argv[i + 1]);
+      if (server_threads < 1) {
+        std::cout << USAGE << std::endl;
+        return 1;
+      }
+    } else if (flag == "--pool") {
+      use_pool = true;
+      pool_config.capacity = atoi(argv[i + 1]);
+    } else if (flag == "--refill-threads") {
+      pool_config.refill_threads = atoi(argv[i + 1]);
+    } else if (flag == "--refill-rate") {
+      pool_config.refill_per_second = atof(argv[i + 1]);
+    } else {
+      std::cout << USAGE << std::endl;
+      return 1;
+    }
+  }
+  if (mode != "single" && (server_threads > 0 || use_pool)) {
+    std::cout << "--mode " << mode
+              << " does not combine with --server or --pool" << std::endl;
+    return 1;
+  }
+  if ((mode == "stored") != !key_file.empty()) {
+    std::cout << "--mode stored goes with --key" << std::endl;
+    return 1;
+  }
+  if (use_pool && (pool_config.capacity < 1 ||
+                   pool_config.refill_threads < 1 ||
+                   pool_config.refill_per_second < 0)) {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
 
-  // Parse circuit.
-  Circuit circuit = parse_circuit(circuit_file);
+  CUSTOM_LOG(lg, info) << "kernels: " << describe_kernels();
 
-  // Parse input.
-  std::vector<int> input = parse_input(input_file);
+  // Parse circuit and put gates in level order; compiled circuits may
+  // already be.
+  Circuit circuit = load_scheduled_circuit(circuit_file);
+
+  // Parse input; batch inputs are read one at a time and kept packed, and
+  // run_batch works on them in place.
+  BitVector input;
+  std::vector<BitVector> batch_inputs;
+  std::vector<std::pair<std::string, std::vector<int>>> jobs;
+  if (mode == "batch") {
+    batch_inputs = read_batch_input(input_file, input_format,
+                                    circuit.garbler_input_length);
+  } else if (mode == "session") {
+    jobs = parse_session_jobs(input_file, circuit_file);
+  } else if (input_format == InputFormat::TEXT) {
+    input = BitVector(parse_input(input_file));
+  } else {
+    // Only the first input of the file is used.
+    BatchInputReader reader(input_file, input_format,
+                            circuit.garbler_input_length);
+    if (!reader.next(input)) {
+      std::cout << "No input in " << input_file << std::endl;
+      return 1;
+    }
+  }
+
+  // Start garbling now so it overlaps waiting for evaluators.
+  std::shared_ptr<const Circuit> shared_circuit =
+      std::make_shared<const Circuit>(std::move(circuit));
+  std::shared_ptr<GarbledCircuitPool> garbled_pool;
+  if (use_pool) {
+    garbled_pool =
+        std::make_shared<GarbledCircuitPool>(shared_circuit, pool_config);
+  }
+
+  // Serve many evaluators over TCP, sharing the parsed circuit.
+  if (server_threads > 0) {
+    std::function<std::shared_ptr<NetworkDriverImpl>()> make_driver;
+    if (transport == "tcp") {
+      make_driver = [] { return std::make_shared<NetworkDriverImpl>(); };
+    } else if (transport == "zerocopy") {
+      make_driver = [] { return std::make_shared<ZeroCopyNetworkDriver>(); };
+    } else {
+      std::cout << "--server needs --transport tcp or zerocopy" << std::endl;
+      return 1;
+    }
+    if (wan.latency_ms > 0 || wan.jitter_ms > 0 || wan.bandwidth_mbit > 0) {
+      std::cout << "--server does not emulate WAN links" << std::endl;
+      return 1;
+    }
+    GarblerServer server(shared_circuit, input, server_threads, garbled_pool);
+    server.serve(port, make_driver);
+    return 0;
+  }
 
   // Connect to network driver.
-  std::shared_ptr<NetworkDriver> network_driver =
-      std::make_shared<NetworkDriverImpl>();
+  std::shared_ptr<NetworkDriver> network_driver;
+  if (transport == "tcp") {
+    network_driver = std::make_shared<NetworkDriverImpl>();
+  } else if (transport == "shm") {
+    network_driver = std::make_shared<SharedMemoryNetworkDriver>();
+  } else if (transport == "zerocopy") {
+    network_driver = std::make_shared<ZeroCopyNetworkDriver>();
+  } else {
+    std::cout << USAGE << std::endl;
+    return 1;
+  }
+  // Emulate a slow link on top of the chosen transport.
+  if (wan.latency_ms > 0 || wan.jitter_ms > 0 || wan.bandwidth_mbit > 0) {
+    network_driver =
+        std::make_shared<WanEmulatedNetworkDriver>(network_driver, wan);
+  }
   network_driver->listen(port);
   std::shared_ptr<CryptoDriver> crypto_driver =
       std::make_shared<CryptoDriver>();
 
+  // Run each job of a session on its circuit, loading each circuit once.
+  if (mode == "session") {
+    GarblerSession session(network_driver, crypto_driver);
+    session.add_circuit(circuit_file, shared_circuit);
+    std::set<std::string> loaded = {circuit_file};
+    for (auto &job : jobs) {
+      if (loaded.insert(job.first).second) {
+        session.add_circuit(job.first, std::make_shared<const Circuit>(
+                                           load_scheduled_circuit(job.first)));
+      }
+    }
+    std::vector<BitVector> outputs;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &[circuit_id, job_input] : jobs) {
+      outputs.push_back(BitVector::from_string(
+          session.run_job(circuit_id, BitVector(job_input))));
+    }
+    session.close();
+    print_batch(outputs, std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count(),
+                hex_output);
+    return 0;
+  }
+
   // Create garbler then run.
-  GarblerClient garbler = GarblerClient(circuit, network_driver, crypto_driver);
+  GarblerClient garbler =
+      GarblerClient(shared_circuit, network_driver, crypto_driver);
+  garbler.set_pool(garbled_pool);
+  if (mode == "batch") {
+    auto start = std::chrono::steady_clock::now();
+    garbler.set_instances_per_pass(instances_per_pass);
+    std::vector<BitVector> outputs = garbler.run_batch(batch_inputs);
+    print_batch(outputs, std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count(),
+                hex_output);
+    return 0;
+  }
+  if (mode == "stored") {
+    garbler.run_stored(key_file, input);
+    return 0;
+  }
+  if (mode == "query") {
+    garbler.run_query(input);
+    return 0;
+  }
   garbler.run(input);
   return 0;
 }
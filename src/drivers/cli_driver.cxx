@@ -81,3 +81,35 @@ void CLIDriver::clear() {
   }
   putp(tigetstr("clear"));
 }
+
+/**
+ * An output as 0s and 1s, or as hex digits as BitVector::to_hex.
+ * @param output Output bits.
+ * @param hex Whether to print hex.
+ */
+std::string format_output(const BitVector &output, bool hex) {
+  return hex ? output.to_hex() : output.to_string();
+}
+
+/**
+ * As above, for an output given as 0s and 1s.
+ */
+std::string format_output(const std::string &output, bool hex) {
+  return format_output(BitVector::from_string(output), hex);
+}
+
+/**
+ * Print each output of a batch or session and the aggregate rate.
+ * @param outputs Outputs in run order.
+ * @param seconds Time taken for the whole batch.
+ * @param hex Whether to print outputs as hex.
+ */
+void print_batch(const std::vector<BitVector> &outputs, double seconds,
+                 bool hex) {
+  for (int i = 0; i < outputs.size(); i++) {
+    std::cout << "output " << i << ": " << format_output(outputs[i], hex)
+              << std::endl;
+  }
+  std::cout << outputs.size() << " instances in " << seconds << " s, "
+            << outputs.size() / seconds << " instances/s" << std::endl;
+}
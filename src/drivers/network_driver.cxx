@@ -22,6 +22,14 @@ void NetworkDriverImpl::listen(int port) {
   acceptor.accept(*this->socket);
 }
 
+/**
+ * Take the next pending connection from an acceptor owned elsewhere.
+ * @param acceptor Acceptor to accept from.
+ */
+void NetworkDriverImpl::accept(tcp::acceptor &acceptor) {
+  acceptor.accept(*this->socket);
+}
+
 /**
  * Connect to the given address and port.
  * @param address Address to connect to.
@@ -87,3 +95,18 @@ std::string NetworkDriverImpl::get_remote_info() {
   return this->socket->remote_endpoint().address().to_string() + ":" +
          std::to_string(this->socket->remote_endpoint().port());
 }
+
+/**
+ * Constructor. Binds the given port at localhost.
+ * @param port Port to listen on.
+ */
+NetworkListener::NetworkListener(int port)
+    : io_context(), acceptor(io_context, tcp::endpoint(tcp::v4(), port)) {}
+
+/**
+ * Block until a peer connects and attach it to the given driver.
+ * @param network_driver Fresh, unconnected driver.
+ */
+void NetworkListener::accept(std::shared_ptr<NetworkDriverImpl> network_driver) {
+  network_driver->accept(this->acceptor);
+}
@@ -1,11 +1,14 @@
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 
 #include "crypto++/base64.h"
 #include "crypto++/dsa.h"
 #include "crypto++/osrng.h"
 #include "crypto++/rsa.h"
+#include <crypto++/aes.h>
 #include <crypto++/cryptlib.h>
 #include <crypto++/elgamal.h>
 #include <crypto++/files.h>
@@ -16,9 +19,26 @@
 
 #include "../../include-shared/constants.hpp"
 #include "../../include-shared/messages.hpp"
+#include "../../include-shared/secure_arena.hpp"
 #include "../../include-shared/util.hpp"
 #include "../../include/drivers/ot_driver.hpp"
 
+namespace {
+/*
+ * Key for transfer index of a batch. The sender's value is shared by the
+ * whole batch, so the index is mixed in to keep keys of different transfers
+ * independent.
+ */
+CryptoPP::SecByteBlock batch_key(CryptoDriver &crypto_driver,
+                                 const CryptoPP::SecByteBlock &shared_key,
+                                 size_t index) {
+  CryptoPP::SecByteBlock keyed(shared_key.size() + sizeof(index));
+  std::memcpy(keyed.data(), shared_key.data(), shared_key.size());
+  std::memcpy(keyed.data() + shared_key.size(), &index, sizeof(index));
+  return crypto_driver.AES_generate_key(keyed);
+}
+} // namespace
+
 /*
  * Constructor
  */
@@ -50,7 +70,7 @@ void OTDriver::OT_send(std::string m0, std::string m1) {
   SenderToReceiver_OTPublicValue_Message s2r_ot_pval_msg;
   s2r_ot_pval_msg.public_value  = A;
   std::vector<unsigned char> s2r_ot_pval_params = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &s2r_ot_pval_msg);
-  this->network_driver->send(s2r_ot_pval_params);
+  this->network_driver->send(std::move(s2r_ot_pval_params));
   
   // Step 2: receive the receiver's public value
   ReceiverToSender_OTPublicValue_Message r2s_ot_pval_msg;
@@ -82,7 +102,7 @@ void OTDriver::OT_send(std::string m0, std::string m1) {
   s2r_ot_encrypteed_msg.iv1 = iv1;
 
   std::vector<unsigned char> s2r_ot_encrypteed_pamras = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &s2r_ot_encrypteed_msg);
-  this->network_driver->send(s2r_ot_encrypteed_pamras);
+  this->network_driver->send(std::move(s2r_ot_encrypteed_pamras));
 }
 
 /*
@@ -117,7 +137,7 @@ std::string OTDriver::OT_recv(int choice_bit) {
   ReceiverToSender_OTPublicValue_Message r2s_ot_pval_msg;
   r2s_ot_pval_msg.public_value = B;
   std::vector<unsigned char> r2s_ot_pval_params = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &r2s_ot_pval_msg);
-  this->network_driver->send(r2s_ot_pval_params);
+  this->network_driver->send(std::move(r2s_ot_pval_params));
 
   // Step 3: generate the appropriate key and decrypt the appropriate ciphertext
   CryptoPP::SecByteBlock kc = this->crypto_driver->AES_generate_key(this->crypto_driver->DH_generate_shared_key(dh_obj, b, A));
@@ -136,4 +156,127 @@ std::string OTDriver::OT_recv(int choice_bit) {
   }else{
     return this->crypto_driver->AES_decrypt(kc, s2r_ot_encrypteed_msg.iv1, s2r_ot_encrypteed_msg.e1);
   }
-}
\ No newline at end of file
+}
+
+/*
+ * Send one of each pair in messages, in three messages for the whole batch
+ * instead of three per transfer. The sender samples one DH value; the
+ * receiver answers with a fresh value per transfer, as in OT_recv.
+ * Disconnect and throw errors for invalid MACs or a batch size mismatch.
+ */
+void OTDriver::OT_send_batch(
+    const std::vector<std::pair<std::string, std::string>> &messages) {
+  // Step 1: sample and send over public dh value
+  auto [dh_obj, a, A] = this->crypto_driver->DH_initialize();
+  SenderToReceiver_OTPublicValue_Message s2r_ot_pval_msg;
+  s2r_ot_pval_msg.public_value = A;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &s2r_ot_pval_msg));
+
+  // Step 2: receive the receiver's public values
+  auto [r2s_ot_pval_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Receiver identity authentication failed! Aborted.");
+  }
+  ReceiverToSender_OTBatchPublicValues_Message r2s_ot_pval_msg;
+  r2s_ot_pval_msg.deserialize(r2s_ot_pval_params);
+  if (r2s_ot_pval_msg.public_values.size() != messages.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Receiver asked for a different number of transfers! Aborted.");
+  }
+
+  // Step 3: encrypt each pair under keys from B and B / A
+  CryptoPP::Integer A_inv =
+      CryptoPP::EuclideanMultiplicativeInverse(byteblock_to_integer(A), DL_P);
+  SenderToReceiver_OTBatchEncryptedValues_Message s2r_ot_encrypted_msg;
+  s2r_ot_encrypted_msg.values.resize(messages.size());
+  for (size_t i = 0; i < messages.size(); i++) {
+    const CryptoPP::SecByteBlock &B = r2s_ot_pval_msg.public_values[i];
+    CryptoPP::SecByteBlock BAinv = integer_to_byteblock(
+        a_times_b_mod_c(byteblock_to_integer(B), A_inv, DL_P));
+    CryptoPP::SecByteBlock k0 = batch_key(
+        *this->crypto_driver,
+        this->crypto_driver->DH_generate_shared_key(dh_obj, a, B), i);
+    CryptoPP::SecByteBlock k1 = batch_key(
+        *this->crypto_driver,
+        this->crypto_driver->DH_generate_shared_key(dh_obj, a, BAinv), i);
+    SenderToReceiver_OTEncryptedValues_Message &values =
+        s2r_ot_encrypted_msg.values[i];
+    std::tie(values.e0, values.iv0) =
+        this->crypto_driver->AES_encrypt(k0, messages[i].first);
+    std::tie(values.e1, values.iv1) =
+        this->crypto_driver->AES_encrypt(k1, messages[i].second);
+  }
+
+  // Step 4: send the encrypted values
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &s2r_ot_encrypted_msg));
+}
+
+/*
+ * Receive m_c for each choice bit c from OT_send_batch.
+ * Disconnect and throw errors for invalid MACs or a batch size mismatch.
+ */
+std::vector<std::string>
+OTDriver::OT_recv_batch(const BitVector &choice_bits) {
+  // Step 1: read the sender's public value
+  auto [s2r_ot_pval_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Sender identity authentication failed! Aborted.");
+  }
+  SenderToReceiver_OTPublicValue_Message s2r_ot_pval_msg;
+  s2r_ot_pval_msg.deserialize(s2r_ot_pval_params);
+  CryptoPP::SecByteBlock A = s2r_ot_pval_msg.public_value;
+  CryptoPP::Integer A_int = byteblock_to_integer(A);
+
+  // Step 2: respond with one public value per choice bit
+  ReceiverToSender_OTBatchPublicValues_Message r2s_ot_pval_msg;
+  // Keys stay in the session arena, if any, until the ciphertexts arrive.
+  const size_t key_length = CryptoPP::AES::DEFAULT_KEYLENGTH;
+  ArenaVector<unsigned char> keys(choice_bits.size() * key_length);
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    auto [dh_obj, b, gb] = this->crypto_driver->DH_initialize();
+    if (choice_bits[i] == 0) {
+      r2s_ot_pval_msg.public_values.push_back(gb);
+    } else {
+      r2s_ot_pval_msg.public_values.push_back(integer_to_byteblock(
+          a_times_b_mod_c(A_int, byteblock_to_integer(gb), DL_P)));
+    }
+    CryptoPP::SecByteBlock key = batch_key(
+        *this->crypto_driver,
+        this->crypto_driver->DH_generate_shared_key(dh_obj, b, A), i);
+    std::memcpy(&keys[i * key_length], key.data(), key_length);
+  }
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &r2s_ot_pval_msg));
+
+  // Step 3: decrypt the chosen ciphertext of each pair
+  auto [s2r_ot_encrypted_params, ifValid1] =
+      this->crypto_driver->decrypt_and_verify(this->AES_key, this->HMAC_key,
+                                              this->network_driver->read());
+  if (!ifValid1) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Sender identity authentication failed! Aborted.");
+  }
+  SenderToReceiver_OTBatchEncryptedValues_Message s2r_ot_encrypted_msg;
+  s2r_ot_encrypted_msg.deserialize(s2r_ot_encrypted_params);
+  if (s2r_ot_encrypted_msg.values.size() != choice_bits.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Sender sent a different number of transfers! Aborted.");
+  }
+  std::vector<std::string> received(choice_bits.size());
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    const SenderToReceiver_OTEncryptedValues_Message &values =
+        s2r_ot_encrypted_msg.values[i];
+    CryptoPP::SecByteBlock key(&keys[i * key_length], key_length);
+    received[i] =
+        choice_bits[i] == 0
+            ? this->crypto_driver->AES_decrypt(key, values.iv0, values.e0)
+            : this->crypto_driver->AES_decrypt(key, values.iv1, values.e1);
+  }
+  return received;
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../../include/drivers/shm_network_driver.hpp"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory rings need address-free 64-bit atomics");
+
+namespace {
+enum SegmentState : uint32_t { UNINITIALIZED = 0, LISTENING = 1, CONNECTED = 2 };
+
+// How long connect() waits for a listener to create the segment.
+const std::chrono::seconds CONNECT_TIMEOUT(10);
+
+std::string shm_name(int port) { return "/yaos_shm_" + std::to_string(port); }
+
+size_t round_up(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+size_t segment_size_for(size_t ring_capacity) {
+  return round_up(sizeof(ShmSegment), alignof(ShmRing)) +
+         2 * (sizeof(ShmRing) + round_up(ring_capacity, alignof(ShmRing)));
+}
+
+/*
+ * Spin briefly, then yield, then sleep. Keeps round trips fast without pinning
+ * a core while the other side is busy garbling or evaluating.
+ */
+void backoff(int &spins) {
+  if (spins < 128) {
+    ++spins;
+    return;
+  }
+  if (spins < 256) {
+    ++spins;
+    std::this_thread::yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+bool process_alive(pid_t pid) {
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+} // namespace
+
+/**
+ * Constructor. The segment is created on listen and attached on connect.
+ * @param ring_capacity Bytes buffered per direction (listener side only).
+ */
+SharedMemoryNetworkDriver::SharedMemoryNetworkDriver(size_t ring_capacity)
+    : ring_capacity(ring_capacity), segment_size(0), segment(nullptr),
+      tx(nullptr), rx(nullptr) {}
+
+/**
+ * Destructor. Unmaps the segment if still attached.
+ */
+SharedMemoryNetworkDriver::~SharedMemoryNetworkDriver() { this->disconnect(); }
+
+/**
+ * Create a shared memory segment named after the port and wait for a peer.
+ * @param port Port used to name the segment.
+ */
+void SharedMemoryNetworkDriver::listen(int port) {
+  this->name = shm_name(port);
+  int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    this->remove_stale_segment();
+    fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    throw std::runtime_error(errno == EEXIST
+                                 ? "Shared memory port in use."
+                                 : "Could not create shared memory segment.");
+  }
+  this->segment_size = segment_size_for(this->ring_capacity);
+  if (ftruncate(fd, this->segment_size) != 0) {
+    close(fd);
+    shm_unlink(this->name.c_str());
+    throw std::runtime_error("Could not size shared memory segment.");
+  }
+  this->map_segment(fd, true);
+  close(fd);
+  this->tx = this->ring(0);
+  this->rx = this->ring(1);
+
+  // Wait for the connector, then drop the name so nothing is left behind.
+  ShmSegment *header = static_cast<ShmSegment *>(this->segment);
+  int spins = 0;
+  while (header->state.load(std::memory_order_acquire) != CONNECTED) {
+    backoff(spins);
+  }
+  shm_unlink(this->name.c_str());
+}
+
+/**
+ * Attach to the segment created by a listener on the same host.
+ * @param address Ignored; shared memory is always local.
+ * @param port Port used to name the segment.
+ */
+void SharedMemoryNetworkDriver::connect(std::string address, int port) {
+  this->name = shm_name(port);
+  auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+  int spins = 0;
+  while (true) {
+    int fd = shm_open(this->name.c_str(), O_RDWR, 0600);
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 &&
+          static_cast<size_t>(st.st_size) >= sizeof(ShmSegment)) {
+        this->segment_size = st.st_size;
+        this->map_segment(fd, false);
+        close(fd);
+        ShmSegment *header = static_cast<ShmSegment *>(this->segment);
+        uint32_t expected = LISTENING;
+        if (header->state.compare_exchange_strong(expected, CONNECTED,
+                                                  std::memory_order_acq_rel)) {
+          // Only now is the header published; earlier reads may see zeros.
+          this->ring_capacity = header->ring_capacity;
+          if (this->ring_capacity == 0 ||
+              segment_size_for(this->ring_capacity) != this->segment_size) {
+            munmap(this->segment, this->segment_size);
+            this->segment = nullptr;
+            throw std::runtime_error("Malformed shared memory segment.");
+          }
+          break;
+        }
+        munmap(this->segment, this->segment_size);
+        this->segment = nullptr;
+      } else {
+        close(fd);
+      }
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      throw std::runtime_error("Could not connect to shared memory segment.");
+    }
+    backoff(spins);
+  }
+  this->tx = this->ring(1);
+  this->rx = this->ring(0);
+}
+
+/**
+ * Disconnect gracefully. The peer can still drain buffered data, after which
+ * its reads report EOF.
+ */
+void SharedMemoryNetworkDriver::disconnect() {
+  if (this->segment == nullptr)
+    return;
+  this->ring(0)->closed.store(1, std::memory_order_release);
+  this->ring(1)->closed.store(1, std::memory_order_release);
+  munmap(this->segment, this->segment_size);
+  this->segment = nullptr;
+  this->tx = nullptr;
+  this->rx = nullptr;
+}
+
+/**
+ * Sends a fixed amount of data by sending length first.
+ * @param data Bytes of data to send.
+ */
+void SharedMemoryNetworkDriver::send(std::vector<unsigned char> data) {
+  uint32_t length = data.size();
+  this->write_bytes(reinterpret_cast<unsigned char *>(&length), sizeof(length));
+  this->write_bytes(data.data(), data.size());
+}
+
+/**
+ * Receives a fixed amount of data by receiving length first.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof.
+ */
+std::vector<unsigned char> SharedMemoryNetworkDriver::read() {
+  uint32_t length;
+  this->read_bytes(reinterpret_cast<unsigned char *>(&length), sizeof(length));
+  std::vector<unsigned char> data(length);
+  this->read_bytes(data.data(), length);
+  return data;
+}
+
+/**
+ * Get segment info as string.
+ */
+std::string SharedMemoryNetworkDriver::get_remote_info() {
+  return "shm:" + this->name;
+}
+
+/**
+ * Map the segment; the creating side also initializes the header and rings.
+ */
+void SharedMemoryNetworkDriver::map_segment(int fd, bool create) {
+  void *addr = mmap(nullptr, this->segment_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Could not map shared memory segment.");
+  }
+  this->segment = addr;
+  ShmSegment *header = static_cast<ShmSegment *>(addr);
+  if (create) {
+    new (header) ShmSegment;
+    header->owner_pid = getpid();
+    header->ring_capacity = this->ring_capacity;
+    for (int i = 0; i < 2; i++) {
+      ShmRing *r = new (this->ring(i)) ShmRing;
+      r->head.store(0, std::memory_order_relaxed);
+      r->tail.store(0, std::memory_order_relaxed);
+      r->closed.store(0, std::memory_order_relaxed);
+      r->capacity = this->ring_capacity;
+    }
+    header->state.store(LISTENING, std::memory_order_release);
+  }
+}
+
+/**
+ * Unlink the port's segment if no live listener owns it, i.e. it was never
+ * published or its owner has exited. A live segment is left alone.
+ */
+void SharedMemoryNetworkDriver::remove_stale_segment() {
+  int fd = shm_open(this->name.c_str(), O_RDONLY, 0600);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  bool stale = true;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(ShmSegment)) {
+    void *addr =
+        mmap(nullptr, sizeof(ShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+      const ShmSegment *header = static_cast<const ShmSegment *>(addr);
+      uint32_t state = header->state.load(std::memory_order_acquire);
+      stale = (state != LISTENING && state != CONNECTED) ||
+              !process_alive(header->owner_pid);
+      munmap(addr, sizeof(ShmSegment));
+    }
+  }
+  close(fd);
+  if (stale) {
+    shm_unlink(this->name.c_str());
+  }
+}
+
+/**
+ * Ring idx inside the mapped segment.
+ */
+ShmRing *SharedMemoryNetworkDriver::ring(int idx) {
+  size_t offset = round_up(sizeof(ShmSegment), alignof(ShmRing)) +
+                  idx * (sizeof(ShmRing) +
+                         round_up(this->ring_capacity, alignof(ShmRing)));
+  return reinterpret_cast<ShmRing *>(static_cast<char *>(this->segment) +
+                                     offset);
+}
+
+/**
+ * Copy len bytes into the outgoing ring, blocking while it is full.
+ */
+void SharedMemoryNetworkDriver::write_bytes(const unsigned char *src,
+                                            size_t len) {
+  if (this->tx == nullptr) {
+    throw std::runtime_error("Not connected.");
+  }
+  unsigned char *buf = reinterpret_cast<unsigned char *>(this->tx + 1);
+  uint64_t capacity = this->tx->capacity;
+  int spins = 0;
+  while (len > 0) {
+    if (this->tx->closed.load(std::memory_order_acquire)) {
+      throw std::runtime_error("Peer disconnected.");
+    }
+    uint64_t head = this->tx->head.load(std::memory_order_relaxed);
+    uint64_t tail = this->tx->tail.load(std::memory_order_acquire);
+    uint64_t space = capacity - (head - tail);
+    if (space == 0) {
+      backoff(spins);
+      continue;
+    }
+    uint64_t offset = head % capacity;
+    size_t chunk = std::min<uint64_t>({len, space, capacity - offset});
+    std::memcpy(buf + offset, src, chunk);
+    this->tx->head.store(head + chunk, std::memory_order_release);
+    src += chunk;
+    len -= chunk;
+    spins = 0;
+  }
+}
+
+/**
+ * Copy len bytes out of the incoming ring, blocking while it is empty.
+ * @throws error when the peer disconnected and the ring is drained.
+ */
+void SharedMemoryNetworkDriver::read_bytes(unsigned char *dst, size_t len) {
+  if (this->rx == nullptr) {
+    throw std::runtime_error("Received EOF.");
+  }
+  const unsigned char *buf = reinterpret_cast<unsigned char *>(this->rx + 1);
+  uint64_t capacity = this->rx->capacity;
+  int spins = 0;
+  while (len > 0) {
+    uint64_t tail = this->rx->tail.load(std::memory_order_relaxed);
+    uint64_t head = this->rx->head.load(std::memory_order_acquire);
+    if (head == tail) {
+      // Check closed before re-reading head so a final write is never lost.
+      if (this->rx->closed.load(std::memory_order_acquire) &&
+          this->rx->head.load(std::memory_order_acquire) == tail) {
+        throw std::runtime_error("Received EOF.");
+      }
+      backoff(spins);
+      continue;
+    }
+    uint64_t offset = tail % capacity;
+    size_t chunk = std::min<uint64_t>({len, head - tail, capacity - offset});
+    std::memcpy(dst, buf + offset, chunk);
+    this->rx->tail.store(tail + chunk, std::memory_order_release);
+    dst += chunk;
+    len -= chunk;
+    spins = 0;
+  }
+}
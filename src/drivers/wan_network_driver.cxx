@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "../../include/drivers/wan_network_driver.hpp"
+
+/**
+ * Constructor. The delivery thread starts once connected.
+ * @param inner Driver that carries the traffic.
+ * @param profile Latency, jitter and bandwidth to emulate.
+ */
+WanEmulatedNetworkDriver::WanEmulatedNetworkDriver(
+    std::shared_ptr<NetworkDriver> inner, WanProfile profile)
+    : inner(inner), profile(profile), tokens(profile.burst_bytes),
+      refilled(Clock::now()), jitter_rng(std::random_device{}()),
+      last_due(Clock::now()), stopping(false) {}
+
+/**
+ * Destructor. Flushes anything still in flight.
+ */
+WanEmulatedNetworkDriver::~WanEmulatedNetworkDriver() {
+  try {
+    this->stop();
+  } catch (...) {
+  }
+}
+
+/**
+ * Listen on the given port with the wrapped driver.
+ * @param port Port to listen on.
+ */
+void WanEmulatedNetworkDriver::listen(int port) {
+  this->inner->listen(port);
+  this->refilled = Clock::now();
+  this->delivery_thread = std::thread([this] { this->deliver(); });
+}
+
+/**
+ * Connect to the given address and port with the wrapped driver.
+ * @param address Address to connect to.
+ * @param port Port to conect to.
+ */
+void WanEmulatedNetworkDriver::connect(std::string address, int port) {
+  this->inner->connect(address, port);
+  this->refilled = Clock::now();
+  this->delivery_thread = std::thread([this] { this->deliver(); });
+}
+
+/**
+ * Disconnect gracefully once every queued message has been delivered.
+ */
+void WanEmulatedNetworkDriver::disconnect() {
+  this->stop();
+  this->inner->disconnect();
+}
+
+/**
+ * Queue data for delivery after the link delay. Blocks while the emulated
+ * link is still busy with earlier data.
+ * @param data Bytes of data to send.
+ * @throws error if an earlier delivery failed.
+ */
+void WanEmulatedNetworkDriver::send(std::vector<unsigned char> data) {
+  Clock::time_point departed = this->take_tokens(data.size());
+  std::this_thread::sleep_until(departed);
+
+  double delay_ms = this->profile.latency_ms;
+  if (this->profile.jitter_ms > 0) {
+    std::uniform_real_distribution<double> jitter(-this->profile.jitter_ms,
+                                                  this->profile.jitter_ms);
+    delay_ms = std::max(0.0, delay_ms + jitter(this->jitter_rng));
+  }
+  Clock::time_point due =
+      departed + std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::duration<double, std::milli>(delay_ms));
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->error)
+    std::rethrow_exception(this->error);
+  if (!this->delivery_thread.joinable())
+    throw std::runtime_error("Not connected.");
+  // A link does not reorder; jitter only stretches the gaps.
+  this->last_due = std::max(this->last_due, due);
+  this->queue.push_back({this->last_due, std::move(data)});
+  this->cv.notify_one();
+}
+
+/**
+ * Receives a message from the wrapped driver.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof.
+ */
+std::vector<unsigned char> WanEmulatedNetworkDriver::read() {
+  return this->inner->read();
+}
+
+/**
+ * Get info of the wrapped connection as string.
+ */
+std::string WanEmulatedNetworkDriver::get_remote_info() {
+  return this->inner->get_remote_info();
+}
+
+/**
+ * Charge bytes to the token bucket and return when they leave the sender.
+ */
+WanEmulatedNetworkDriver::Clock::time_point
+WanEmulatedNetworkDriver::take_tokens(size_t bytes) {
+  Clock::time_point now = Clock::now();
+  if (this->profile.bandwidth_mbit <= 0)
+    return now;
+
+  double bytes_per_sec = this->profile.bandwidth_mbit * 1e6 / 8;
+  double elapsed = std::chrono::duration<double>(now - this->refilled).count();
+  this->tokens = std::min<double>(this->profile.burst_bytes,
+                                  this->tokens + elapsed * bytes_per_sec);
+  this->refilled = now;
+  this->tokens -= bytes;
+  if (this->tokens >= 0)
+    return now;
+  return now + std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::duration<double>(-this->tokens / bytes_per_sec));
+}
+
+/**
+ * Delivery thread: hand each message to the wrapped driver once it is due.
+ */
+void WanEmulatedNetworkDriver::deliver() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (true) {
+    this->cv.wait(lock,
+                  [this] { return this->stopping || !this->queue.empty(); });
+    if (this->queue.empty())
+      return;
+    Clock::time_point due = this->queue.front().due;
+    if (Clock::now() < due) {
+      this->cv.wait_until(lock, due);
+      continue;
+    }
+    std::vector<unsigned char> data = std::move(this->queue.front().data);
+    this->queue.pop_front();
+
+    lock.unlock();
+    try {
+      this->inner->send(std::move(data));
+    } catch (...) {
+      lock.lock();
+      this->error = std::current_exception();
+      this->queue.clear();
+      return;
+    }
+    lock.lock();
+  }
+}
+
+/**
+ * Drain the queue and join the delivery thread.
+ * @throws error if a delivery failed.
+ */
+void WanEmulatedNetworkDriver::stop() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+    this->cv.notify_one();
+  }
+  if (this->delivery_thread.joinable())
+    this->delivery_thread.join();
+  if (this->error)
+    std::rethrow_exception(std::exchange(this->error, nullptr));
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+#include "../../include/drivers/zerocopy_network_driver.hpp"
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define YAOS_HAVE_ZEROCOPY 1
+#else
+#define YAOS_HAVE_ZEROCOPY 0
+#endif
+
+namespace {
+// How long to wait for outstanding completions before giving up on them.
+const std::chrono::seconds COMPLETION_TIMEOUT(1);
+} // namespace
+
+/**
+ * Constructor.
+ * @param threshold Payloads of at least this many bytes are sent zero-copy.
+ */
+ZeroCopyNetworkDriver::ZeroCopyNetworkDriver(size_t threshold)
+    : NetworkDriverImpl(), threshold(threshold), zerocopy_enabled(false),
+      next_id(0) {}
+
+/**
+ * Destructor. Waits for the kernel to release outstanding buffers.
+ */
+ZeroCopyNetworkDriver::~ZeroCopyNetworkDriver() {
+  if (this->socket->is_open())
+    this->reap_completions(true);
+}
+
+/**
+ * Listen on the given port at localhost.
+ * @param port Port to listen on.
+ */
+void ZeroCopyNetworkDriver::listen(int port) {
+  NetworkDriverImpl::listen(port);
+  this->enable_zerocopy();
+}
+
+/**
+ * Take the next pending connection from an acceptor owned elsewhere.
+ * @param acceptor Acceptor to accept from.
+ */
+void ZeroCopyNetworkDriver::accept(boost::asio::ip::tcp::acceptor &acceptor) {
+  NetworkDriverImpl::accept(acceptor);
+  this->enable_zerocopy();
+}
+
+/**
+ * Connect to the given address and port.
+ * @param address Address to connect to.
+ * @param port Port to conect to.
+ */
+void ZeroCopyNetworkDriver::connect(std::string address, int port) {
+  NetworkDriverImpl::connect(address, port);
+  this->enable_zerocopy();
+}
+
+/**
+ * Disconnect gracefully once all zero-copy sends have completed.
+ */
+void ZeroCopyNetworkDriver::disconnect() {
+  this->reap_completions(true);
+  NetworkDriverImpl::disconnect();
+}
+
+/**
+ * Sends a fixed amount of data by sending length first. Large payloads are
+ * kept alive until the kernel is done with them.
+ * @param data Bytes of data to send.
+ */
+void ZeroCopyNetworkDriver::send(std::vector<unsigned char> data) {
+  if (!this->zerocopy_enabled || data.size() < this->threshold) {
+    NetworkDriverImpl::send(std::move(data));
+    this->reap_completions(false);
+    return;
+  }
+#if YAOS_HAVE_ZEROCOPY
+  int length = htonl(data.size());
+  boost::asio::write(*this->socket, boost::asio::buffer(&length, sizeof(int)));
+
+  // Register the buffer before the first send, so completions for its
+  // pieces are credited to it even if they arrive while it is still going
+  // out. It is not released before the loop is done with it.
+  this->pending.push_back({this->next_id, this->next_id, 0, true,
+                           std::move(data)});
+  auto current = std::prev(this->pending.end());
+  const std::vector<unsigned char> &buffer = current->buffer;
+
+  int fd = this->socket->native_handle();
+  size_t sent = 0;
+  while (sent < buffer.size()) {
+    ssize_t n =
+        ::send(fd, buffer.data() + sent, buffer.size() - sent, MSG_ZEROCOPY);
+    if (n >= 0) {
+      // Every successful call gets the next notification id.
+      current->last_id = this->next_id++;
+      current->outstanding++;
+      sent += n;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == ENOBUFS && this->has_outstanding() &&
+               this->reap_completions(true)) {
+      // Out of lockable memory, and earlier sends have released theirs.
+      continue;
+    } else if (errno == ENOBUFS) {
+      // Nothing left to wait for, or it did not come in time: copy the rest.
+      boost::asio::write(*this->socket,
+                         boost::asio::buffer(buffer.data() + sent,
+                                             buffer.size() - sent));
+      sent = buffer.size();
+    } else {
+      current->sending = false;
+      throw std::runtime_error("Zero-copy send failed.");
+    }
+  }
+  current->sending = false;
+  if (current->outstanding == 0)
+    this->pending.erase(current);
+  this->reap_completions(false);
+#endif
+}
+
+/**
+ * Whether any zero-copy send still awaits a completion notification.
+ */
+bool ZeroCopyNetworkDriver::has_outstanding() const {
+  return std::any_of(
+      this->pending.begin(), this->pending.end(),
+      [](const PendingSend &send) { return send.outstanding > 0; });
+}
+
+/**
+ * Turn on SO_ZEROCOPY for the connected socket if the kernel supports it.
+ */
+void ZeroCopyNetworkDriver::enable_zerocopy() {
+#if YAOS_HAVE_ZEROCOPY
+  int one = 1;
+  this->zerocopy_enabled =
+      setsockopt(this->socket->native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one,
+                 sizeof(one)) == 0;
+#endif
+}
+
+/**
+ * Read completion notifications from the socket error queue and release the
+ * buffers they cover. If wait is set, block until nothing is outstanding or
+ * no notification has come for COMPLETION_TIMEOUT.
+ * @return whether nothing is outstanding any more.
+ */
+bool ZeroCopyNetworkDriver::reap_completions(bool wait) {
+#if YAOS_HAVE_ZEROCOPY
+  int fd = this->socket->native_handle();
+  auto deadline = std::chrono::steady_clock::now() + COMPLETION_TIMEOUT;
+  while (this->has_outstanding()) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                 CMSG_SPACE(sizeof(struct sockaddr_in6))];
+    struct msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN && errno != EWOULDBLOCK) || !wait ||
+          std::chrono::steady_clock::now() > deadline)
+        return false;
+      struct pollfd pfd = {fd, 0, 0};
+      poll(&pfd, 1, 10);
+      continue;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+        continue;
+      auto *serr = reinterpret_cast<struct sock_extended_err *>(CMSG_DATA(cm));
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      // Notifications cover an inclusive id range and may arrive out of order.
+      uint32_t lo = serr->ee_info, hi = serr->ee_data;
+      for (auto it = this->pending.begin(); it != this->pending.end();) {
+        uint32_t from = std::max(lo, it->first_id);
+        uint32_t to = std::min(hi, it->last_id);
+        if (it->outstanding > 0 && from <= to)
+          it->outstanding -= to - from + 1;
+        it = it->outstanding == 0 && !it->sending ? this->pending.erase(it)
+                                                  : std::next(it);
+      }
+      deadline = std::chrono::steady_clock::now() + COMPLETION_TIMEOUT;
+    }
+  }
+#endif
+  return true;
+}
@@ -1,4 +1,8 @@
 #include "../../include/pkg/evaluator.hpp"
+#include "../../include/pkg/garbled_file.hpp"
+#include "../../include/pkg/multi_instance.hpp"
+#include "../../include/pkg/specialized_circuit.hpp"
+#include "../../include-shared/circuit_optimizer.hpp"
 #include "../../include-shared/constants.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
@@ -19,12 +23,24 @@ EvaluatorClient::EvaluatorClient(Circuit circuit,
                                  std::shared_ptr<NetworkDriver> network_driver,
                                  std::shared_ptr<CryptoDriver> crypto_driver) {
   this->circuit = circuit;
+  this->slots = assign_wire_slots(this->circuit);
+  this->specialized = find_specialized_circuit(this->circuit);
+  this->instances_per_pass = DEFAULT_INSTANCES_PER_PASS;
   this->network_driver = network_driver;
   this->crypto_driver = crypto_driver;
   this->cli_driver = std::make_shared<CLIDriver>();
+  this->arena = std::make_shared<SecureArena>();
   initLogger(logging::trivial::severity_level::trace);
 }
 
+/**
+ * Constructor taking a copy of an already parsed circuit.
+ */
+EvaluatorClient::EvaluatorClient(std::shared_ptr<const Circuit> circuit,
+                                 std::shared_ptr<NetworkDriver> network_driver,
+                                 std::shared_ptr<CryptoDriver> crypto_driver)
+    : EvaluatorClient(*circuit, network_driver, crypto_driver) {}
+
 /**
  * Handle key exchange with evaluator
  */
@@ -43,7 +59,7 @@ EvaluatorClient::HandleKeyExchange() {
   evaluator_public_value_s.public_value = std::get<2>(dh_values);
   std::vector<unsigned char> evaluator_public_value_data;
   evaluator_public_value_s.serialize(evaluator_public_value_data);
-  network_driver->send(evaluator_public_value_data);
+  network_driver->send(std::move(evaluator_public_value_data));
 
   // Recover g^ab
   CryptoPP::SecByteBlock DH_shared_key = crypto_driver->DH_generate_shared_key(
@@ -59,6 +75,17 @@ EvaluatorClient::HandleKeyExchange() {
   return keys;
 }
 
+/**
+ * Run on a channel whose keys were agreed by an earlier key exchange, so run
+ * goes straight to the circuit. Used by sessions running many jobs.
+ */
+void EvaluatorClient::use_session_keys(
+    std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> keys,
+    std::shared_ptr<OTDriver> ot_driver) {
+  this->session_keys = keys;
+  this->ot_driver = ot_driver;
+}
+
 /**
  * run. This function should:
  * 1) Receive the garbled circuit and the garbler's input
@@ -69,33 +96,21 @@ EvaluatorClient::HandleKeyExchange() {
  * 6) Receive final output
  * `input` is the evaluator's input for each gate
  * You may find `resize` useful before running OT
- * You may also find `string_to_byteblock` useful for converting OT output to
- * wires Disconnect and throw errors only for invalid MACs
+ * OT output converts to wires with `WireLabel::from_string`
+ * Disconnect and throw errors only for invalid MACs
  */
-std::string EvaluatorClient::run(std::vector<int> input) {
-  // Key exchange
-  auto [AES_key, HMAC_key] = this->HandleKeyExchange();
+std::string EvaluatorClient::run(const BitVector &input) {
+  ArenaScope scope(*this->arena);
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
 
   // TODO: implement me!
   // Step garbled_wires.resize(num_wire);
   // Step 1: receive garbled circuit and the garbler's input
-  GarblerToEvaluator_GarbledTables_Message g2e_garbledTables_msg;
-  auto[g2e_garbledTables_params, ifValid] = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
-  if (!ifValid){
-    this->network_driver->disconnect();
-    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
-  } 
-  g2e_garbledTables_msg.deserialize(g2e_garbledTables_params);
-  std::vector<GarbledGate> garbled_tables = g2e_garbledTables_msg.garbled_tables; 
-  
-  GarblerToEvaluator_GarblerInputs_Message g2e_garblerInput_msg;
-  auto[g2e_garblerInput_params, ifValid1] = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
-  if (!ifValid1){
-    this->network_driver->disconnect();
-    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
-  } 
-  g2e_garblerInput_msg.deserialize(g2e_garblerInput_params);
-  std::vector<GarbledWire> garbler_inputs = g2e_garblerInput_msg.garbler_inputs; 
+  std::vector<GarbledGate> garbled_tables;
+  std::vector<GarbledWire> garbler_inputs =
+      read_instance(AES_key, HMAC_key, garbled_tables);
 
   // Step 2: reconstruct the vector of garbledWires
   std::vector<GarbledWire> gwires_all;
@@ -104,51 +119,22 @@ std::string EvaluatorClient::run(std::vector<int> input) {
     gwires_all.push_back(gw_garbler);
   }
 
-  // Step 3: Retrieve evaluator's input using OT
-  for (int i: input){
-    SecByteBlock inputlabel = string_to_byteblock(this->ot_driver->OT_recv(i));
+  // Step 3: Retrieve evaluator's input in one OT batch
+  for (const std::string &label : this->ot_driver->OT_recv_batch(input)) {
     GarbledWire gw_evaluator;
-    gw_evaluator.value = inputlabel;
-    gwires_all.push_back(gw_evaluator);
+    gw_evaluator.value = WireLabel::from_string(label);
+    gwires_all.push_back(std::move(gw_evaluator));
   }
 
   // Step 4: Evaluate gates in order
-  gwires_all.resize(this->circuit.num_wire);
-  for (int i = 0; i<garbled_tables.size(); i++){
-    // if (this->circuit.gates[i].type == 1 || this->circuit.gates[i].type == 2){//this is an AND/OR gate
-    //     GarbledWire gw_output = evaluate_gate(garbled_tables[i], gwires_all[this->circuit.gates[i].lhs], gwires_all[this->circuit.gates[i].rhs]);
-    //     gwires_all[this->circuit.gates[i].output] = gw_output;
-    // }
-    if (this->circuit.gates[i].type == 1){//this is an AND gate
-        GarbledWire gw_output = evaluate_gate(garbled_tables[i], gwires_all[this->circuit.gates[i].lhs], gwires_all[this->circuit.gates[i].rhs]);
-        gwires_all[this->circuit.gates[i].output] = gw_output;
-    } else if (this->circuit.gates[i].type == 2){//XOR gate
-        SecByteBlock decrypted_entry(LABEL_LENGTH);
-        CryptoPP::xorbuf(decrypted_entry, gwires_all[this->circuit.gates[i].lhs].value, gwires_all[this->circuit.gates[i].rhs].value, LABEL_LENGTH);
-        GarbledWire gw_output;
-        gw_output.value = decrypted_entry;
-        gwires_all[this->circuit.gates[i].output] = gw_output;
-    }
-    else if (this->circuit.gates[i].type == 3){//NOT gate
-        GarbledWire dummy;
-        dummy.value = DUMMY_RHS;
-        GarbledWire gw_output = evaluate_gate(garbled_tables[i], gwires_all[this->circuit.gates[i].lhs], dummy);
-        gwires_all[this->circuit.gates[i].output] = gw_output;
-    }else{
-        throw std::runtime_error("Invalid gate type!");
-    }
-    // gwires_all.push_back(gw_output);
-  }
-  
+  std::vector<GarbledWire> gwires_output =
+      evaluate_circuit(garbled_tables, gwires_all);
+
   // Step 5: Send final labels to the garbler
   EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
-  std::vector<GarbledWire> gwires_output;
-  for (int j = 0; j<this->circuit.output_length; j++){
-    gwires_output.push_back(gwires_all[this->circuit.num_wire - this->circuit.output_length +j]);
-  }
   e2g_finalLabel_msg.final_labels = gwires_output;
   std::vector<unsigned char> e2g_finalLabel_params = this->crypto_driver->encrypt_and_tag(AES_key, HMAC_key, &e2g_finalLabel_msg);
-  this->network_driver->send(e2g_finalLabel_params);
+  this->network_driver->send(std::move(e2g_finalLabel_params));
 
   // Step 6: Receive final output
   GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
@@ -162,45 +148,414 @@ std::string EvaluatorClient::run(std::vector<int> input) {
 }
 
 /**
- * Evaluate gate.
- * You may find CryptoPP::xorbuf and CryptoDriver::hash_inputs useful.
+ * Batch counterpart of GarblerClient::run_batch: one key exchange, one OT
+ * batch for the evaluator's input labels of every instance, then instances
+ * are evaluated a pass of instances_per_pass at a time as they arrive. Final
+ * labels of all instances go back in one message.
+ * Returns the output of each instance, in order, packed.
+ */
+std::vector<BitVector>
+EvaluatorClient::run_batch(const std::vector<BitVector> &inputs) {
+  ArenaScope scope(*this->arena);
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
+  int num_instances = inputs.size();
+  int evaluator_length = this->circuit.evaluator_input_length;
+  int output_length = this->circuit.output_length;
+
+  // Step 1: retrieve evaluator's input labels of every instance in one batch
+  BitVector choice_bits;
+  choice_bits.reserve((size_t)num_instances * evaluator_length);
+  for (int i = 0; i < num_instances; i++) {
+    if (inputs[i].size() != evaluator_length) {
+      throw std::runtime_error("Batch input " + std::to_string(i) +
+                               " has the wrong length.");
+    }
+    choice_bits.append(inputs[i]);
+  }
+  std::vector<std::string> input_labels =
+      this->ot_driver->OT_recv_batch(choice_bits);
+
+  // Step 2: evaluate instances_per_pass instances per pass over the gates
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  for (int begin = 0; begin < num_instances;
+       begin += this->instances_per_pass) {
+    // Each pass's tables are wiped and their memory reused once evaluated.
+    ArenaScope pass_scope(*this->arena);
+    int end = std::min(num_instances, begin + this->instances_per_pass);
+    std::vector<std::vector<GarbledGate>> tables(end - begin);
+    std::vector<std::vector<GarbledWire>> wires(end - begin);
+    std::vector<const std::vector<GarbledGate> *> pass;
+    for (int i = begin; i < end; i++) {
+      wires[i - begin] = read_instance(AES_key, HMAC_key, tables[i - begin]);
+      for (int j = 0; j < evaluator_length; j++) {
+        GarbledWire gw_evaluator;
+        gw_evaluator.value =
+            WireLabel::from_string(input_labels[i * evaluator_length + j]);
+        wires[i - begin].push_back(std::move(gw_evaluator));
+      }
+      pass.push_back(&tables[i - begin]);
+    }
+    std::vector<std::vector<GarbledWire>> outputs;
+    try {
+      outputs = evaluate_instances(this->circuit, this->slots, pass, wires);
+    } catch (std::runtime_error &) {
+      this->network_driver->disconnect();
+      throw;
+    }
+    for (std::vector<GarbledWire> &instance : outputs) {
+      e2g_finalLabel_msg.final_labels.insert(
+          e2g_finalLabel_msg.final_labels.end(), instance.begin(),
+          instance.end());
+    }
+  }
+
+  // Step 3: send final labels of every instance to the garbler
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &e2g_finalLabel_msg));
+
+  // Step 4: receive every output, concatenated in order
+  auto [g2e_finaloutput_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.deserialize(g2e_finaloutput_params);
+  if (g2e_finaloutput_msg.final_output.size() != num_instances * output_length) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler returned the wrong number of outputs! Aborted.");
+  }
+  std::vector<BitVector> results(num_instances);
+  for (int i = 0; i < num_instances; i++) {
+    results[i] = BitVector::from_string(
+        g2e_finaloutput_msg.final_output.substr(i * output_length, output_length));
+  }
+  return results;
+}
+
+/**
+ * Reactive counterpart of GarblerClient::run_reactive; needs session keys.
+ * input holds the evaluator's unbound input bits, in order. Bound inputs use
+ * the labels in kept, and kept outputs are stored there instead of being
+ * sent back.
+ * Returns the revealed outputs, in order.
+ */
+std::string EvaluatorClient::run_reactive(const BitVector &input,
+                                          const JobWiring &wiring,
+                                          KeptLabels &kept) {
+  ArenaScope scope(*this->arena);
+  if (!this->session_keys) {
+    throw std::runtime_error("Reactive jobs need session keys.");
+  }
+  auto [AES_key, HMAC_key] = *this->session_keys;
+  int garbler_length = this->circuit.garbler_input_length;
+  int num_inputs = garbler_length + this->circuit.evaluator_input_length;
+  std::vector<const GarbledWire *> bound =
+      bind_inputs(this->circuit, wiring, kept);
+  std::vector<bool> kept_output = kept_outputs(this->circuit, wiring);
+
+  // Step 1: receive the garbled circuit and the garbler's unbound inputs
+  std::vector<GarbledGate> garbled_tables;
+  std::vector<GarbledWire> garbler_inputs =
+      read_instance(AES_key, HMAC_key, garbled_tables);
+
+  // Step 2: retrieve our unbound input labels in one OT batch
+  BitVector choice_bits;
+  for (int i = garbler_length; i < num_inputs; i++) {
+    if (bound[i] == nullptr) {
+      if (choice_bits.size() >= input.size()) {
+        throw std::runtime_error("Evaluator input is too short for the job.");
+      }
+      choice_bits.push_back(input[choice_bits.size()]);
+    }
+  }
+  if (choice_bits.size() != input.size()) {
+    throw std::runtime_error("Evaluator input is too long for the job.");
+  }
+  std::vector<std::string> input_labels;
+  if (!choice_bits.empty()) {
+    input_labels = this->ot_driver->OT_recv_batch(choice_bits);
+  }
+
+  // Step 3: put each input's label in place and evaluate
+  std::vector<GarbledWire> wires(num_inputs);
+  int next_garbler = 0, next_evaluator = 0;
+  for (int i = 0; i < num_inputs; i++) {
+    if (bound[i] != nullptr) {
+      wires[i] = *bound[i];
+    } else if (i < garbler_length) {
+      if (next_garbler >= garbler_inputs.size()) {
+        this->network_driver->disconnect();
+        throw std::runtime_error("Garbler sent too few input labels! Aborted.");
+      }
+      wires[i] = garbler_inputs[next_garbler++];
+    } else {
+      wires[i].value = WireLabel::from_string(input_labels[next_evaluator++]);
+    }
+  }
+  std::vector<GarbledWire> outputs = evaluate_circuit(garbled_tables, wires);
+
+  // Step 4: keep chosen outputs as labels
+  for (const KeptOutput &output : wiring.outputs) {
+    kept[output.name].assign(outputs.begin() + output.first_output,
+                             outputs.begin() + output.first_output +
+                                 output.length);
+  }
+
+  // Step 5: reveal the remaining outputs
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  for (int i = 0; i < kept_output.size(); i++) {
+    if (!kept_output[i]) {
+      e2g_finalLabel_msg.final_labels.push_back(outputs[i]);
+    }
+  }
+  if (e2g_finalLabel_msg.final_labels.empty()) {
+    return "";
+  }
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &e2g_finalLabel_msg));
+  auto [g2e_finaloutput_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.deserialize(g2e_finaloutput_params);
+  return g2e_finaloutput_msg.final_output;
+}
+
+/**
+ * Counterpart of GarblerClient::run_query: ask for the outputs at the given
+ * indices and evaluate only their cone.
+ * Returns those outputs, in the order asked.
+ */
+std::string EvaluatorClient::run_query(const BitVector &input,
+                                       std::vector<int> outputs) {
+  ArenaScope scope(*this->arena);
+  if (outputs.empty()) {
+    throw std::runtime_error("Query at least one output.");
+  }
+  // Fails before anything is sent if an index is out of range.
+  Circuit cone_circuit =
+      schedule_circuit(output_cone(this->circuit, outputs));
+  auto keys = this->session_keys ? *this->session_keys
+                                 : this->HandleKeyExchange();
+  EvaluatorToGarbler_OutputQuery_Message e2g_query_msg;
+  e2g_query_msg.outputs = outputs;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      keys.first, keys.second, &e2g_query_msg));
+
+  EvaluatorClient cone(cone_circuit, this->network_driver,
+                       this->crypto_driver);
+  cone.use_session_keys(keys, this->ot_driver);
+  return cone.run(input);
+}
+
+/**
+ * Counterpart of GarblerClient::run_stored: evaluate from tables garbled
+ * ahead of time and shipped as table_file, which is mapped rather than read
+ * so it need not fit in memory. The garbler names its garbling first, and
+ * the file must be the one it made. Output is decoded both here, with the
+ * file's decode info, and by the garbler, which must agree.
+ */
+std::string EvaluatorClient::run_stored(std::string table_file,
+                                        const BitVector &input) {
+  ArenaScope scope(*this->arena);
+  GarbledTableFile stored = load_garbled_tables(table_file);
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
+
+  // Step 1: check the garbler means this file
+  auto [g2e_stored_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_StoredGarbling_Message g2e_stored_msg;
+  g2e_stored_msg.deserialize(g2e_stored_params);
+  if (g2e_stored_msg.garbling_id != stored.garbling_id) {
+    this->network_driver->disconnect();
+    throw std::runtime_error(table_file + " is not the garbler's garbling! Aborted.");
+  }
+
+  // Step 2: receive the garbler's input labels
+  auto [g2e_garblerInput_params, ifValid1] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid1) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_GarblerInputs_Message g2e_garblerInput_msg;
+  g2e_garblerInput_msg.deserialize(g2e_garblerInput_params);
+  std::vector<GarbledWire> wires = g2e_garblerInput_msg.garbler_inputs;
+
+  // Step 3: retrieve the evaluator's input labels in one OT batch
+  for (const std::string &label : this->ot_driver->OT_recv_batch(input)) {
+    GarbledWire gw_evaluator;
+    gw_evaluator.value = WireLabel::from_string(label);
+    wires.push_back(std::move(gw_evaluator));
+  }
+
+  // Step 4: evaluate from the mapped tables
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  try {
+    e2g_finalLabel_msg.final_labels =
+        evaluate_stored(this->circuit, this->slots, stored, wires);
+  } catch (std::runtime_error &) {
+    this->network_driver->disconnect();
+    throw;
+  }
+  std::string decoded = decode_stored(stored, e2g_finalLabel_msg.final_labels);
+
+  // Step 5: send final labels and receive the garbler's decoding
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &e2g_finalLabel_msg));
+  auto [g2e_finaloutput_params, ifValid2] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid2) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.deserialize(g2e_finaloutput_params);
+  if (g2e_finaloutput_msg.final_output != decoded) {
+    throw std::runtime_error("Garbler output does not match the decode info! Aborted.");
+  }
+  return decoded;
+}
+
+/**
+ * Number of batch instances evaluated per pass over the gates.
+ */
+void EvaluatorClient::set_instances_per_pass(int k) {
+  if (k < 1) {
+    throw std::runtime_error("Need at least one instance per pass.");
+  }
+  this->instances_per_pass = k;
+}
+
+/**
+ * Use generated code for the circuit when it was built in (the default), or
+ * always run the generic loop.
+ */
+void EvaluatorClient::set_specialized(bool enabled) {
+  this->specialized =
+      enabled ? find_specialized_circuit(this->circuit) : nullptr;
+}
+
+/**
+ * Read one garbled instance: its tables into tables, and the garbler's input
+ * labels, which are returned.
+ */
+std::vector<GarbledWire>
+EvaluatorClient::read_instance(CryptoPP::SecByteBlock AES_key,
+                               CryptoPP::SecByteBlock HMAC_key,
+                               std::vector<GarbledGate> &tables) {
+  GarblerToEvaluator_GarbledTables_Message g2e_garbledTables_msg;
+  auto[g2e_garbledTables_params, ifValid] = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid){
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  } 
+  g2e_garbledTables_msg.deserialize(g2e_garbledTables_params);
+  tables = std::move(g2e_garbledTables_msg.garbled_tables);
+
+  GarblerToEvaluator_GarblerInputs_Message g2e_garblerInput_msg;
+  auto[g2e_garblerInput_params, ifValid1] = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid1){
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  } 
+  g2e_garblerInput_msg.deserialize(g2e_garblerInput_params);
+  return g2e_garblerInput_msg.garbler_inputs;
+}
+
+/**
+ * Evaluate gates in order, starting from the input labels in wires. Wires
+ * share label slots once dead, so only the live labels are held at any time.
+ * Returns the output labels, in order.
+ */
+std::vector<GarbledWire>
+EvaluatorClient::evaluate_circuit(const std::vector<GarbledGate> &garbled_tables,
+                                  std::vector<GarbledWire> &wires) {
+  if (garbled_tables.size() != this->circuit.gates.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbled circuit does not match the circuit! Aborted.");
+  }
+  wires.resize(this->slots.num_slots);
+  EvaluateContext ctx{*this, garbled_tables, wires};
+  if (this->specialized != nullptr) {
+    this->specialized->evaluate(ctx);
+  } else {
+    for (int i = 0; i < garbled_tables.size(); i++) {
+      const Gate &gate = this->circuit.gates[i];
+      int lhs = this->slots.slot[gate.lhs];
+      int out = this->slots.slot[gate.output];
+      switch (gate.type) {
+      case GateType::AND_GATE:
+        evaluate_kernel<GateType::AND_GATE>(ctx, i, lhs,
+                                            this->slots.slot[gate.rhs], out);
+        break;
+      case GateType::XOR_GATE:
+        evaluate_kernel<GateType::XOR_GATE>(ctx, i, lhs,
+                                            this->slots.slot[gate.rhs], out);
+        break;
+      case GateType::NOT_GATE:
+        evaluate_kernel<GateType::NOT_GATE>(ctx, i, lhs, lhs, out);
+        break;
+      default:
+        throw std::runtime_error("Invalid gate type!");
+      }
+    }
+  }
+
+  std::vector<GarbledWire> outputs;
+  int first_output = this->circuit.num_wire - this->circuit.output_length;
+  for (int j = 0; j < this->circuit.output_length; j++) {
+    outputs.push_back(wires[this->slots.slot[first_output + j]]);
+  }
+  return outputs;
+}
+
+/**
+ * Evaluate gate. Every entry is encrypted under garbling_hash(lhs, rhs) for
+ * its pair of labels, so the pad is computed once and tried against each.
  * To determine if a decryption is valid, use verify_decryption.
  * To retrieve the label from a decryption, use snip_decryption.
+ * @throws error, after disconnecting, if no entry decrypts.
  */
-GarbledWire EvaluatorClient::evaluate_gate(GarbledGate gate, GarbledWire lhs,
-                                           GarbledWire rhs) {
-  // TODO: implement me!
+GarbledWire EvaluatorClient::evaluate_gate(const GarbledGate &gate,
+                                           const GarbledWire &lhs,
+                                           const GarbledWire &rhs) {
   GarbledWire gw;
-  for (CryptoPP::SecByteBlock encryption: gate.entries){
-    //for each encryption:
-    CryptoPP::SecByteBlock decrypt_key = this->crypto_driver->hash_inputs(lhs.value, rhs.value);
-    CryptoPP::SecByteBlock decryption(2*LABEL_TAG_LENGTH); 
-    CryptoPP::xorbuf(decryption, encryption, decrypt_key, 2*LABEL_TAG_LENGTH);
-
-    //verify and extract
-    if(verify_decryption(decryption)){//true
-        gw.value = snip_decryption(decryption);
-        return gw;
+  GateEntry pad = GateEntry::pad(lhs.value, rhs.value);
+  for (const GateEntry &encryption : gate.entries) {
+    GateEntry decryption = encryption ^ pad;
+    if (verify_decryption(decryption)) {
+      gw.value = snip_decryption(decryption);
+      return gw;
     }
   }
-//   throw std::runtime_error("No valid decryption.");
-  return gw;
+  this->network_driver->disconnect();
+  throw std::runtime_error("No valid decryption! Aborted.");
 }
 
 /**
- * Verify decryption. A valid dec should end with LABEL_TAG_LENGTH bits of 0s.
+ * Verify decryption. A valid dec should end with LABEL_TAG_LENGTH bytes of 0s.
  */
-bool EvaluatorClient::verify_decryption(CryptoPP::SecByteBlock decryption) {
-  CryptoPP::SecByteBlock trail(decryption.data() + LABEL_LENGTH,
-                               LABEL_TAG_LENGTH);
-  return byteblock_to_integer(trail) == CryptoPP::Integer::Zero();
+bool EvaluatorClient::verify_decryption(const GateEntry &decryption) {
+  return decryption.tag_is_zero();
 }
 
 /**
- * Returns the first LABEL_LENGTH bits of a decryption.
+ * Returns the first LABEL_LENGTH bytes of a decryption.
  */
-CryptoPP::SecByteBlock
-EvaluatorClient::snip_decryption(CryptoPP::SecByteBlock decryption) {
-  CryptoPP::SecByteBlock head(decryption.data(), LABEL_LENGTH);
-  return head;
+WireLabel EvaluatorClient::snip_decryption(const GateEntry &decryption) {
+  return decryption.label();
 }
@@ -0,0 +1,438 @@
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <crypto++/osrng.h>
+
+#include "../../include-shared/constants.hpp"
+#include "../../include-shared/kernels.hpp"
+#include "../../include/pkg/garbled_file.hpp"
+
+static_assert(std::endian::native == std::endian::little,
+              "garbled table files are stored little endian");
+
+namespace {
+const char TABLE_MAGIC[8] = {'Y', 'A', 'O', 'S', 'G', 'T', 'A', 'B'};
+const char KEY_MAGIC[8] = {'Y', 'A', 'O', 'S', 'G', 'K', 'E', 'Y'};
+// 2 records the label width, 3 the AES hash, 4 checksums the header
+const uint32_t VERSION = 4;
+const uint64_t SECTION_ALIGN = 64;
+const int ENTRY_LENGTH = GateEntry::LENGTH;
+const int TABLE_LENGTH = 4 * ENTRY_LENGTH;
+
+uint64_t align_up(uint64_t n) {
+  return (n + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+int count_and_gates(const Circuit &circuit) {
+  int n = 0;
+  for (const Gate &gate : circuit.gates)
+    n += gate.type == GateType::AND_GATE;
+  return n;
+}
+
+// First LABEL_LENGTH bytes of SHA-256(seed || tag || index).
+WireLabel derive_label(const CryptoPP::SecByteBlock &seed,
+                       const std::string &tag, uint64_t index) {
+  CryptoPP::SHA256 hash;
+  WireLabel label;
+  hash.Update(seed, seed.size());
+  hash.Update(reinterpret_cast<const CryptoPP::byte *>(tag.data()),
+              tag.size());
+  hash.Update(reinterpret_cast<const CryptoPP::byte *>(&index),
+              sizeof(index));
+  hash.TruncatedFinal(label.data(), label.size());
+  return label;
+}
+
+void put_hex(const std::string &hex, unsigned char *out, size_t size) {
+  std::string raw = hex_decode(hex);
+  if (raw.size() != size)
+    throw std::runtime_error("Bad hex digest " + hex);
+  std::memcpy(out, raw.data(), size);
+}
+
+std::string get_hex(const unsigned char *in, size_t size) {
+  return hex_encode(std::string(reinterpret_cast<const char *>(in), size));
+}
+} // namespace
+
+/*
+ * Fresh key for one garbling of circuit; output labels are filled in once it
+ * has been garbled.
+ */
+GarblingKey new_garbling_key(const Circuit &circuit) {
+  GarblingKey key;
+  key.fingerprint = circuit_fingerprint(circuit);
+  key.seed = CryptoPP::SecByteBlock(GARBLING_SEED_LENGTH);
+  CryptoPP::OS_GenerateRandomBlock(false, key.seed, key.seed.size());
+  return key;
+}
+
+/*
+ * Write key as "YAOSGKEY", version, label length, output count, fingerprint,
+ * seed and the output zero labels. Only the owner may read the file.
+ */
+void write_garbling_key(const GarblingKey &key, std::string filename) {
+  unsigned char fingerprint[32];
+  put_hex(key.fingerprint, fingerprint, sizeof(fingerprint));
+  int32_t output_length = key.output_zeros.size();
+  uint32_t label_length = LABEL_LENGTH;
+  // Serialize into a wiped buffer so the seed never sits in a stream buffer.
+  CryptoPP::SecByteBlock buffer(sizeof(KEY_MAGIC) + sizeof(VERSION) +
+                                sizeof(label_length) + sizeof(output_length) +
+                                sizeof(fingerprint) + key.seed.size() +
+                                output_length * LABEL_LENGTH);
+  unsigned char *p = buffer.data();
+  auto put = [&p](const void *src, size_t len) {
+    std::memcpy(p, src, len);
+    p += len;
+  };
+  put(KEY_MAGIC, sizeof(KEY_MAGIC));
+  put(&VERSION, sizeof(VERSION));
+  put(&label_length, sizeof(label_length));
+  put(&output_length, sizeof(output_length));
+  put(fingerprint, sizeof(fingerprint));
+  put(key.seed.data(), key.seed.size());
+  for (const GarbledWire &label : key.output_zeros) {
+    put(label.value.data(), LABEL_LENGTH);
+  }
+
+  // Create owner-only from the start; fchmod covers a pre-existing file.
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW,
+                S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    throw std::runtime_error("Could not write garbling key " + filename);
+  }
+  bool ok = fchmod(fd, S_IRUSR | S_IWUSR) == 0;
+  const unsigned char *src = buffer.data();
+  size_t left = buffer.size();
+  while (ok && left > 0) {
+    ssize_t n = ::write(fd, src, left);
+    if (n < 0 && errno == EINTR)
+      continue;
+    ok = n > 0;
+    if (ok) {
+      src += n;
+      left -= n;
+    }
+  }
+  ok = close(fd) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("Could not write garbling key " + filename);
+  }
+}
+
+/*
+ * Read a key written by write_garbling_key.
+ * @throws error if the file is not a garbling key.
+ */
+GarblingKey load_garbling_key(std::string filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error(filename +
+                             ": no garbling key; a run uses its key up");
+  }
+  char magic[sizeof(KEY_MAGIC)] = {};
+  uint32_t version = 0, label_length = 0;
+  int32_t output_length = -1;
+  unsigned char fingerprint[32];
+  GarblingKey key;
+  key.seed = CryptoPP::SecByteBlock(GARBLING_SEED_LENGTH);
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(&version), sizeof(version));
+  in.read(reinterpret_cast<char *>(&label_length), sizeof(label_length));
+  in.read(reinterpret_cast<char *>(&output_length), sizeof(output_length));
+  in.read(reinterpret_cast<char *>(fingerprint), sizeof(fingerprint));
+  in.read(reinterpret_cast<char *>(key.seed.data()), key.seed.size());
+  if (!in || std::memcmp(magic, KEY_MAGIC, sizeof(KEY_MAGIC)) != 0 ||
+      version != VERSION || output_length < 0) {
+    throw std::runtime_error(filename + ": not a garbling key");
+  }
+  if (label_length != LABEL_LENGTH) {
+    throw std::runtime_error(filename + ": key is for " +
+                             std::to_string(8 * label_length) +
+                             "-bit labels");
+  }
+  key.fingerprint = get_hex(fingerprint, sizeof(fingerprint));
+  for (int i = 0; i < output_length; i++) {
+    GarbledWire label;
+    in.read(reinterpret_cast<char *>(label.value.data()), LABEL_LENGTH);
+    key.output_zeros.push_back(std::move(label));
+  }
+  if (!in) {
+    throw std::runtime_error(filename + ": truncated garbling key");
+  }
+  return key;
+}
+
+/*
+ * Delete a key file whose garbling is about to run; see garbled_file.hpp.
+ */
+void use_up_garbling_key(std::string filename) {
+  std::error_code error;
+  if (!std::filesystem::remove(filename, error)) {
+    throw std::runtime_error(filename + ": garbling key already used up" +
+                             (error ? " (" + error.message() + ")" : ""));
+  }
+}
+
+std::string garbling_id(const CryptoPP::SecByteBlock &seed) {
+  unsigned char digest[CryptoPP::SHA256::DIGESTSIZE];
+  CryptoPP::SHA256 hash;
+  hash.Update(seed, seed.size());
+  hash.Final(digest);
+  return get_hex(digest, sizeof(digest));
+}
+
+/*
+ * Derive input labels; see garbled_file.hpp.
+ */
+GarbledLabels derive_input_labels(const Circuit &circuit,
+                                  const WireSlots &slots,
+                                  const CryptoPP::SecByteBlock &seed) {
+  GarbledLabels labels;
+  labels.zeros.resize(slots.num_slots);
+  labels.ones.resize(slots.num_slots);
+  labels.delta = derive_label(seed, "delta", 0);
+  labels.delta.bytes[LABEL_LENGTH - 1] |= 0x01;
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  for (int i = 0; i < num_inputs; i++) {
+    GarbledWire gw0, gw1;
+    gw0.value = derive_label(seed, "label", i);
+    gw1.value = gw0.value ^ labels.delta;
+    labels.zeros[slots.slot[i]] = std::move(gw0);
+    labels.ones[slots.slot[i]] = std::move(gw1);
+  }
+  return labels;
+}
+
+/*
+ * Open filename and reserve room for the header; tables start at the first
+ * aligned offset after it.
+ */
+GarbledTableWriter::GarbledTableWriter(std::string filename,
+                                       const Circuit &circuit,
+                                       std::string garbling_id)
+    : filename(filename),
+      out(filename, std::ios::binary | std::ios::trunc), header() {
+  std::memcpy(this->header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+  this->header.version = VERSION;
+  this->header.header_size = sizeof(GarbledTableHeader);
+  this->header.label_length = LABEL_LENGTH;
+  this->header.num_gate = circuit.gates.size();
+  this->header.num_and = count_and_gates(circuit);
+  this->header.output_length = circuit.output_length;
+  put_hex(circuit_fingerprint(circuit), this->header.fingerprint,
+          sizeof(this->header.fingerprint));
+  put_hex(garbling_id, this->header.garbling_id,
+          sizeof(this->header.garbling_id));
+  this->header.tables_offset = align_up(sizeof(GarbledTableHeader));
+
+  std::vector<char> padding(this->header.tables_offset, 0);
+  this->out.write(padding.data(), padding.size());
+  this->hash.Update(reinterpret_cast<const CryptoPP::byte *>(padding.data()) +
+                        sizeof(GarbledTableHeader),
+                    padding.size() - sizeof(GarbledTableHeader));
+  this->offset = padding.size();
+  if (!this->out) {
+    throw std::runtime_error("Could not write garbled tables " + filename);
+  }
+}
+
+void GarbledTableWriter::write(const std::vector<GarbledGate> &tables) {
+  unsigned char buffer[TABLE_LENGTH];
+  for (const GarbledGate &table : tables) {
+    if (table.entries.empty())
+      continue;
+    for (int i = 0; i < 4; i++) {
+      std::memcpy(buffer + i * ENTRY_LENGTH, table.entries[i].data(),
+                  ENTRY_LENGTH);
+    }
+    this->out.write(reinterpret_cast<const char *>(buffer), TABLE_LENGTH);
+    this->hash.Update(buffer, TABLE_LENGTH);
+    this->offset += TABLE_LENGTH;
+  }
+}
+
+void GarbledTableWriter::finish(const std::vector<GarbledWire> &output_zeros) {
+  uint64_t tables_end = this->header.tables_offset +
+                        (uint64_t)this->header.num_and * TABLE_LENGTH;
+  if (this->offset != tables_end ||
+      output_zeros.size() != this->header.output_length) {
+    throw std::runtime_error(this->filename +
+                             ": tables do not match the circuit");
+  }
+  this->header.decode_offset = align_up(tables_end);
+  std::vector<unsigned char> tail(this->header.decode_offset - tables_end);
+  for (const GarbledWire &label : output_zeros)
+    tail.push_back(label.value.point_bit());
+  this->out.write(reinterpret_cast<const char *>(tail.data()), tail.size());
+  this->hash.Update(tail.data(), tail.size());
+  this->header.file_size = tables_end + tail.size();
+  // The header is hashed last, with its checksum still zero.
+  this->hash.Update(reinterpret_cast<const CryptoPP::byte *>(&this->header),
+                    sizeof(this->header));
+  this->hash.Final(this->header.checksum);
+
+  this->out.seekp(0);
+  this->out.write(reinterpret_cast<const char *>(&this->header),
+                  sizeof(this->header));
+  this->out.close();
+  if (!this->out) {
+    throw std::runtime_error("Could not write garbled tables " +
+                             this->filename);
+  }
+}
+
+/*
+ * Map a garbled table file. Only the header is read unless verify_checksum
+ * is set.
+ * @throws error if the file is not a valid garbled table file.
+ */
+GarbledTableFile load_garbled_tables(std::string filename,
+                                     bool verify_checksum) {
+  auto file = std::make_shared<const MappedFile>(filename);
+  auto fail = [&](std::string msg) {
+    throw std::runtime_error(filename + ": " + msg);
+  };
+  if (file->size < sizeof(GarbledTableHeader))
+    fail("too short for garbled tables");
+
+  GarbledTableHeader header;
+  std::memcpy(&header, file->data, sizeof(header));
+  if (std::memcmp(header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) != 0)
+    fail("not a garbled table file");
+  if (header.version != VERSION)
+    fail("unsupported garbled table version " +
+         std::to_string(header.version));
+  if (header.header_size != sizeof(GarbledTableHeader) ||
+      header.file_size != file->size || header.num_gate < 0 ||
+      header.num_and < 0 || header.num_and > header.num_gate ||
+      header.output_length < 0)
+    fail("corrupt header");
+  if (header.label_length != LABEL_LENGTH)
+    fail("tables are for " + std::to_string(8 * header.label_length) +
+         "-bit labels, not " + std::to_string(YAOS_LABEL_BITS));
+  // Offsets are bounded by the file first, so the ends cannot wrap.
+  if (header.tables_offset > file->size || header.decode_offset > file->size)
+    fail("corrupt section table");
+  uint64_t tables_end =
+      header.tables_offset + (uint64_t)header.num_and * TABLE_LENGTH;
+  if (header.tables_offset % SECTION_ALIGN != 0 ||
+      header.decode_offset % SECTION_ALIGN != 0 ||
+      header.tables_offset < sizeof(header) ||
+      header.decode_offset < tables_end ||
+      header.decode_offset + header.output_length != file->size)
+    fail("corrupt section table");
+
+  if (verify_checksum) {
+    unsigned char digest[sizeof(header.checksum)];
+    GarbledTableHeader unsigned_header = header;
+    std::memset(unsigned_header.checksum, 0, sizeof(unsigned_header.checksum));
+    CryptoPP::SHA256 hash;
+    hash.Update(file->data + sizeof(header), file->size - sizeof(header));
+    hash.Update(reinterpret_cast<const CryptoPP::byte *>(&unsigned_header),
+                sizeof(unsigned_header));
+    hash.Final(digest);
+    if (std::memcmp(digest, header.checksum, sizeof(digest)) != 0)
+      fail("checksum mismatch");
+  }
+
+  GarbledTableFile stored;
+  stored.fingerprint = get_hex(header.fingerprint, sizeof(header.fingerprint));
+  stored.garbling_id = get_hex(header.garbling_id, sizeof(header.garbling_id));
+  stored.num_and = header.num_and;
+  stored.tables = file->data + header.tables_offset;
+  stored.decode = std::span<const unsigned char>(
+      file->data + header.decode_offset, header.output_length);
+  stored.file = file;
+  return stored;
+}
+
+/*
+ * Evaluate from a mapped file; see garbled_file.hpp. Labels are kept in one
+ * flat buffer by slot, and each AND gate reads the next table straight from
+ * the mapping.
+ */
+std::vector<GarbledWire> evaluate_stored(const Circuit &circuit,
+                                         const WireSlots &slots,
+                                         const GarbledTableFile &stored,
+                                         const std::vector<GarbledWire> &wires) {
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  if (stored.fingerprint != circuit_fingerprint(circuit) ||
+      stored.num_and != count_and_gates(circuit) ||
+      stored.decode.size() != circuit.output_length) {
+    throw std::runtime_error("Stored tables are for another circuit! Aborted.");
+  }
+  if (wires.size() != num_inputs) {
+    throw std::runtime_error("Need a label for every input! Aborted.");
+  }
+  std::vector<unsigned char> labels(slots.num_slots * LABEL_LENGTH);
+  for (int i = 0; i < num_inputs; i++) {
+    std::memcpy(&labels[slots.slot[i] * LABEL_LENGTH], wires[i].value.data(),
+                LABEL_LENGTH);
+  }
+
+  const Kernels &ops = kernels();
+  const unsigned char *table = stored.tables;
+  for (int g = 0; g < circuit.gates.size(); g++) {
+    const Gate &gate = circuit.gates[g];
+    const unsigned char *lhs = &labels[slots.slot[gate.lhs] * LABEL_LENGTH];
+    unsigned char *out = &labels[slots.slot[gate.output] * LABEL_LENGTH];
+    if (gate.type == GateType::XOR_GATE) {
+      ops.xor_bytes(out, lhs, &labels[slots.slot[gate.rhs] * LABEL_LENGTH],
+                    LABEL_LENGTH);
+    } else if (gate.type == GateType::NOT_GATE) {
+      std::memmove(out, lhs, LABEL_LENGTH);
+    } else if (gate.type == GateType::AND_GATE) {
+      GateEntry pad = GateEntry::pad(
+          WireLabel::from_bytes(lhs),
+          WireLabel::from_bytes(&labels[slots.slot[gate.rhs] * LABEL_LENGTH]));
+      bool decrypted = false;
+      for (int e = 0; e < 4; e++) {
+        GateEntry decryption =
+            GateEntry::from_bytes(table + e * ENTRY_LENGTH) ^ pad;
+        if (decryption.tag_is_zero()) {
+          std::memcpy(out, decryption.data(), LABEL_LENGTH);
+          decrypted = true;
+          break;
+        }
+      }
+      if (!decrypted) {
+        throw std::runtime_error("No entry of gate " + std::to_string(g) +
+                                 " decrypts! Aborted.");
+      }
+      table += TABLE_LENGTH;
+    } else {
+      throw std::runtime_error("Invalid gate type!");
+    }
+  }
+
+  std::vector<GarbledWire> outputs;
+  int first_output = circuit.num_wire - circuit.output_length;
+  for (int i = 0; i < circuit.output_length; i++) {
+    outputs.push_back({WireLabel::from_bytes(
+        &labels[slots.slot[first_output + i] * LABEL_LENGTH])});
+  }
+  return outputs;
+}
+
+/*
+ * Output i is the point bit of its final label flipped by decode[i].
+ */
+std::string decode_stored(const GarbledTableFile &stored,
+                          const std::vector<GarbledWire> &final_labels) {
+  std::string output;
+  for (int i = 0; i < final_labels.size() && i < stored.decode.size(); i++) {
+    output += (final_labels[i].value.point_bit() ^ stored.decode[i]) ? "1" : "0";
+  }
+  return output;
+}
@@ -0,0 +1,146 @@
+#include <optional>
+
+#include "../../include/pkg/garbled_pool.hpp"
+#include "../../include-shared/logger.hpp"
+
+namespace {
+src::severity_logger_mt<logging::trivial::severity_level> lg;
+
+// How long a refill thread waits after a failed garbling before retrying.
+const std::chrono::milliseconds REFILL_RETRY_DELAY(100);
+}
+
+/**
+ * Constructor. Starts the refill threads, which fill the pool right away.
+ * @param circuit Circuit to garble; sessions using the pool must run it.
+ * @param config Pool size and refill limits.
+ */
+GarbledCircuitPool::GarbledCircuitPool(std::shared_ptr<const Circuit> circuit,
+                                       GarbledPoolConfig config)
+    : circuit(circuit), fingerprint(circuit_fingerprint(*circuit)),
+      config(config), in_progress(0), stopping(false),
+      next_start(std::chrono::steady_clock::now()) {
+  if (config.capacity < 1 || config.refill_threads < 1 ||
+      config.refill_per_second < 0) {
+    throw std::runtime_error("Invalid garbled circuit pool configuration.");
+  }
+  initLogger(logging::trivial::severity_level::trace);
+  try {
+    for (int i = 0; i < config.refill_threads; i++) {
+      this->threads.emplace_back([this] { this->refill_loop(); });
+    }
+  } catch (...) {
+    // No destructor runs for a constructor that throws.
+    this->stop();
+    throw;
+  }
+}
+
+/**
+ * Destructor. Stops the refill threads after their current garbling.
+ */
+GarbledCircuitPool::~GarbledCircuitPool() { this->stop(); }
+
+/**
+ * Tell the refill threads to stop and join those that were started.
+ */
+void GarbledCircuitPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  for (std::thread &thread : this->threads) {
+    thread.join();
+  }
+  this->threads.clear();
+}
+
+/**
+ * Fingerprint of the circuit this pool garbles, to match it to sessions.
+ */
+const std::string &GarbledCircuitPool::get_fingerprint() const {
+  return this->fingerprint;
+}
+
+/**
+ * Take a garbling. Never blocks on the refill threads: if the pool is empty
+ * the caller garbles one itself.
+ */
+GarbledCircuit GarbledCircuitPool::take() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->ready.empty()) {
+      GarbledCircuit garbled = std::move(this->ready.front());
+      this->ready.pop_front();
+      this->cv.notify_all();
+      return garbled;
+    }
+  }
+  CUSTOM_LOG(lg, debug) << "garbled circuit pool empty, garbling inline";
+  GarblerClient garbler(this->circuit, nullptr,
+                        std::make_shared<CryptoDriver>());
+  return garbler.garble();
+}
+
+int GarbledCircuitPool::ready_count() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->ready.size();
+}
+
+/**
+ * Garble whenever the pool has room, no faster than refill_per_second across
+ * all threads. A failed garbling is logged and retried after a pause rather
+ * than ending the thread, and with it the process; take() garbles inline
+ * meanwhile.
+ */
+void GarbledCircuitPool::refill_loop() {
+  std::optional<GarblerClient> garbler;
+  try {
+    garbler.emplace(this->circuit, nullptr, std::make_shared<CryptoDriver>());
+  } catch (const std::exception &e) {
+    CUSTOM_LOG(lg, error) << "garbled circuit pool refill thread failed: "
+                          << e.what();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (true) {
+    this->cv.wait(lock, [this] {
+      return this->stopping ||
+             this->ready.size() + this->in_progress < this->config.capacity;
+    });
+    if (this->stopping)
+      return;
+
+    // Reserve the next start time allowed by the rate cap.
+    auto start = std::max(std::chrono::steady_clock::now(), this->next_start);
+    if (this->config.refill_per_second > 0) {
+      this->next_start =
+          start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double>(
+                          1 / this->config.refill_per_second));
+    }
+    this->in_progress++;
+    if (this->cv.wait_until(lock, start, [this] { return this->stopping; })) {
+      this->in_progress--;
+      return;
+    }
+
+    lock.unlock();
+    std::optional<GarbledCircuit> garbled;
+    try {
+      garbled = garbler->garble();
+    } catch (const std::exception &e) {
+      CUSTOM_LOG(lg, error) << "garbled circuit pool refill failed: "
+                            << e.what();
+    }
+    lock.lock();
+    this->in_progress--;
+    if (garbled) {
+      this->ready.push_back(std::move(*garbled));
+    } else if (this->cv.wait_for(lock, REFILL_RETRY_DELAY,
+                                 [this] { return this->stopping; })) {
+      return;
+    }
+  }
+}
@@ -1,10 +1,16 @@
 #include <algorithm>
 #include <crypto++/misc.h>
+#include <random>
 
+#include "../../include-shared/circuit_optimizer.hpp"
 #include "../../include-shared/constants.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/pkg/garbled_file.hpp"
+#include "../../include/pkg/garbled_pool.hpp"
 #include "../../include/pkg/garbler.hpp"
+#include "../../include/pkg/multi_instance.hpp"
+#include "../../include/pkg/specialized_circuit.hpp"
 
 /*
 Syntax to use logger:
@@ -12,19 +18,36 @@ Syntax to use logger:
 See logger.hpp for more modes besides 'debug'
 */
 namespace {
-src::severity_logger<logging::trivial::severity_level> lg;
+// Shared by every session thread.
+src::severity_logger_mt<logging::trivial::severity_level> lg;
+
+// AND tables held in memory at a time while garbling to a file.
+const size_t STORED_TABLE_CHUNK = 1 << 14;
 }
 
 /**
  * Constructor. Note that the OT_driver is left uninitialized.
  */
 GarblerClient::GarblerClient(Circuit circuit,
+                             std::shared_ptr<NetworkDriver> network_driver,
+                             std::shared_ptr<CryptoDriver> crypto_driver)
+    : GarblerClient(std::make_shared<const Circuit>(std::move(circuit)),
+                    network_driver, crypto_driver) {}
+
+/**
+ * Constructor sharing an already parsed circuit.
+ */
+GarblerClient::GarblerClient(std::shared_ptr<const Circuit> circuit,
                              std::shared_ptr<NetworkDriver> network_driver,
                              std::shared_ptr<CryptoDriver> crypto_driver) {
   this->circuit = circuit;
+  this->slots = assign_wire_slots(*circuit);
+  this->specialized = find_specialized_circuit(*circuit);
+  this->instances_per_pass = DEFAULT_INSTANCES_PER_PASS;
   this->network_driver = network_driver;
   this->crypto_driver = crypto_driver;
   this->cli_driver = std::make_shared<CLIDriver>();
+  this->arena = std::make_shared<SecureArena>();
   initLogger(logging::trivial::severity_level::trace);
 }
 
@@ -41,7 +64,7 @@ GarblerClient::HandleKeyExchange() {
   garbler_public_value_s.public_value = std::get<2>(dh_values);
   std::vector<unsigned char> garbler_public_value_data;
   garbler_public_value_s.serialize(garbler_public_value_data);
-  network_driver->send(garbler_public_value_data);
+  network_driver->send(std::move(garbler_public_value_data));
 
   // Listen for g^a
   std::vector<unsigned char> evaluator_public_value_data =
@@ -63,6 +86,25 @@ GarblerClient::HandleKeyExchange() {
   return keys;
 }
 
+/**
+ * Garble every later circuit with delta instead of a fresh one, so labels
+ * kept from one job are valid inputs to the next. See run_reactive.
+ */
+void GarblerClient::use_session_delta(WireLabel delta) {
+  this->session_delta = delta;
+}
+
+/**
+ * Run on a channel whose keys were agreed by an earlier key exchange, so run
+ * goes straight to the circuit. Used by sessions running many jobs.
+ */
+void GarblerClient::use_session_keys(
+    std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> keys,
+    std::shared_ptr<OTDriver> ot_driver) {
+  this->session_keys = keys;
+  this->ot_driver = ot_driver;
+}
+
 /**
  * run. This function should:
  * 1) Generate a garbled circuit from the given circuit in this->circuit
@@ -75,32 +117,39 @@ GarblerClient::HandleKeyExchange() {
  * Final output should be a string containing only "0"s or "1"s
  * Throw errors only for invalid MACs
  */
-std::string GarblerClient::run(std::vector<int> input) {
-  // Key exchange
-  auto [AES_key, HMAC_key] = this->HandleKeyExchange();
+std::string GarblerClient::run(const BitVector &input) {
+  ArenaScope scope(*this->arena);
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
 
   // TODO: implement me!
-  // Step 1: generate a garbled circuit
-  GarbledLabels glabels = generate_labels(this->circuit);
-  std::vector<GarbledGate> garbledGates = generate_gates(this->circuit, glabels);
+  // Step 1: generate a garbled circuit, or take one garbled ahead of time
+  GarbledCircuit garbled = this->pool ? this->pool->take() : this->garble();
+  GarbledLabels &glabels = garbled.labels;
 
   // Step 2: send the garbled circuit to the evaluator
   GarblerToEvaluator_GarbledTables_Message g2e_garbledTables_msg;
-  g2e_garbledTables_msg.garbled_tables = garbledGates;
+  g2e_garbledTables_msg.garbled_tables = std::move(garbled.tables);
   std::vector<unsigned char> g2e_garbledTables_params = this->crypto_driver->encrypt_and_tag(AES_key, HMAC_key, &g2e_garbledTables_msg);
-  this->network_driver->send(g2e_garbledTables_params);
+  this->network_driver->send(std::move(g2e_garbledTables_params));
 
   // Step 3: send the garbler's input to the evaluator
   GarblerToEvaluator_GarblerInputs_Message g2e_garblerinput_msg;
   std::vector<GarbledWire> inputWires = get_garbled_wires(glabels, input, 0);
   g2e_garblerinput_msg.garbler_inputs = inputWires;
   std::vector<unsigned char> g2e_garblerinput_params = this->crypto_driver->encrypt_and_tag(AES_key, HMAC_key, &g2e_garblerinput_msg);
-  this->network_driver->send(g2e_garblerinput_params);
-
-  // Step 4: send evaluator's input labels using OT
-  for (int i = this->circuit.garbler_input_length; i < this->circuit.garbler_input_length + this->circuit.evaluator_input_length; i++){
-    this->ot_driver->OT_send(byteblock_to_string(glabels.zeros[i].value), byteblock_to_string(glabels.ones[i].value));
+  this->network_driver->send(std::move(g2e_garblerinput_params));
+
+  // Step 4: send evaluator's input labels in one OT batch
+  std::vector<std::pair<std::string, std::string>> ot_messages;
+  int num_inputs = this->circuit->garbler_input_length +
+                   this->circuit->evaluator_input_length;
+  for (int i = this->circuit->garbler_input_length; i < num_inputs; i++) {
+    ot_messages.emplace_back(glabels.zeros[i].value.to_string(),
+                             glabels.ones[i].value.to_string());
   }
+  this->ot_driver->OT_send_batch(ot_messages);
 
   // Step 5: receive final labels, and use this to get the final output
   EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
@@ -111,122 +160,507 @@ std::string GarblerClient::run(std::vector<int> input) {
   }  
   e2g_finalLabel_msg.deserialize(e2g_finalLabel_params);
   std::vector<GarbledWire> final_labels = e2g_finalLabel_msg.final_labels;
-  std::string final_output;
-  for (GarbledWire gw: final_labels){
-    for (int j = this->circuit.garbler_input_length + this->circuit.evaluator_input_length; j< this->circuit.num_wire; j++){
-        if (glabels.zeros[j].value == gw.value){
-            final_output += "0";
-        }else if(glabels.ones[j].value == gw.value){
-            final_output += "1";
-        }else{
-            std::cerr << "Warning: no matching" << std::endl;
-        }
-    }
-  }
+  std::string final_output =
+      decode_output(output_labels(glabels), final_labels, 0);
 
   // send the result to the evaluator
   GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
   g2e_finaloutput_msg.final_output = final_output;
   std::vector<unsigned char> g2e_finaloutput_params = this->crypto_driver->encrypt_and_tag(AES_key, HMAC_key, &g2e_finaloutput_msg);
-  this->network_driver->send(g2e_finaloutput_params);
+  this->network_driver->send(std::move(g2e_finaloutput_params));
   
   return final_output;
 }
 
 /**
- * Generate garbled gates for the circuit by encrypting each entry.
- * You may find `std::random_shuffle` useful
+ * Run the circuit once per input in inputs over one connection. Keys are
+ * exchanged once and all of the evaluator's input labels go through one
+ * batched OT, so this needs labels for every instance up front. Instances are
+ * then garbled a pass of instances_per_pass at a time (see multi_instance.hpp)
+ * and streamed; only their output labels are kept. The evaluator returns the
+ * final labels of every instance in one message and gets every output back
+ * in one.
+ * Returns the output of each instance, in order, packed.
  */
-std::vector<GarbledGate> GarblerClient::generate_gates(Circuit circuit,
-                                                       GarbledLabels labels) {
-  // TODO: implement me!
-  std::vector<GarbledGate> garbledGates;
+std::vector<BitVector>
+GarblerClient::run_batch(const std::vector<BitVector> &inputs) {
+  ArenaScope scope(*this->arena);
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
+  int num_instances = inputs.size();
+  int garbler_length = this->circuit->garbler_input_length;
+  int evaluator_length = this->circuit->evaluator_input_length;
+  int output_length = this->circuit->output_length;
+
+  // Step 1: input labels for every instance
+  std::vector<GarbledLabels> labels(num_instances);
+  for (int i = 0; i < num_instances; i++) {
+    if (inputs[i].size() != garbler_length) {
+      throw std::runtime_error("Batch input " + std::to_string(i) +
+                               " has the wrong length.");
+    }
+    labels[i] = generate_labels(*this->circuit, this->slots);
+  }
 
-  //loop through each gate
-  for (Gate gate: circuit.gates) {
-    GarbledWire x0 = labels.zeros[gate.lhs];
-    GarbledWire y0 = labels.zeros[gate.rhs];
-    GarbledWire z0 = labels.zeros[gate.output];
-    GarbledWire x1 = labels.ones[gate.lhs];
-    GarbledWire y1 = labels.ones[gate.rhs];
-    GarbledWire z1 = labels.ones[gate.output];
-    
-    CryptoPP::SecByteBlock c00;
-    CryptoPP::SecByteBlock c01;
-    CryptoPP::SecByteBlock c10;
-    CryptoPP::SecByteBlock c11;
-    if (gate.type == 1){//this is an AND gate
-        c00 = encrypt_label(x0, y0, z0);
-        c01 = encrypt_label(x0, y1, z0);
-        c10 = encrypt_label(x1, y0, z0);
-        c11 = encrypt_label(x1, y1, z1);
-    }else if(gate.type == 2){//this is an XOR gate
-        c00 = encrypt_label(x0, y0, z0);
-        c01 = encrypt_label(x0, y1, z1);
-        c10 = encrypt_label(x1, y0, z1);
-        c11 = encrypt_label(x1, y1, z0);    
-    }else if (gate.type == 3){//this is a NOT gate
-        GarbledWire dummy;
-        dummy.value = DUMMY_RHS;
-        c00 = encrypt_label(x0, dummy, z1);
-        c11 = encrypt_label(x1, dummy, z0);
-    }else{
-        throw std::runtime_error("Invalid gate type! Aborted.");
+  // Step 2: send evaluator's input labels of every instance in one OT batch
+  std::vector<std::pair<std::string, std::string>> ot_messages;
+  ot_messages.reserve(num_instances * evaluator_length);
+  for (int i = 0; i < num_instances; i++) {
+    for (int j = garbler_length; j < garbler_length + evaluator_length; j++) {
+      ot_messages.emplace_back(labels[i].zeros[j].value.to_string(),
+                               labels[i].ones[j].value.to_string());
+    }
+  }
+  this->ot_driver->OT_send_batch(ot_messages);
+
+  // Step 3: garble instances_per_pass instances per pass over the gates,
+  // then send each with the garbler's input labels
+  std::vector<GarbledLabels> outputs(num_instances);
+  for (int begin = 0; begin < num_instances;
+       begin += this->instances_per_pass) {
+    // Each pass's tables are wiped and their memory reused once sent.
+    ArenaScope pass_scope(*this->arena);
+    int end = std::min(num_instances, begin + this->instances_per_pass);
+    std::vector<GarbledLabels *> pass;
+    for (int i = begin; i < end; i++) {
+      pass.push_back(&labels[i]);
+    }
+    std::vector<std::vector<GarbledGate>> tables =
+        garble_instances(*this->circuit, this->slots, pass);
+
+    for (int i = begin; i < end; i++) {
+      GarblerToEvaluator_GarbledTables_Message g2e_garbledTables_msg;
+      g2e_garbledTables_msg.garbled_tables = std::move(tables[i - begin]);
+      this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+          AES_key, HMAC_key, &g2e_garbledTables_msg));
+
+      GarblerToEvaluator_GarblerInputs_Message g2e_garblerinput_msg;
+      g2e_garblerinput_msg.garbler_inputs =
+          get_garbled_wires(labels[i], inputs[i], 0);
+      this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+          AES_key, HMAC_key, &g2e_garblerinput_msg));
+
+      outputs[i] = output_labels(labels[i]);
+      labels[i] = GarbledLabels();
+    }
+  }
+
+  // Step 4: receive the final labels of every instance and decode them
+  auto [e2g_finalLabel_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator identity authentication failed! Aborted.");
+  }
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  e2g_finalLabel_msg.deserialize(e2g_finalLabel_params);
+  if (e2g_finalLabel_msg.final_labels.size() != num_instances * output_length) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator ran a different number of instances! Aborted.");
+  }
+  std::vector<BitVector> results(num_instances);
+  std::string all_outputs;
+  for (int i = 0; i < num_instances; i++) {
+    std::string output = decode_output(
+        outputs[i], e2g_finalLabel_msg.final_labels, i * output_length);
+    results[i] = BitVector::from_string(output);
+    all_outputs += output;
+  }
+
+  // Step 5: send every output to the evaluator, concatenated in order
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.final_output = all_outputs;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_finaloutput_msg));
+  return results;
+}
+
+/**
+ * Run one reactive job of a session; needs session keys and delta. Inputs
+ * bound by wiring take their zero labels from kept, so they get no garbler
+ * input label and no OT; input holds the garbler's unbound input bits, in
+ * order. Kept outputs are stored in kept by name and never decoded; only the
+ * remaining outputs are revealed, and if there are none the final round is
+ * skipped.
+ * Returns the revealed outputs, in order.
+ */
+std::string GarblerClient::run_reactive(const BitVector &input,
+                                        const JobWiring &wiring,
+                                        KeptLabels &kept) {
+  ArenaScope scope(*this->arena);
+  if (!this->session_keys || !this->session_delta) {
+    throw std::runtime_error("Reactive jobs need session keys and delta.");
+  }
+  auto [AES_key, HMAC_key] = *this->session_keys;
+  int garbler_length = this->circuit->garbler_input_length;
+  int num_inputs = garbler_length + this->circuit->evaluator_input_length;
+  std::vector<const GarbledWire *> bound =
+      bind_inputs(*this->circuit, wiring, kept);
+  std::vector<bool> kept_output = kept_outputs(*this->circuit, wiring);
+
+  // Step 1: garble with bound inputs carrying their kept labels
+  GarbledLabels glabels = generate_labels(*this->circuit, this->slots);
+  for (int i = 0; i < num_inputs; i++) {
+    if (bound[i] != nullptr) {
+      glabels.zeros[i] = *bound[i];
+      glabels.ones[i].value = bound[i]->value ^ glabels.delta;
+    }
+  }
+  GarblerToEvaluator_GarbledTables_Message g2e_garbledTables_msg;
+  g2e_garbledTables_msg.garbled_tables =
+      generate_gates(*this->circuit, this->slots, glabels);
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_garbledTables_msg));
+
+  // Step 2: send the garbler's unbound input labels
+  GarblerToEvaluator_GarblerInputs_Message g2e_garblerinput_msg;
+  int next_input = 0;
+  for (int i = 0; i < garbler_length; i++) {
+    if (bound[i] != nullptr)
+      continue;
+    if (next_input >= input.size()) {
+      throw std::runtime_error("Garbler input is too short for the job.");
+    }
+    g2e_garblerinput_msg.garbler_inputs.push_back(
+        input[next_input++] ? glabels.ones[i] : glabels.zeros[i]);
+  }
+  if (next_input != input.size()) {
+    throw std::runtime_error("Garbler input is too long for the job.");
+  }
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_garblerinput_msg));
+
+  // Step 3: send the evaluator's unbound input labels in one OT batch
+  std::vector<std::pair<std::string, std::string>> ot_messages;
+  for (int i = garbler_length; i < num_inputs; i++) {
+    if (bound[i] == nullptr) {
+      ot_messages.emplace_back(glabels.zeros[i].value.to_string(),
+                               glabels.ones[i].value.to_string());
+    }
+  }
+  if (!ot_messages.empty()) {
+    this->ot_driver->OT_send_batch(ot_messages);
+  }
+
+  // Step 4: keep chosen outputs as labels
+  GarbledLabels outputs = output_labels(glabels);
+  for (const KeptOutput &output : wiring.outputs) {
+    kept[output.name].assign(outputs.zeros.begin() + output.first_output,
+                             outputs.zeros.begin() + output.first_output +
+                                 output.length);
+  }
+
+  // Step 5: decode the revealed outputs
+  GarbledLabels revealed;
+  for (int i = 0; i < kept_output.size(); i++) {
+    if (!kept_output[i]) {
+      revealed.zeros.push_back(outputs.zeros[i]);
+      revealed.ones.push_back(outputs.ones[i]);
+    }
+  }
+  if (revealed.zeros.empty()) {
+    return "";
+  }
+  auto [e2g_finalLabel_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator identity authentication failed! Aborted.");
+  }
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  e2g_finalLabel_msg.deserialize(e2g_finalLabel_params);
+  std::string final_output =
+      decode_output(revealed, e2g_finalLabel_msg.final_labels, 0);
+
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.final_output = final_output;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_finaloutput_msg));
+  return final_output;
+}
+
+/**
+ * Run only what the evaluator asks for: it sends the indices of the outputs
+ * it wants, and just the gates of their backward cone are garbled, sent and
+ * evaluated. input is the garbler's whole input, as for run.
+ * Returns the queried outputs, in the order asked.
+ */
+std::string GarblerClient::run_query(const BitVector &input) {
+  ArenaScope scope(*this->arena);
+  // Key exchange, unless a session already did it
+  auto keys = this->session_keys ? *this->session_keys
+                                 : this->HandleKeyExchange();
+  auto [e2g_query_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      keys.first, keys.second, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator identity authentication failed! Aborted.");
+  }
+  EvaluatorToGarbler_OutputQuery_Message e2g_query_msg;
+  e2g_query_msg.deserialize(e2g_query_params);
+  if (e2g_query_msg.outputs.empty()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator queried no outputs! Aborted.");
+  }
+  for (int output : e2g_query_msg.outputs) {
+    if (output < 0 || output >= this->circuit->output_length) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("Evaluator queried output " +
+                               std::to_string(output) +
+                               " outside the circuit! Aborted.");
     }
+  }
 
-    GarbledGate ggate;
-    std::vector<CryptoPP::SecByteBlock> e;
-    e.push_back(c00);
-    e.push_back(c11);
+  // Both sides derive the same cone, so it never goes over the wire.
+  GarblerClient cone(
+      schedule_circuit(output_cone(*this->circuit, e2g_query_msg.outputs)),
+      this->network_driver, this->crypto_driver);
+  cone.use_session_keys(keys, this->ot_driver);
+  return cone.run(input);
+}
 
-    if (gate.type != 3){
-        e.push_back(c01);
-        e.push_back(c10);
+/**
+ * Garble the circuit once, ahead of time, without an evaluator. The tables
+ * and decode info go to table_file, written as they are garbled so they
+ * never all sit in memory; the seed behind the input labels and the output
+ * labels go to key_file, which run_stored needs and which must stay with
+ * the garbler.
+ */
+void GarblerClient::garble_to_file(std::string table_file,
+                                   std::string key_file) {
+  ArenaScope scope(*this->arena);
+  GarblingKey key = new_garbling_key(*this->circuit);
+  GarbledLabels glabels =
+      derive_input_labels(*this->circuit, this->slots, key.seed);
+  GarbledTableWriter writer(table_file, *this->circuit, garbling_id(key.seed));
+  std::vector<GarbledGate> chunk;
+  GarbleContext ctx{*this, glabels, chunk};
+  for (const Gate &gate : this->circuit->gates) {
+    garble_gate(ctx, this->slots, gate);
+    if (chunk.size() == STORED_TABLE_CHUNK) {
+      writer.write(chunk);
+      chunk.clear();
+      scope.rewind();
     }
-    //random shuffle
-    std::srand(unsigned(std::time(0)));
-    std::random_shuffle(e.begin(), e.end());
+  }
+  writer.write(chunk);
+  key.output_zeros = output_labels(glabels).zeros;
+  writer.finish(key.output_zeros);
+  write_garbling_key(key, key_file);
+}
+
+/**
+ * Run a garbling stored by garble_to_file: name it to the evaluator, who
+ * loads its tables from disk, then send input labels rebuilt from the seed
+ * in key_file and decode as run does. key_file is deleted before any label
+ * is sent, as each garbling may be run only once.
+ * @throws error if key_file was already used up or is for another circuit.
+ */
+std::string GarblerClient::run_stored(std::string key_file,
+                                      const BitVector &input) {
+  ArenaScope scope(*this->arena);
+  GarblingKey key = load_garbling_key(key_file);
+  if (key.fingerprint != circuit_fingerprint(*this->circuit) ||
+      key.output_zeros.size() != this->circuit->output_length) {
+    throw std::runtime_error(key_file + " was garbled for another circuit.");
+  }
+  // Key exchange, unless a session already did it
+  auto [AES_key, HMAC_key] = this->session_keys ? *this->session_keys
+                                                : this->HandleKeyExchange();
+  try {
+    use_up_garbling_key(key_file);
+  } catch (std::runtime_error &) {
+    this->network_driver->disconnect();
+    throw;
+  }
+
+  // Step 1: name the stored garbling
+  GarblerToEvaluator_StoredGarbling_Message g2e_stored_msg;
+  g2e_stored_msg.garbling_id = garbling_id(key.seed);
+  this->network_driver->send(
+      this->crypto_driver->encrypt_and_tag(AES_key, HMAC_key, &g2e_stored_msg));
 
-    ggate.entries = e;
-    garbledGates.push_back(ggate);
+  // Step 2: send the garbler's input labels
+  GarbledLabels glabels =
+      derive_input_labels(*this->circuit, this->slots, key.seed);
+  GarblerToEvaluator_GarblerInputs_Message g2e_garblerinput_msg;
+  g2e_garblerinput_msg.garbler_inputs = get_garbled_wires(glabels, input, 0);
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_garblerinput_msg));
+
+  // Step 3: send the evaluator's input labels in one OT batch
+  std::vector<std::pair<std::string, std::string>> ot_messages;
+  int num_inputs = this->circuit->garbler_input_length +
+                   this->circuit->evaluator_input_length;
+  for (int i = this->circuit->garbler_input_length; i < num_inputs; i++) {
+    ot_messages.emplace_back(glabels.zeros[i].value.to_string(),
+                             glabels.ones[i].value.to_string());
+  }
+  this->ot_driver->OT_send_batch(ot_messages);
+
+  // Step 4: decode the final labels against the kept output labels
+  auto [e2g_finalLabel_params, ifValid] = this->crypto_driver->decrypt_and_verify(
+      AES_key, HMAC_key, this->network_driver->read());
+  if (!ifValid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator identity authentication failed! Aborted.");
+  }
+  EvaluatorToGarbler_FinalLabels_Message e2g_finalLabel_msg;
+  e2g_finalLabel_msg.deserialize(e2g_finalLabel_params);
+  GarbledLabels outputs;
+  outputs.zeros = key.output_zeros;
+  for (const GarbledWire &zero : key.output_zeros) {
+    outputs.ones.push_back({zero.value ^ glabels.delta});
+  }
+  std::string final_output =
+      decode_output(outputs, e2g_finalLabel_msg.final_labels, 0);
+
+  GarblerToEvaluator_FinalOutput_Message g2e_finaloutput_msg;
+  g2e_finaloutput_msg.final_output = final_output;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      AES_key, HMAC_key, &g2e_finaloutput_msg));
+  return final_output;
+}
+
+/**
+ * Labels of the circuit's output wires, output i at index i.
+ */
+GarbledLabels GarblerClient::output_labels(const GarbledLabels &labels) {
+  GarbledLabels outputs;
+  // Output wires are the last output_length wires, in order.
+  int first_output = this->circuit->num_wire - this->circuit->output_length;
+  for (int i = 0; i < this->circuit->output_length; i++) {
+    int j = this->slots.slot[first_output + i];
+    outputs.zeros.push_back(labels.zeros[j]);
+    outputs.ones.push_back(labels.ones[j]);
+  }
+  return outputs;
+}
+
+/**
+ * Output bits for the final labels starting at begin, matching each against
+ * the output's zero and one label. A label matching neither means the
+ * evaluator misbehaved, so disconnect and throw rather than send a wrong
+ * output.
+ */
+std::string
+GarblerClient::decode_output(const GarbledLabels &outputs,
+                             const std::vector<GarbledWire> &final_labels,
+                             int begin) {
+  if (begin + outputs.zeros.size() > final_labels.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Evaluator sent too few final labels! Aborted.");
+  }
+  std::string final_output;
+  for (int i = 0; i < outputs.zeros.size(); i++) {
+    const GarbledWire &label = final_labels[begin + i];
+    if (outputs.zeros[i].value == label.value) {
+      final_output += "0";
+    } else if (outputs.ones[i].value == label.value) {
+      final_output += "1";
+    } else {
+      this->network_driver->disconnect();
+      throw std::runtime_error("Final label matches no output label! Aborted.");
+    }
+  }
+  return final_output;
+}
+
+/**
+ * Number of batch instances garbled per pass over the gates.
+ */
+void GarblerClient::set_instances_per_pass(int k) {
+  if (k < 1) {
+    throw std::runtime_error("Need at least one instance per pass.");
+  }
+  this->instances_per_pass = k;
+}
+
+/**
+ * Use generated code for the circuit when it was built in (the default), or
+ * always run the generic loop. Either garbling evaluates the same way.
+ */
+void GarblerClient::set_specialized(bool enabled) {
+  this->specialized =
+      enabled ? find_specialized_circuit(*this->circuit) : nullptr;
+}
+
+/**
+ * Use pre-garbled circuits from pool instead of garbling in run. The pool
+ * must be for this client's circuit.
+ * @throws error if pool garbles a different circuit.
+ */
+void GarblerClient::set_pool(std::shared_ptr<GarbledCircuitPool> pool) {
+  if (pool && pool->get_fingerprint() != circuit_fingerprint(*this->circuit)) {
+    throw std::runtime_error("Garbled pool is for another circuit.");
+  }
+  this->pool = pool;
+}
+
+/**
+ * Garble this client's circuit once with fresh labels.
+ */
+GarbledCircuit GarblerClient::garble() {
+  GarbledCircuit garbled;
+  garbled.labels = generate_labels(*this->circuit, this->slots);
+  garbled.tables = generate_gates(*this->circuit, this->slots, garbled.labels);
+  return garbled;
+}
+
+/**
+ * Generate garbled gates for the circuit by encrypting each entry.
+ * Output labels are created gate by gate into their slots in `labels`, so
+ * only live wires are held at any time. Runs generated straight-line code
+ * instead of this loop when the circuit was specialized at build time.
+ */
+std::vector<GarbledGate>
+GarblerClient::generate_gates(const Circuit &circuit, const WireSlots &slots,
+                              GarbledLabels &labels) {
+  std::vector<GarbledGate> garbledGates;
+  garbledGates.reserve(circuit.gates.size());
+  GarbleContext ctx{*this, labels, garbledGates};
+  if (this->specialized != nullptr && &circuit == this->circuit.get()) {
+    this->specialized->garble(ctx);
+    return garbledGates;
+  }
+
+  //loop through each gate
+  for (const Gate &gate: circuit.gates) {
+    garble_gate(ctx, slots, gate);
   }
   return garbledGates;
 }
 
 /**
- * Generate labels for *every* wire in the circuit.
+ * Generate labels for the input wires, stored in their slots. Labels of the
+ * other wires are filled in by `generate_gates`.
  * To generate an individual label, use `generate_label`.
  */
-GarbledLabels GarblerClient::generate_labels(Circuit circuit) {
+GarbledLabels GarblerClient::generate_labels(const Circuit &circuit,
+                                             const WireSlots &slots) {
   // TODO: implement me!
   GarbledLabels glabels;
-  std::vector<GarbledWire> zeros;
-  std::vector<GarbledWire> ones;
+  glabels.zeros.resize(slots.num_slots);
+  glabels.ones.resize(slots.num_slots);
 
   // ================= edits to delta, for FREE XOR ========================
   // delta should be universal across all labels
-  // set last bit to 1 to enable point and permute
-  CryptoPP::SecByteBlock delta = generate_label();
-  CryptoPP:: Integer delta_int = byteblock_to_integer(delta);
-  delta_int.SetBit(delta_int.BitCount() - 1, true);
-  delta  = integer_to_byteblock(delta_int);
+  glabels.delta =
+      this->session_delta ? *this->session_delta : generate_delta();
   // ================= edits to delta, for FREE XOR ========================
 
-  for (int i = 0; i < circuit.num_wire; i++) {
+  int num_inputs =
+      circuit.garbler_input_length + circuit.evaluator_input_length;
+  for (int i = 0; i < num_inputs; i++) {
     GarbledWire gw0;
     GarbledWire gw1;
     gw0.value = generate_label();
-    CryptoPP::SecByteBlock label1(LABEL_LENGTH);
-    CryptoPP::xorbuf(label1, gw0.value, delta, LABEL_LENGTH);
-    gw1.value = label1;
-    // gw1.value = generate_label();
-    zeros.push_back(gw0);
-    ones.push_back(gw1);
+    gw1.value = gw0.value ^ glabels.delta;
+    glabels.zeros[slots.slot[i]] = gw0;
+    glabels.ones[slots.slot[i]] = gw1;
   }
 
-  glabels.zeros = zeros;
-  glabels.ones = ones;
-
   return glabels;
 }
 // namespace GateType {
@@ -252,11 +686,11 @@ GarbledLabels GarblerClient::generate_labels(Circuit circuit) {
 // ================================================
 
 // struct GarbledWire {
-//   CryptoPP::SecByteBlock value;
+//   WireLabel value;
 // };
 
 // struct GarbledGate {
-//   std::vector<CryptoPP::SecByteBlock> entries;
+//   std::vector<GateEntry> entries;
 // };
 
 // struct GarbledLabels {
@@ -266,52 +700,42 @@ GarbledLabels GarblerClient::generate_labels(Circuit circuit) {
 
 
 /**
- * Generate the encrypted label given the lhs, rhs, and output of that gate.
- * Remember to tag LABEL_TAG_LENGTH trailing 0s to end before encrypting.
- * You may find CryptoDriver::hash_inputs, CryptoPP::SecByteBlock::CleanGrow,
- * and CryptoPP::xorbuf useful.
+ * Generate the encrypted label given the lhs, rhs, and output of that gate:
+ * the output label tagged with LABEL_TAG_LENGTH trailing 0s, XORed with
+ * garbling_hash(lhs, rhs).
  */
-CryptoPP::SecByteBlock GarblerClient::encrypt_label(GarbledWire lhs,
-                                                    GarbledWire rhs,
-                                                    GarbledWire output) {
-  // TODO: implement me!
-  CryptoPP::SecByteBlock left = this->crypto_driver->hash_inputs(lhs.value, rhs.value);
-  CryptoPP::SecByteBlock right = output.value;
-  right.CleanGrow(2*LABEL_TAG_LENGTH);
-  CryptoPP::SecByteBlock result(2*LABEL_TAG_LENGTH); 
-  CryptoPP::xorbuf(result, left, right, 2*LABEL_TAG_LENGTH);
-
-  return result;
+GateEntry GarblerClient::encrypt_label(const GarbledWire &lhs,
+                                       const GarbledWire &rhs,
+                                       const GarbledWire &output) {
+  return GateEntry::encrypt(lhs.value, rhs.value, output.value);
 }
 
 /**
  * Generate label.
  */
-CryptoPP::SecByteBlock GarblerClient::generate_label() {
-  CryptoPP::SecByteBlock label(LABEL_LENGTH);
-  CryptoPP::OS_GenerateRandomBlock(false, label, label.size());
-  return label;
+WireLabel GarblerClient::generate_label() { return WireLabel::random(); }
+
+/**
+ * Generate a free-XOR offset. The last bit is set to enable point and
+ * permute.
+ */
+WireLabel GarblerClient::generate_delta() {
+  WireLabel delta = generate_label();
+  delta.bytes[LABEL_LENGTH - 1] |= 0x01;
+  return delta;
 }
 
 /*
- * Given a set of 0/1 labels and an input vector of 0's and 1's, returns the
- * labels corresponding to the inputs starting at begin.
+ * Given a set of 0/1 labels and packed input bits, returns the labels
+ * corresponding to the inputs starting at begin.
  */
 std::vector<GarbledWire>
-GarblerClient::get_garbled_wires(GarbledLabels labels, std::vector<int> input,
-                                 int begin) {
+GarblerClient::get_garbled_wires(const GarbledLabels &labels,
+                                 const BitVector &input, int begin) {
   std::vector<GarbledWire> res;
+  res.reserve(input.size());
   for (int i = 0; i < input.size(); i++) {
-    switch (input[i]) {
-    case 0:
-      res.push_back(labels.zeros[begin + i]);
-      break;
-    case 1:
-      res.push_back(labels.ones[begin + i]);
-      break;
-    default:
-      std::cerr << "INVALID INPUT CHARACTER" << std::endl;
-    }
+    res.push_back(input[i] ? labels.ones[begin + i] : labels.zeros[begin + i]);
   }
   return res;
 }
@@ -0,0 +1,87 @@
+#include <boost/asio/post.hpp>
+
+#include "../../include-shared/logger.hpp"
+#include "../../include/pkg/garbler_server.hpp"
+
+namespace {
+src::severity_logger_mt<logging::trivial::severity_level> lg;
+}
+
+/**
+ * Constructor.
+ * @param circuit Circuit garbled for every session.
+ * @param input Garbler's input, used for every session.
+ * @param num_threads Number of sessions served concurrently.
+ * @param garbled_pool Pre-garbled circuits for circuit, or nullptr to garble
+ * in each session.
+ */
+GarblerServer::GarblerServer(std::shared_ptr<const Circuit> circuit,
+                             BitVector input, int num_threads,
+                             std::shared_ptr<GarbledCircuitPool> garbled_pool)
+    : circuit(circuit), input(input), num_threads(num_threads),
+      garbled_pool(garbled_pool), pool(num_threads), active_sessions(0) {
+  initLogger(logging::trivial::severity_level::trace);
+}
+
+/**
+ * Accept connections on the given port, one session each.
+ * @param port Port to listen on.
+ * @param make_driver Creates the unconnected driver for each connection.
+ * @param max_sessions Return once this many connections have been served, or
+ * 0 to serve forever.
+ */
+void GarblerServer::serve(
+    int port, std::function<std::shared_ptr<NetworkDriverImpl>()> make_driver,
+    int max_sessions) {
+  NetworkListener listener(port);
+  CUSTOM_LOG(lg, info) << "serving on port " << port << " with "
+                       << this->num_threads << " threads";
+  for (int session_id = 1; max_sessions == 0 || session_id <= max_sessions;
+       session_id++) {
+    {
+      std::unique_lock<std::mutex> lock(this->active_mutex);
+      this->active_cv.wait(
+          lock, [this] { return this->active_sessions < this->num_threads; });
+      this->active_sessions++;
+    }
+
+    std::shared_ptr<NetworkDriverImpl> network_driver = make_driver();
+    try {
+      listener.accept(network_driver);
+    } catch (std::exception &e) {
+      CUSTOM_LOG(lg, error) << "accept failed: " << e.what();
+      std::lock_guard<std::mutex> lock(this->active_mutex);
+      this->active_sessions--;
+      continue;
+    }
+    boost::asio::post(this->pool, [this, network_driver, session_id] {
+      this->run_session(network_driver, session_id);
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(this->active_mutex);
+  this->active_cv.wait(lock, [this] { return this->active_sessions == 0; });
+}
+
+/**
+ * Run one garbling session to completion. Errors end the session only.
+ */
+void GarblerServer::run_session(std::shared_ptr<NetworkDriver> network_driver,
+                                int session_id) {
+  try {
+    CUSTOM_LOG(lg, info) << "session " << session_id << " from "
+                         << network_driver->get_remote_info();
+    GarblerClient garbler(this->circuit, network_driver,
+                          std::make_shared<CryptoDriver>());
+    garbler.set_pool(this->garbled_pool);
+    garbler.run(this->input);
+    CUSTOM_LOG(lg, info) << "session " << session_id << " done";
+  } catch (std::exception &e) {
+    CUSTOM_LOG(lg, error) << "session " << session_id
+                          << " failed: " << e.what();
+  }
+
+  std::lock_guard<std::mutex> lock(this->active_mutex);
+  this->active_sessions--;
+  this->active_cv.notify_one();
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "../../include-shared/constants.hpp"
+#include "../../include-shared/kernels.hpp"
+#include "../../include/pkg/multi_instance.hpp"
+
+/*
+ * Garble instances; see multi_instance.hpp. Labels of slot s for instance j
+ * are at (s * k + j) * LABEL_LENGTH. Only zero labels are stored; one labels
+ * are zeros ^ delta of their instance.
+ */
+std::vector<std::vector<GarbledGate>>
+garble_instances(const Circuit &circuit, const WireSlots &slots,
+                 const std::vector<GarbledLabels *> &labels) {
+  int k = labels.size();
+  size_t row = (size_t)k * LABEL_LENGTH;
+  std::vector<unsigned char> zeros(slots.num_slots * row), deltas(row);
+  for (int j = 0; j < k; j++) {
+    std::memcpy(&deltas[j * LABEL_LENGTH], labels[j]->delta.data(),
+                LABEL_LENGTH);
+  }
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  for (int i = 0; i < num_inputs; i++) {
+    int s = slots.slot[i];
+    for (int j = 0; j < k; j++) {
+      std::memcpy(&zeros[s * row + j * LABEL_LENGTH],
+                  labels[j]->zeros[s].value.data(), LABEL_LENGTH);
+    }
+  }
+
+  std::vector<std::vector<GarbledGate>> tables(k);
+  for (std::vector<GarbledGate> &instance : tables) {
+    instance.reserve(circuit.gates.size());
+  }
+  const Kernels &ops = kernels();
+  // One per thread since sessions garble concurrently.
+  static thread_local std::mt19937 shuffle_rng{std::random_device{}()};
+  for (const Gate &gate : circuit.gates) {
+    const unsigned char *lhs = &zeros[slots.slot[gate.lhs] * row];
+    unsigned char *out = &zeros[slots.slot[gate.output] * row];
+    if (gate.type == GateType::XOR_GATE) {
+      ops.xor_bytes(out, lhs, &zeros[slots.slot[gate.rhs] * row], row);
+    } else if (gate.type == GateType::NOT_GATE) {
+      ops.xor_bytes(out, lhs, deltas.data(), row);
+    } else if (gate.type == GateType::AND_GATE) {
+      const unsigned char *rhs = &zeros[slots.slot[gate.rhs] * row];
+      random_bytes(out, row);
+      for (int j = 0; j < k; j++) {
+        const WireLabel &delta = labels[j]->delta;
+        WireLabel x0 = WireLabel::from_bytes(lhs + j * LABEL_LENGTH);
+        WireLabel y0 = WireLabel::from_bytes(rhs + j * LABEL_LENGTH);
+        WireLabel z0 = WireLabel::from_bytes(out + j * LABEL_LENGTH);
+        WireLabel x1 = x0 ^ delta, y1 = y0 ^ delta, z1 = z0 ^ delta;
+        GarbledGate table;
+        table.entries = {GateEntry::encrypt(x0, y0, z0),
+                         GateEntry::encrypt(x0, y1, z0),
+                         GateEntry::encrypt(x1, y0, z0),
+                         GateEntry::encrypt(x1, y1, z1)};
+        std::shuffle(table.entries.begin(), table.entries.end(), shuffle_rng);
+        tables[j].push_back(std::move(table));
+      }
+      continue;
+    } else {
+      throw std::runtime_error("Invalid gate type! Aborted.");
+    }
+    for (std::vector<GarbledGate> &instance : tables) {
+      instance.emplace_back();
+    }
+  }
+
+  // Output labels back into each instance's slots.
+  int first_output = circuit.num_wire - circuit.output_length;
+  for (int i = 0; i < circuit.output_length; i++) {
+    int s = slots.slot[first_output + i];
+    for (int j = 0; j < k; j++) {
+      const unsigned char *z0 = &zeros[s * row + j * LABEL_LENGTH];
+      labels[j]->zeros[s].value = WireLabel::from_bytes(z0);
+      labels[j]->ones[s].value = labels[j]->zeros[s].value ^ labels[j]->delta;
+    }
+  }
+  return tables;
+}
+
+/*
+ * Evaluate instances; see multi_instance.hpp. Same layout as
+ * garble_instances.
+ */
+std::vector<std::vector<GarbledWire>>
+evaluate_instances(const Circuit &circuit, const WireSlots &slots,
+                   const std::vector<const std::vector<GarbledGate> *> &tables,
+                   const std::vector<std::vector<GarbledWire>> &inputs) {
+  int k = tables.size();
+  size_t row = (size_t)k * LABEL_LENGTH;
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  if (inputs.size() != k) {
+    throw std::runtime_error("Need input labels for every instance.");
+  }
+  std::vector<unsigned char> wires(slots.num_slots * row);
+  for (int j = 0; j < k; j++) {
+    if (tables[j]->size() != circuit.gates.size() ||
+        inputs[j].size() != num_inputs) {
+      throw std::runtime_error("Garbled circuit does not match the circuit! Aborted.");
+    }
+    for (int i = 0; i < num_inputs; i++) {
+      std::memcpy(&wires[slots.slot[i] * row + j * LABEL_LENGTH],
+                  inputs[j][i].value.data(), LABEL_LENGTH);
+    }
+  }
+
+  const Kernels &ops = kernels();
+  for (int g = 0; g < circuit.gates.size(); g++) {
+    const Gate &gate = circuit.gates[g];
+    const unsigned char *lhs = &wires[slots.slot[gate.lhs] * row];
+    unsigned char *out = &wires[slots.slot[gate.output] * row];
+    if (gate.type == GateType::XOR_GATE) {
+      ops.xor_bytes(out, lhs, &wires[slots.slot[gate.rhs] * row], row);
+    } else if (gate.type == GateType::NOT_GATE) {
+      std::memcpy(out, lhs, row);
+    } else if (gate.type == GateType::AND_GATE) {
+      const unsigned char *rhs = &wires[slots.slot[gate.rhs] * row];
+      for (int j = 0; j < k; j++) {
+        GateEntry pad =
+            GateEntry::pad(WireLabel::from_bytes(lhs + j * LABEL_LENGTH),
+                           WireLabel::from_bytes(rhs + j * LABEL_LENGTH));
+        bool decrypted = false;
+        for (const GateEntry &entry : (*tables[j])[g].entries) {
+          GateEntry decryption = entry ^ pad;
+          if (decryption.tag_is_zero()) {
+            std::memcpy(out + j * LABEL_LENGTH, decryption.data(),
+                        LABEL_LENGTH);
+            decrypted = true;
+            break;
+          }
+        }
+        if (!decrypted) {
+          throw std::runtime_error("No entry of gate " + std::to_string(g) +
+                                   " decrypts! Aborted.");
+        }
+      }
+    } else {
+      throw std::runtime_error("Invalid gate type!");
+    }
+  }
+
+  std::vector<std::vector<GarbledWire>> outputs(k);
+  int first_output = circuit.num_wire - circuit.output_length;
+  for (int j = 0; j < k; j++) {
+    for (int i = 0; i < circuit.output_length; i++) {
+      outputs[j].push_back({WireLabel::from_bytes(
+          &wires[slots.slot[first_output + i] * row + j * LABEL_LENGTH])});
+    }
+  }
+  return outputs;
+}
@@ -0,0 +1,173 @@
+#include "../../include/pkg/session.hpp"
+
+// ================================================
+// GARBLER
+// ================================================
+
+/**
+ * Constructor. No messages are exchanged until the first job.
+ */
+GarblerSession::GarblerSession(std::shared_ptr<NetworkDriver> network_driver,
+                               std::shared_ptr<CryptoDriver> crypto_driver)
+    : network_driver(network_driver), crypto_driver(crypto_driver) {}
+
+/**
+ * Make circuit available to jobs as id.
+ */
+void GarblerSession::add_circuit(std::string id,
+                                 std::shared_ptr<const Circuit> circuit) {
+  this->circuits.add(id, circuit);
+}
+
+/**
+ * Announce circuit_id, then garble and run it on input. Exchanges keys first
+ * if this is the session's first job.
+ * Returns the job's output.
+ */
+std::string GarblerSession::run_job(const std::string &circuit_id,
+                                    const BitVector &input) {
+  return this->start_job(circuit_id).run(input);
+}
+
+/**
+ * Run a reactive job; see GarblerClient::run_reactive.
+ * Returns the revealed outputs.
+ */
+std::string GarblerSession::run_job(const std::string &circuit_id,
+                                    const BitVector &input,
+                                    const JobWiring &wiring) {
+  return this->start_job(circuit_id).run_reactive(input, wiring, this->kept);
+}
+
+/**
+ * Set up the keys on first use and announce circuit_id.
+ * Returns the client to run the job.
+ */
+GarblerClient &GarblerSession::start_job(const std::string &circuit_id) {
+  GarblerClient &garbler = this->circuits.client(
+      circuit_id, this->network_driver, this->crypto_driver);
+  if (!this->keys) {
+    this->keys = garbler.HandleKeyExchange();
+    this->ot_driver = std::make_shared<OTDriver>(
+        this->network_driver, this->crypto_driver, *this->keys);
+    this->delta = garbler.generate_delta();
+  }
+  garbler.use_session_keys(*this->keys, this->ot_driver);
+  garbler.use_session_delta(this->delta);
+
+  GarblerToEvaluator_CircuitAnnouncement_Message announcement;
+  announcement.circuit_id = circuit_id;
+  announcement.fingerprint =
+      circuit_fingerprint(this->circuits.at(circuit_id));
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      this->keys->first, this->keys->second, &announcement));
+  return garbler;
+}
+
+/**
+ * Tell the evaluator there are no more jobs and disconnect.
+ */
+void GarblerSession::close() {
+  if (this->keys) {
+    GarblerToEvaluator_CircuitAnnouncement_Message announcement;
+    this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+        this->keys->first, this->keys->second, &announcement));
+  }
+  this->network_driver->disconnect();
+}
+
+// ================================================
+// EVALUATOR
+// ================================================
+
+/**
+ * Constructor. No messages are exchanged until the first job.
+ */
+EvaluatorSession::EvaluatorSession(
+    std::shared_ptr<NetworkDriver> network_driver,
+    std::shared_ptr<CryptoDriver> crypto_driver)
+    : network_driver(network_driver), crypto_driver(crypto_driver) {}
+
+/**
+ * Make circuit available to jobs as id.
+ */
+void EvaluatorSession::add_circuit(std::string id,
+                                   std::shared_ptr<const Circuit> circuit) {
+  this->circuits.add(id, circuit);
+}
+
+/**
+ * Check the garbler announced circuit_id with the same circuit, then
+ * evaluate it on input. Exchanges keys first if this is the session's first
+ * job.
+ * Returns the job's output.
+ */
+std::string EvaluatorSession::run_job(const std::string &circuit_id,
+                                      const BitVector &input) {
+  return this->start_job(circuit_id).run(input);
+}
+
+/**
+ * Run a reactive job; see EvaluatorClient::run_reactive.
+ * Returns the revealed outputs.
+ */
+std::string EvaluatorSession::run_job(const std::string &circuit_id,
+                                      const BitVector &input,
+                                      const JobWiring &wiring) {
+  return this->start_job(circuit_id).run_reactive(input, wiring, this->kept);
+}
+
+/**
+ * Set up the keys on first use and check the garbler's announcement.
+ * Returns the client to run the job.
+ */
+EvaluatorClient &EvaluatorSession::start_job(const std::string &circuit_id) {
+  EvaluatorClient &evaluator = this->circuits.client(
+      circuit_id, this->network_driver, this->crypto_driver);
+  if (!this->keys) {
+    this->keys = evaluator.HandleKeyExchange();
+    this->ot_driver = std::make_shared<OTDriver>(
+        this->network_driver, this->crypto_driver, *this->keys);
+  }
+  evaluator.use_session_keys(*this->keys, this->ot_driver);
+
+  GarblerToEvaluator_CircuitAnnouncement_Message announcement =
+      this->read_announcement();
+  if (announcement.circuit_id != circuit_id ||
+      announcement.fingerprint !=
+          circuit_fingerprint(this->circuits.at(circuit_id))) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler announced circuit " +
+                             announcement.circuit_id + " instead of " +
+                             circuit_id + "! Aborted.");
+  }
+  return evaluator;
+}
+
+/**
+ * Wait for the garbler to end the session, then disconnect.
+ */
+void EvaluatorSession::close() {
+  if (this->keys) {
+    GarblerToEvaluator_CircuitAnnouncement_Message announcement =
+        this->read_announcement();
+    if (!announcement.circuit_id.empty()) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("Garbler has more jobs than the evaluator! Aborted.");
+    }
+  }
+  this->network_driver->disconnect();
+}
+
+GarblerToEvaluator_CircuitAnnouncement_Message
+EvaluatorSession::read_announcement() {
+  auto [data, valid] = this->crypto_driver->decrypt_and_verify(
+      this->keys->first, this->keys->second, this->network_driver->read());
+  if (!valid) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("Garbler identity authentication failed! Aborted.");
+  }
+  GarblerToEvaluator_CircuitAnnouncement_Message announcement;
+  announcement.deserialize(data);
+  return announcement;
+}
@@ -0,0 +1,34 @@
+#include "../../include/pkg/specialized_circuit.hpp"
+
+namespace {
+/*
+ * Registered circuits. Filled during static initialization, read-only after.
+ */
+std::vector<SpecializedCircuit> &registry() {
+  static std::vector<SpecializedCircuit> circuits;
+  return circuits;
+}
+} // namespace
+
+/*
+ * Register generated code; called from each generated file.
+ */
+SpecializedCircuitRegistration::SpecializedCircuitRegistration(
+    SpecializedCircuit specialized) {
+  registry().push_back(specialized);
+}
+
+/*
+ * Find generated code for circuit. Skips fingerprinting when nothing is
+ * registered.
+ */
+const SpecializedCircuit *find_specialized_circuit(const Circuit &circuit) {
+  if (registry().empty())
+    return nullptr;
+  std::string fingerprint = circuit_fingerprint(circuit);
+  for (const SpecializedCircuit &specialized : registry()) {
+    if (specialized.fingerprint == fingerprint)
+      return &specialized;
+  }
+  return nullptr;
+}
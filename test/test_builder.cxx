@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <functional>
+#include <random>
+
+#include "doctest/doctest.h"
+
+#include "../include-shared/circuit.hpp"
+#include "../include-shared/circuit_builder.hpp"
+#include "../include-shared/circuit_optimizer.hpp"
+
+namespace {
+using Bits = CircuitBuilder::Bits;
+using Generator =
+    std::function<Bits(CircuitBuilder &, const Bits &, const Bits &)>;
+
+/*
+ * Plaintext evaluation on two little-endian operands; returns up to 64
+ * output bits as a number. One value per wire, so it does not share the
+ * simulator's slot assignment.
+ */
+uint64_t evaluate(const Circuit &circuit, uint64_t x, uint64_t y) {
+  std::vector<int> wires(circuit.num_wire, 0);
+  for (int i = 0; i < circuit.garbler_input_length; i++)
+    wires[i] = (x >> i) & 1;
+  for (int i = 0; i < circuit.evaluator_input_length; i++)
+    wires[circuit.garbler_input_length + i] = (y >> i) & 1;
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::AND_GATE)
+      wires[gate.output] = wires[gate.lhs] & wires[gate.rhs];
+    else if (gate.type == GateType::XOR_GATE)
+      wires[gate.output] = wires[gate.lhs] ^ wires[gate.rhs];
+    else
+      wires[gate.output] = !wires[gate.lhs];
+  }
+  uint64_t out = 0;
+  int first_output = circuit.num_wire - circuit.output_length;
+  for (int i = 0; i < circuit.output_length; i++)
+    out |= (uint64_t)wires[first_output + i] << i;
+  return out;
+}
+
+/*
+ * Check a generator against a reference on random operands.
+ */
+void check_generator(int nx, int ny, Generator body,
+                     std::function<uint64_t(uint64_t, uint64_t)> expected) {
+  Circuit circuit = build_circuit(nx, ny, body);
+  std::mt19937_64 rng(nx * 131 + ny);
+  uint64_t mask_x = nx == 64 ? ~0ull : (1ull << nx) - 1;
+  uint64_t mask_y = ny == 64 ? ~0ull : (1ull << ny) - 1;
+  uint64_t mask_out = circuit.output_length == 64
+                          ? ~0ull
+                          : (1ull << circuit.output_length) - 1;
+  for (int trial = 0; trial < 200; trial++) {
+    uint64_t x = rng() & mask_x, y = rng() & mask_y;
+    if (trial < 4) { // edge values
+      x = trial & 1 ? mask_x : 0;
+      y = trial & 2 ? mask_y : 0;
+    }
+    CHECK(evaluate(circuit, x, y) == (expected(x, y) & mask_out));
+  }
+}
+} // namespace
+
+TEST_CASE("builder arithmetic matches integers") {
+  using namespace circuits;
+  auto sum = [](uint64_t x, uint64_t y) { return x + y; };
+  auto product = [](uint64_t x, uint64_t y) { return x * y; };
+  for (int n : {1, 5, 16, 31}) {
+    check_generator(n, n, add, sum);
+    check_generator(n, n, add_lookahead, sum);
+  }
+  check_generator(9, 4, add, sum);
+  check_generator(20, 20, subtract,
+                  [](uint64_t x, uint64_t y) { return x - y; });
+  for (int n : {3, 8, 24, 32})
+    check_generator(n, n, multiply, product);
+  check_generator(7, 5, multiply, product);
+  check_generator(20, 30, multiply, product);
+}
+
+TEST_CASE("builder comparisons and mux") {
+  using namespace circuits;
+  for (int n : {1, 8, 32}) {
+    check_generator(
+        n, n,
+        [](CircuitBuilder &b, const Bits &x, const Bits &y) {
+          return Bits{less_than(b, x, y), greater_than(b, x, y),
+                      equal(b, x, y), equal(b, x, x)};
+        },
+        [](uint64_t x, uint64_t y) {
+          return (x < y) | (x > y) << 1 | (x == y) << 2 | 1 << 3;
+        });
+  }
+  // Low bit of y selects between x and the rest of y.
+  check_generator(
+      8, 9,
+      [](CircuitBuilder &b, const Bits &x, const Bits &y) {
+        return mux(b, y[0], x, Bits(y.begin() + 1, y.end()));
+      },
+      [](uint64_t x, uint64_t y) { return y & 1 ? x : y >> 1; });
+}
+
+TEST_CASE("builder beats the shipped circuits") {
+  // One AND per bit; adder.txt has 375 gates, 127 of them AND.
+  Circuit adder = build_circuit(32, 32, circuits::add);
+  CHECK(count_gates(adder).and_gates == 32);
+  CHECK(adder.num_gate < 375);
+
+  Circuit mult = build_circuit(32, 32, circuits::multiply);
+  Circuit shipped = parse_circuit(std::string(CIRCUITS_DIR) + "mult.txt");
+  CHECK(mult.num_gate < shipped.num_gate);
+  CHECK(count_gates(mult).and_gates < count_gates(shipped).and_gates / 2);
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "doctest/doctest.h"
+
+#include "../include-shared/bit_vector.hpp"
+#include "../include-shared/circuit.hpp"
+#include "../include-shared/circuit_simulator.hpp"
+#include "../include-shared/compiled_circuit.hpp"
+#include "../include-shared/kernels.hpp"
+#include "../include-shared/secure_arena.hpp"
+#include "../include-shared/util.hpp"
+
+namespace {
+/*
+ * Write contents to a scratch circuit file and return its path.
+ */
+std::string write_circuit(std::string contents) {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "yaos_test_circuit.txt")
+          .string();
+  std::ofstream(path) << contents;
+  return path;
+}
+
+bool same_gates(const Circuit &a, const Circuit &b) {
+  if (a.gates.size() != b.gates.size())
+    return false;
+  for (int i = 0; i < a.gates.size(); i++) {
+    if (a.gates[i].type != b.gates[i].type || a.gates[i].lhs != b.gates[i].lhs ||
+        a.gates[i].output != b.gates[i].output ||
+        (a.gates[i].type != GateType::NOT_GATE &&
+         a.gates[i].rhs != b.gates[i].rhs))
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Encrypt, pad and decrypt one table entry with labels of Bits bits.
+ */
+template <size_t Bits> void check_label_round_trip() {
+  using L = Label<Bits>;
+  using E = TableEntry<Bits>;
+  CHECK(L::LENGTH == Bits / 8);
+  CHECK(E::LENGTH == 2 * L::LENGTH);
+
+  L x = L::random(), y = L::random(), z = L::random();
+  CHECK(L::from_string(z.to_string()) == z);
+  CHECK_THROWS(L::from_string(z.to_string() + "x"));
+  L delta = L::random();
+  delta.bytes[L::LENGTH - 1] |= 0x01;
+  CHECK((z ^ delta).point_bit() != z.point_bit());
+  CHECK(((z ^ delta) ^ delta) == z);
+
+  E entry = E::encrypt(x, y, z);
+  E decryption = entry ^ E::pad(x, y);
+  CHECK(decryption.tag_is_zero());
+  CHECK(decryption.label() == z);
+  CHECK(E::from_bytes(entry.data()).label() == entry.label());
+  // Under any other labels the tag does not come out zero.
+  CHECK(!(entry ^ E::pad(x ^ delta, y)).tag_is_zero());
+  CHECK(!(entry ^ E::pad(y, x)).tag_is_zero());
+}
+} // namespace
+
+TEST_CASE("mmap parser matches stdio parser") {
+  for (std::string name : {"and", "xor", "not", "adder", "mult", "aes"}) {
+    std::string file = std::string(CIRCUITS_DIR) + name + ".txt";
+    Circuit fast = parse_circuit(file);
+    Circuit slow = parse_circuit_stdio(file);
+    CHECK(fast.num_gate == slow.num_gate);
+    CHECK(fast.num_wire == slow.num_wire);
+    CHECK(fast.garbler_input_length == slow.garbler_input_length);
+    CHECK(fast.evaluator_input_length == slow.evaluator_input_length);
+    CHECK(fast.output_length == slow.output_length);
+    CHECK(same_gates(fast, slow));
+  }
+}
+
+TEST_CASE("parser accepts loose whitespace") {
+  Circuit c = parse_circuit(write_circuit("2 4\r\n1 1 1\r\n\r\n"
+                                          "2 1 0 1 2 AND\r\n"
+                                          "  1 1 2 3 INV"));
+  REQUIRE(c.gates.size() == 2);
+  CHECK(c.gates[0].type == GateType::AND_GATE);
+  CHECK(c.gates[1].type == GateType::NOT_GATE);
+  CHECK(c.gates[1].lhs == 2);
+  CHECK(c.gates[1].output == 3);
+}
+
+TEST_CASE("parser lowers Bristol Fashion gates") {
+  // a = w0 w1, b = w2 w3; outputs a1&b1, a0&b0, 0, 1.
+  Circuit c = parse_circuit(write_circuit("7 12\n2 2 2\n1 4\n\n"
+                                          "4 2 0 1 2 3 4 5 MAND\n"
+                                          "1 1 4 6 INV\n"
+                                          "1 1 1 7 EQ\n"
+                                          "1 1 5 8 EQW\n"
+                                          "2 1 6 7 9 XOR\n"
+                                          "1 1 0 10 EQ\n"
+                                          "1 1 7 11 EQW\n"));
+  CHECK(c.garbler_input_length == 2);
+  CHECK(c.evaluator_input_length == 2);
+  CHECK(c.output_length == 4);
+  CHECK(c.num_wire == 13); // plus the zero wire
+  CHECK(c.num_gate == 9);
+  int num_and = 0;
+  for (const Gate &g : c.gates)
+    num_and += g.type == GateType::AND_GATE;
+  CHECK(num_and == 2);
+
+  for (int x = 0; x < 16; x++) {
+    std::vector<int> wires(c.num_wire);
+    for (int i = 0; i < 4; i++)
+      wires[i] = (x >> i) & 1;
+    for (const Gate &g : c.gates) {
+      if (g.type == GateType::AND_GATE)
+        wires[g.output] = wires[g.lhs] & wires[g.rhs];
+      else if (g.type == GateType::XOR_GATE)
+        wires[g.output] = wires[g.lhs] ^ wires[g.rhs];
+      else
+        wires[g.output] = 1 - wires[g.lhs];
+    }
+    std::vector<int> expected = {wires[1] & wires[3], wires[0] & wires[2], 0,
+                                 1};
+    CHECK(std::vector<int>(wires.end() - 4, wires.end()) == expected);
+  }
+}
+
+TEST_CASE("parser rejects malformed circuits") {
+  CHECK_THROWS(parse_circuit("/nonexistent/circuit.txt"));
+  CHECK_THROWS(parse_circuit_stdio("/nonexistent/circuit.txt"));
+  // Unknown gate type.
+  CHECK_THROWS(parse_circuit(write_circuit("1 3\n1 1 1\n\n2 1 0 1 2 EQW\n")));
+  CHECK_THROWS(
+      parse_circuit_stdio(write_circuit("1 3\n1 1 1\n\n2 1 0 1 2 EQW\n")));
+  // Wire out of range.
+  CHECK_THROWS(parse_circuit(write_circuit("1 3\n1 1 1\n\n2 1 0 7 2 AND\n")));
+  // Input used before it is assigned.
+  CHECK_THROWS(parse_circuit(
+      write_circuit("2 4\n1 1 1\n\n2 1 0 2 3 AND\n2 1 0 1 2 XOR\n")));
+  // Wire assigned twice.
+  CHECK_THROWS(parse_circuit(
+      write_circuit("2 4\n1 1 1\n\n2 1 0 1 2 AND\n2 1 0 1 2 XOR\n")));
+  // Fewer gates than the header promises.
+  CHECK_THROWS(parse_circuit(write_circuit("2 4\n1 1 1\n\n2 1 0 1 2 AND\n")));
+  // Bristol Fashion: group count mismatch, bad constant, MAND shape.
+  CHECK_THROWS(parse_circuit(write_circuit("1 3\n3 1 1\n1 1\n\n"
+                                           "2 1 0 1 2 AND\n")));
+  CHECK_THROWS(parse_circuit(write_circuit("1 3\n2 1 1\n1 1\n\n"
+                                           "1 1 2 2 EQ\n")));
+  CHECK_THROWS(parse_circuit(write_circuit("1 4\n2 1 1\n1 2\n\n"
+                                           "3 2 0 1 0 2 3 MAND\n")));
+  // Trailing data.
+  CHECK_THROWS(
+      parse_circuit(write_circuit("1 3\n1 1 1\n\n2 1 0 1 2 AND\n2 1\n")));
+  std::remove(write_circuit("").c_str());
+}
+
+TEST_CASE("levels and liveness") {
+  // w3 = w0 & w1; w4 = !w3; w5 = w4 ^ w2
+  Circuit c = parse_circuit(write_circuit("3 6\n2 1 1\n\n2 1 0 1 3 AND\n"
+                                          "1 1 3 4 INV\n2 1 4 2 5 XOR\n"));
+  std::vector<uint32_t> levels = {0, 1, 2};
+  std::vector<uint32_t> last_use = {0, 0, 2, 1, 2, 3};
+  CHECK(compute_gate_levels(c) == levels);
+  CHECK(compute_wire_last_use(c) == last_use);
+}
+
+TEST_CASE("fingerprint tracks gates, not files") {
+  std::string dir = CIRCUITS_DIR;
+  Circuit adder = parse_circuit(dir + "adder.txt");
+  std::string fingerprint = circuit_fingerprint(adder);
+  CHECK(fingerprint.size() == 64);
+  CHECK(circuit_fingerprint(parse_circuit_stdio(dir + "adder.txt")) ==
+        fingerprint);
+  CHECK(circuit_fingerprint(schedule_circuit(adder)) != fingerprint);
+
+  // The unused rhs of a NOT does not count.
+  std::vector<Gate> gates(adder.gates.begin(), adder.gates.end());
+  for (Gate &gate : gates) {
+    if (gate.type == GateType::NOT_GATE)
+      gate.rhs = 7;
+  }
+  Circuit copy = adder;
+  copy.set_gates(gates);
+  CHECK(circuit_fingerprint(copy) == fingerprint);
+  gates[0].lhs ^= 1;
+  copy.set_gates(gates);
+  CHECK(circuit_fingerprint(copy) != fingerprint);
+}
+
+TEST_CASE("wire slots reuse dead wires") {
+  for (std::string name : {"adder", "mult", "aes"}) {
+    Circuit c = parse_circuit(std::string(CIRCUITS_DIR) + name + ".txt");
+    WireSlots slots = assign_wire_slots(c);
+    CHECK(slots.num_slots < c.num_wire / 2);
+
+    // Evaluate on random inputs once per wire and once per slot.
+    std::vector<int> wires(c.num_wire), pool(slots.num_slots);
+    int num_inputs = c.garbler_input_length + c.evaluator_input_length;
+    for (int w = 0; w < num_inputs; w++)
+      wires[w] = pool[slots.slot[w]] = (w * 7919 + 13) % 3 == 0;
+    for (const Gate &g : c.gates) {
+      int a = wires[g.lhs], pa = pool[slots.slot[g.lhs]];
+      int b = g.type == GateType::NOT_GATE ? 0 : wires[g.rhs];
+      int pb = g.type == GateType::NOT_GATE ? 0 : pool[slots.slot[g.rhs]];
+      auto apply = [&](int x, int y) {
+        return g.type == GateType::AND_GATE   ? x & y
+               : g.type == GateType::XOR_GATE ? x ^ y
+                                              : 1 - x;
+      };
+      wires[g.output] = apply(a, b);
+      pool[slots.slot[g.output]] = apply(pa, pb);
+    }
+    for (int w = c.num_wire - c.output_length; w < c.num_wire; w++)
+      CHECK(pool[slots.slot[w]] == wires[w]);
+  }
+}
+
+TEST_CASE("simulator matches known outputs in every lane") {
+  std::string dir = CIRCUITS_DIR;
+  Circuit aes = parse_circuit(dir + "aes.txt");
+  std::vector<int> input = parse_input(dir + "aes-input-1.txt");
+  std::vector<int> key = parse_input(dir + "aes-input-2.txt");
+  input.insert(input.end(), key.begin(), key.end());
+  std::string expected =
+      "1000001001001111000110011101010000000010111000101101101010101010"
+      "0011000110000011111100110100101110000011111100000011011110000000";
+
+  CircuitSimulator sim(aes);
+  std::string output;
+  for (int bit : sim.run(input))
+    output += bit ? "1" : "0";
+  CHECK(output == expected);
+
+  // Lane k of run256 sees the known input when k % 3 == 0, else noise; each
+  // lane must agree with a 64-lane run of the same sets.
+  std::mt19937_64 rng(256);
+  std::vector<uint64_t> wide(4 * input.size()), narrow(input.size());
+  for (int w = 0; w < input.size(); w++) {
+    for (int j = 0; j < 4; j++) {
+      uint64_t known = input[w] ? 0x9249249249249249 : 0;
+      wide[4 * w + j] = (rng() & ~0x9249249249249249) | known;
+    }
+  }
+  std::vector<uint64_t> wide_out = sim.run256(wide);
+  for (int j = 0; j < 4; j++) {
+    for (int w = 0; w < input.size(); w++)
+      narrow[w] = wide[4 * w + j];
+    std::vector<uint64_t> narrow_out = sim.run64(narrow);
+    bool same = true, known_lanes = true;
+    for (int i = 0; i < narrow_out.size(); i++) {
+      same = same && narrow_out[i] == wide_out[4 * i + j];
+      uint64_t want = expected[i] == '1' ? 0x9249249249249249 : 0;
+      known_lanes = known_lanes && (narrow_out[i] & 0x9249249249249249) == want;
+    }
+    CHECK(same);
+    CHECK(known_lanes);
+  }
+}
+
+TEST_CASE("compiled circuits round trip") {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "yaos_test_circuit.yc")
+          .string();
+  Circuit text = parse_circuit(std::string(CIRCUITS_DIR) + "aes.txt");
+  compile_circuit(text, path);
+
+  CompiledCircuit compiled = load_compiled_circuit(path);
+  CHECK(compiled.circuit.num_wire == text.num_wire);
+  CHECK(compiled.circuit.garbler_input_length == text.garbler_input_length);
+  CHECK(compiled.circuit.output_length == text.output_length);
+  CHECK(same_gates(compiled.circuit, text));
+  std::vector<uint32_t> levels = compute_gate_levels(text);
+  CHECK(std::equal(levels.begin(), levels.end(),
+                   compiled.gate_levels.begin(), compiled.gate_levels.end()));
+  std::vector<uint32_t> last_use = compute_wire_last_use(text);
+  CHECK(std::equal(last_use.begin(), last_use.end(),
+                   compiled.wire_last_use.begin(),
+                   compiled.wire_last_use.end()));
+  CHECK(is_compiled_circuit(path));
+  CHECK(same_gates(load_circuit(path), text));
+  CHECK(compiled.circuit.level_offsets.empty());
+
+  // The view keeps the mapping alive after the loader's copy is gone.
+  Circuit view = load_compiled_circuit(path).circuit;
+  CHECK(view.gates.back().output == text.gates.back().output);
+
+  // Flip one last-use byte: only a verified load notices.
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(std::filesystem::file_size(path) - 1);
+    f.put(0x7f);
+  }
+  CHECK_NOTHROW(load_compiled_circuit(path, false));
+  CHECK_THROWS(load_compiled_circuit(path));
+  // A gate reading an unassigned wire is rejected despite a valid checksum.
+  {
+    Circuit bad = text;
+    std::vector<Gate> gates(text.gates.begin(), text.gates.end());
+    gates[0].lhs = gates.back().output;
+    bad.set_gates(gates);
+    compile_circuit(bad, path);
+  }
+  CHECK_THROWS(load_compiled_circuit(path));
+  CHECK_THROWS(load_compiled_circuit(path, false));
+  // Scheduled circuits keep their level boundaries.
+  Circuit scheduled = schedule_circuit(text);
+  compile_circuit(scheduled, path);
+  CHECK(load_compiled_circuit(path).circuit.level_offsets ==
+        scheduled.level_offsets);
+  // The level count is bounded before it sizes anything.
+  for (uint32_t num_levels : {0u, 0xFFFFFFFFu}) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offsetof(CompiledCircuitHeader, num_levels));
+    f.write(reinterpret_cast<const char *>(&num_levels), sizeof(num_levels));
+    f.close();
+    CHECK_THROWS(load_compiled_circuit(path, false));
+  }
+  std::remove(path.c_str());
+
+  CHECK_FALSE(is_compiled_circuit(std::string(CIRCUITS_DIR) + "aes.txt"));
+  CHECK_THROWS(load_compiled_circuit(std::string(CIRCUITS_DIR) + "aes.txt"));
+}
+
+TEST_CASE("input formats read back the same bits") {
+  std::mt19937 rng(47);
+  std::vector<BitVector> inputs(4);
+  for (BitVector &input : inputs) {
+    for (int i = 0; i < 70; i++)
+      input.push_back(rng() & 1);
+  }
+  CHECK(BitVector::from_string("0110").to_hex() == "6");
+  CHECK(BitVector::from_hex("6") == BitVector::from_string("0110"));
+  CHECK_THROWS(BitVector(std::vector<int>{0, 2}));
+
+  std::string path =
+      (std::filesystem::temp_directory_path() / "yaos_test_inputs").string();
+  write_binary_input(path, inputs);
+  CHECK(read_batch_input(path, InputFormat::BINARY, 70) == inputs);
+  CHECK_THROWS(read_batch_input(path, InputFormat::BINARY, 71));
+
+  std::ofstream text(path), hex(path + ".hex");
+  for (const BitVector &input : inputs) {
+    text << input.to_string() << "\n\n";
+    hex << input.to_hex() << "\n";
+  }
+  text.close();
+  hex.close();
+  CHECK(read_batch_input(path, InputFormat::TEXT, 70) == inputs);
+  CHECK(read_batch_input(path + ".hex", InputFormat::HEX, 70) == inputs);
+  // 70 bits take 18 hex digits; the two spare bits must be zero.
+  std::ofstream(path + ".hex") << "f" << std::string(17, '0') << "\n";
+  CHECK(read_batch_input(path + ".hex", InputFormat::HEX, 70).size() == 1);
+  std::ofstream(path + ".hex") << std::string(17, '0') << "f\n";
+  CHECK_THROWS(read_batch_input(path + ".hex", InputFormat::HEX, 70));
+  std::remove(path.c_str());
+  std::remove((path + ".hex").c_str());
+}
+
+TEST_CASE("every kernel set this CPU runs gives the same results") {
+  // FIPS-197 appendix C.1.
+  unsigned char key[16], plain[16];
+  for (int i = 0; i < 16; i++) {
+    key[i] = i;
+    plain[i] = 0x11 * i;
+  }
+  const unsigned char cipher[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b,
+                                    0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80,
+                                    0x70, 0xb4, 0xc5, 0x5a};
+  // Fixed-key AES garbling hash, computed independently with openssl.
+  unsigned char hx[16], hy[16];
+  for (int i = 0; i < 16; i++) {
+    hx[i] = i * 7 + 1;
+    hy[i] = 200 - i;
+  }
+  const unsigned char hashed[32] = {
+      0x37, 0x18, 0x3f, 0xb6, 0x06, 0x3d, 0x68, 0x59, 0x17, 0x86, 0x10,
+      0x25, 0xd8, 0x18, 0xd8, 0x20, 0xa6, 0x73, 0x25, 0x5b, 0x4f, 0x83,
+      0x70, 0x44, 0x99, 0x01, 0x95, 0xa8, 0x02, 0x45, 0x9a, 0x6c};
+  const unsigned char hashed80[20] = {
+      0x51, 0x3e, 0xc4, 0xc5, 0x43, 0xeb, 0x95, 0x54, 0x83, 0x3a,
+      0xb9, 0xc2, 0x2c, 0xe6, 0x6d, 0x0c, 0x1c, 0x62, 0x4b, 0x26};
+  std::mt19937 rng(49);
+  std::vector<unsigned char> a(203), b(203), expected(203);
+  for (int i = 0; i < 203; i++) {
+    a[i] = rng();
+    b[i] = rng();
+    expected[i] = a[i] ^ b[i];
+  }
+
+  for (const std::string &name : supported_kernels()) {
+    select_kernels(name);
+    const Kernels &k = kernels();
+    std::vector<unsigned char> out(203);
+    k.xor_bytes(out.data(), a.data(), b.data(), out.size());
+    CHECK(out == expected);
+    // Labels and table entries XOR through the selected set.
+    WireLabel x = WireLabel::from_bytes(a.data());
+    x ^= WireLabel::from_bytes(b.data());
+    CHECK(std::equal(x.data(), x.data() + x.size(), expected.begin()));
+    GateEntry e =
+        GateEntry::from_bytes(a.data()) ^ GateEntry::from_bytes(b.data());
+    CHECK(std::equal(e.data(), e.data() + e.size(), expected.begin()));
+
+    if (k.aes_encrypt) {
+      // 21 blocks cover the wide, four-block and single-block paths.
+      AesKey expanded;
+      k.aes_expand(key, expanded);
+      std::vector<unsigned char> blocks;
+      for (int i = 0; i < 21; i++)
+        blocks.insert(blocks.end(), plain, plain + 16);
+      k.aes_encrypt(expanded, blocks.data(), blocks.data(), 21);
+      for (int i = 0; i < 21; i++)
+        CHECK(std::equal(cipher, cipher + 16, &blocks[16 * i]));
+    }
+
+    TableEntry<128> pad = TableEntry<128>::pad(Label<128>::from_bytes(hx),
+                                               Label<128>::from_bytes(hy));
+    CHECK(std::equal(pad.data(), pad.data() + pad.size(), hashed));
+    TableEntry<80> pad80 = TableEntry<80>::pad(Label<80>::from_bytes(hx),
+                                               Label<80>::from_bytes(hy));
+    CHECK(std::equal(pad80.data(), pad80.data() + pad80.size(), hashed80));
+
+    unsigned char r1[37] = {}, r2[37] = {};
+    random_bytes(r1, sizeof(r1));
+    random_bytes(r2, sizeof(r2));
+    CHECK(!std::equal(r1, r1 + sizeof(r1), r2));
+  }
+  CHECK_THROWS(select_kernels("no-such-kernels"));
+  select_kernels("auto");
+  CHECK(kernels().name == supported_kernels().back());
+}
+
+TEST_CASE("labels round trip at every supported width") {
+  // Only YAOS_LABEL_BITS is built into the clients; check the other
+  // widths here so switching the build does not meet untested code.
+  check_label_round_trip<80>();
+  check_label_round_trip<96>();
+  check_label_round_trip<128>();
+}
+
+TEST_CASE("arena scopes wipe and reclaim what was allocated in them") {
+  SecureArena arena(4096);
+  CHECK(SecureArena::current() == nullptr);
+  GarbledGate outside;
+  outside.entries.resize(4);
+  CHECK(outside.entries.get_allocator().arena == nullptr);
+
+  unsigned char *first;
+  {
+    ArenaScope scope(arena);
+    CHECK(SecureArena::current() == &arena);
+    GarbledGate gate;
+    gate.entries.resize(4);
+    CHECK(gate.entries.get_allocator().arena == &arena);
+    first = gate.entries[0].data();
+    std::fill(first, first + 4 * GateEntry::LENGTH, 0xab);
+    CHECK(arena.used() == 4 * GateEntry::LENGTH);
+
+    {
+      // Past the first chunk, allocation moves on to a new one.
+      ArenaScope inner(arena);
+      ArenaVector<unsigned char> big(3 * 4096);
+      CHECK(arena.capacity() > 4096);
+      CHECK(arena.used() == 4 * GateEntry::LENGTH + big.size());
+    }
+    CHECK(arena.used() == 4 * GateEntry::LENGTH);
+    CHECK(first[0] == 0xab);
+  }
+  CHECK(SecureArena::current() == nullptr);
+  CHECK(arena.used() == 0);
+  CHECK(std::all_of(first, first + 4 * GateEntry::LENGTH,
+                    [](unsigned char c) { return c == 0; }));
+
+  ArenaScope scope(arena);
+  ArenaVector<unsigned char> again(16);
+  CHECK(again.data() == first);
+}
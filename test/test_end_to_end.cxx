@@ -0,0 +1,681 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "doctest/doctest.h"
+
+#include "../include-shared/bit_vector.hpp"
+#include "../include-shared/circuit.hpp"
+#include "../include-shared/circuit_builder.hpp"
+#include "../include-shared/circuit_simulator.hpp"
+#include "../include-shared/messages.hpp"
+#include "../include-shared/util.hpp"
+#include "../include/drivers/shm_network_driver.hpp"
+#include "../include/drivers/wan_network_driver.hpp"
+#include "../include/drivers/zerocopy_network_driver.hpp"
+#include "../include/pkg/evaluator.hpp"
+#include "../include/pkg/garbled_file.hpp"
+#include "../include/pkg/garbled_pool.hpp"
+#include "../include/pkg/garbler.hpp"
+#include "../include/pkg/garbler_server.hpp"
+#include "../include/pkg/multi_instance.hpp"
+#include "../include/pkg/session.hpp"
+#include "../include/pkg/specialized_circuit.hpp"
+
+namespace {
+// An input file, packed as the clients take it.
+BitVector read_input(std::string filename) {
+  return BitVector(parse_input(filename));
+}
+
+using PartyFn = std::function<void(std::shared_ptr<NetworkDriver>)>;
+
+/*
+ * Run garbler on its own thread and evaluator on this one, each given its
+ * end of a shared memory channel on port. The garbler thread is joined on
+ * every path; a party that throws drops its driver, which disconnects it, so
+ * the other side stops waiting. Rethrows the evaluator's error, else the
+ * garbler's.
+ */
+void run_parties(int port, PartyFn garbler, PartyFn evaluator) {
+  std::exception_ptr garbler_error, evaluator_error;
+  std::thread garbler_thread([&] {
+    try {
+      auto network_driver = std::make_shared<SharedMemoryNetworkDriver>();
+      network_driver->listen(port);
+      garbler(network_driver);
+    } catch (...) {
+      garbler_error = std::current_exception();
+    }
+  });
+  try {
+    auto network_driver = std::make_shared<SharedMemoryNetworkDriver>();
+    network_driver->connect("localhost", port);
+    evaluator(network_driver);
+  } catch (...) {
+    evaluator_error = std::current_exception();
+  }
+  garbler_thread.join();
+  if (evaluator_error)
+    std::rethrow_exception(evaluator_error);
+  if (garbler_error)
+    std::rethrow_exception(garbler_error);
+}
+
+/*
+ * Run garbler and evaluator on two threads over a shared memory channel.
+ * Returns (garbler output, evaluator output).
+ */
+std::pair<std::string, std::string>
+run_circuit(std::string name, int port,
+            std::shared_ptr<GarbledCircuitPool> pool = nullptr) {
+  std::string dir = CIRCUITS_DIR;
+  Circuit circuit = parse_circuit(dir + name + ".txt");
+  BitVector garbler_input = read_input(dir + name + "-input-1.txt");
+  BitVector evaluator_input = read_input(dir + name + "-input-2.txt");
+
+  std::string garbler_output, evaluator_output;
+  run_parties(
+      port,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerClient garbler(circuit, network_driver,
+                              std::make_shared<CryptoDriver>());
+        garbler.set_pool(pool);
+        garbler_output = garbler.run(garbler_input);
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorClient evaluator(circuit, network_driver,
+                                  std::make_shared<CryptoDriver>());
+        evaluator_output = evaluator.run(evaluator_input);
+      });
+  return std::make_pair(garbler_output, evaluator_output);
+}
+} // namespace
+
+TEST_CASE("shm driver round trips messages larger than the ring") {
+  std::vector<unsigned char> big(3 * 4096 + 17);
+  for (int i = 0; i < big.size(); i++)
+    big[i] = i * 31;
+
+  std::thread listener([&] {
+    SharedMemoryNetworkDriver driver(4096);
+    driver.listen(47001);
+    driver.send(driver.read());
+    driver.send(std::vector<unsigned char>());
+  });
+  SharedMemoryNetworkDriver driver;
+  driver.connect("localhost", 47001);
+  driver.send(big);
+  CHECK(driver.read() == big);
+  CHECK(driver.read().empty());
+  listener.join();
+  CHECK_THROWS(driver.read());
+}
+
+TEST_CASE("zero-copy driver sends payloads on both sides of the threshold") {
+  NetworkListener listener(47015);
+  std::thread echo([&] {
+    auto driver = std::make_shared<ZeroCopyNetworkDriver>(4096);
+    listener.accept(driver);
+    for (int i = 0; i < 8; i++)
+      driver->send(driver->read());
+    driver->disconnect();
+  });
+  ZeroCopyNetworkDriver driver(4096);
+  driver.connect("localhost", 47015);
+  if (!driver.using_zerocopy())
+    MESSAGE("SO_ZEROCOPY unavailable, large payloads were copied");
+
+  // Alternate copied and zero-copy payloads, each large one several
+  // notifications long, and reuse the driver once they are released.
+  for (int i = 0; i < 8; i++) {
+    std::vector<unsigned char> payload(i % 2 ? (1 << 20) + i : 100 + i);
+    for (int j = 0; j < payload.size(); j++)
+      payload[j] = i * 7 + j;
+    driver.send(payload);
+    CHECK(driver.read() == payload);
+  }
+  driver.disconnect();
+  echo.join();
+}
+
+TEST_CASE("garbled circuits over shm") {
+  CHECK(run_circuit("and", 47002) ==
+        std::make_pair(std::string("0"), std::string("0")));
+  CHECK(run_circuit("xor", 47003) ==
+        std::make_pair(std::string("1"), std::string("1")));
+
+  auto adder = run_circuit("adder", 47004);
+  CHECK(adder.first == adder.second);
+  CHECK(adder.first == "010000000000000000000000000000000");
+}
+
+TEST_CASE("specialized adder agrees with the generic path") {
+  // unit_tests links generated code for the scheduled adder.
+  Circuit adder = schedule_circuit(
+      parse_circuit(std::string(CIRCUITS_DIR) + "adder.txt"));
+  REQUIRE(find_specialized_circuit(adder) != nullptr);
+  CHECK(find_specialized_circuit(
+            parse_circuit(std::string(CIRCUITS_DIR) + "adder.txt")) ==
+        nullptr);
+
+  CircuitSimulator simulator(adder);
+  std::mt19937 rng(39);
+  int next_port = 47017;
+  // Every mix of generated and generic code on the two sides.
+  for (bool garbler_specialized : {true, false}) {
+    for (bool evaluator_specialized : {true, false}) {
+      int port = next_port++;
+      std::vector<int> garbler_input, evaluator_input;
+      for (int i = 0; i < adder.garbler_input_length; i++)
+        garbler_input.push_back(rng() & 1);
+      for (int i = 0; i < adder.evaluator_input_length; i++)
+        evaluator_input.push_back(rng() & 1);
+
+      std::string garbler_output, evaluator_output;
+      run_parties(
+          port,
+          [&](std::shared_ptr<NetworkDriver> network_driver) {
+            GarblerClient garbler(adder, network_driver,
+                                  std::make_shared<CryptoDriver>());
+            garbler.set_specialized(garbler_specialized);
+            garbler_output = garbler.run(BitVector(garbler_input));
+          },
+          [&](std::shared_ptr<NetworkDriver> network_driver) {
+            EvaluatorClient evaluator(adder, network_driver,
+                                      std::make_shared<CryptoDriver>());
+            evaluator.set_specialized(evaluator_specialized);
+            evaluator_output = evaluator.run(BitVector(evaluator_input));
+          });
+
+      std::vector<int> input = garbler_input;
+      input.insert(input.end(), evaluator_input.begin(),
+                   evaluator_input.end());
+      std::string expected;
+      for (int bit : simulator.run(input))
+        expected += bit ? "1" : "0";
+      CHECK(garbler_output == expected);
+      CHECK(evaluator_output == expected);
+    }
+  }
+}
+
+TEST_CASE("tables and labels go on the wire at their fixed width") {
+  WireLabel x = WireLabel::random(), y = WireLabel::random(),
+            z = WireLabel::random();
+  GarbledGate table;
+  table.entries = {GateEntry::encrypt(x, y, z)};
+  GarblerToEvaluator_GarbledTables_Message tables_msg;
+  tables_msg.garbled_tables = {table, GarbledGate()};
+  std::vector<unsigned char> data;
+  tables_msg.serialize(data);
+  CHECK(data.size() == 1 + sizeof(size_t) + 1 + 2 + GateEntry::LENGTH);
+
+  GarblerToEvaluator_GarbledTables_Message read;
+  read.deserialize(data);
+  REQUIRE(read.garbled_tables.size() == 2);
+  CHECK(read.garbled_tables[1].entries.empty());
+  GateEntry decryption =
+      read.garbled_tables[0].entries.at(0) ^ GateEntry::pad(x, y);
+  CHECK(decryption.tag_is_zero());
+  CHECK(decryption.label() == z);
+
+  // A peer built for another width is turned away.
+  data[1 + sizeof(size_t)]++;
+  CHECK_THROWS(GarblerToEvaluator_GarbledTables_Message().deserialize(data));
+}
+
+TEST_CASE("output queries are checked against the message length") {
+  EvaluatorToGarbler_OutputQuery_Message query;
+  query.outputs = {0, 7, 31};
+  std::vector<unsigned char> data;
+  query.serialize(data);
+  EvaluatorToGarbler_OutputQuery_Message read;
+  read.deserialize(data);
+  CHECK(read.outputs == query.outputs);
+
+  // Too short for the count, one output short, and a count that would
+  // overflow the length check.
+  std::vector<unsigned char> header(data.begin(), data.begin() + 5);
+  CHECK_THROWS(EvaluatorToGarbler_OutputQuery_Message().deserialize(header));
+  std::vector<unsigned char> short_data(data.begin(), data.end() - 1);
+  CHECK_THROWS(
+      EvaluatorToGarbler_OutputQuery_Message().deserialize(short_data));
+  size_t huge = SIZE_MAX / sizeof(int32_t) + 2;
+  std::memcpy(&data[1], &huge, sizeof(huge));
+  CHECK_THROWS(EvaluatorToGarbler_OutputQuery_Message().deserialize(data));
+}
+
+TEST_CASE("sessions take pre-garbled circuits from a pool") {
+  GarbledPoolConfig config;
+  config.capacity = 2;
+  config.refill_threads = 2;
+  auto pool = std::make_shared<GarbledCircuitPool>(
+      std::make_shared<const Circuit>(
+          parse_circuit(std::string(CIRCUITS_DIR) + "adder.txt")),
+      config);
+  // More sessions than the pool holds, so some may garble inline.
+  for (int i = 0; i < 4; i++) {
+    auto adder = run_circuit("adder", 47006 + i, pool);
+    CHECK(adder.first == adder.second);
+    CHECK(adder.first == "010000000000000000000000000000000");
+  }
+  for (int i = 0; i < 500 && pool->ready_count() < config.capacity; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CHECK(pool->ready_count() == config.capacity);
+}
+
+TEST_CASE("garbler rejects a pool for another circuit") {
+  std::string dir = CIRCUITS_DIR;
+  auto pool = std::make_shared<GarbledCircuitPool>(
+      std::make_shared<const Circuit>(parse_circuit(dir + "and.txt")),
+      GarbledPoolConfig());
+  GarblerClient garbler(parse_circuit(dir + "adder.txt"),
+                        std::make_shared<SharedMemoryNetworkDriver>(),
+                        std::make_shared<CryptoDriver>());
+  CHECK_THROWS(garbler.set_pool(pool));
+}
+
+TEST_CASE("server runs sessions for concurrent evaluators") {
+  std::string dir = CIRCUITS_DIR;
+  auto circuit =
+      std::make_shared<const Circuit>(parse_circuit(dir + "adder.txt"));
+  std::vector<int> garbler_input = parse_input(dir + "adder-input-1.txt");
+  const int evaluators = 2;
+  GarblerServer server(circuit, BitVector(garbler_input), evaluators);
+  std::thread server_thread([&] {
+    server.serve(
+        47016, [] { return std::make_shared<NetworkDriverImpl>(); },
+        evaluators);
+  });
+
+  std::mt19937 rng(28);
+  std::vector<std::vector<int>> inputs(evaluators);
+  for (auto &input : inputs)
+    for (int j = 0; j < circuit->evaluator_input_length; j++)
+      input.push_back(rng() & 1);
+  std::vector<std::string> outputs(evaluators);
+  std::vector<std::exception_ptr> errors(evaluators);
+  std::atomic<int> connected(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < evaluators; i++) {
+    threads.emplace_back([&, i] {
+      try {
+        // The server binds on its own thread, so retry until it listens.
+        std::shared_ptr<NetworkDriverImpl> network_driver;
+        for (int tries = 0;; tries++) {
+          try {
+            network_driver = std::make_shared<NetworkDriverImpl>();
+            network_driver->connect("localhost", 47016);
+            break;
+          } catch (std::exception &) {
+            if (tries == 500)
+              throw;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          }
+        }
+        // Both sessions are open before either one starts.
+        connected++;
+        while (connected < evaluators)
+          std::this_thread::yield();
+        EvaluatorClient evaluator(*circuit, network_driver,
+                                  std::make_shared<CryptoDriver>());
+        outputs[i] = evaluator.run(BitVector(inputs[i]));
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  server_thread.join();
+  for (auto &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+
+  CircuitSimulator simulator(*circuit);
+  for (int i = 0; i < evaluators; i++) {
+    std::vector<int> input = garbler_input;
+    input.insert(input.end(), inputs[i].begin(), inputs[i].end());
+    std::string expected;
+    for (int bit : simulator.run(input))
+      expected += bit ? "1" : "0";
+    CHECK(outputs[i] == expected);
+  }
+}
+
+TEST_CASE("batch mode runs many inputs over one connection") {
+  Circuit circuit =
+      schedule_circuit(parse_circuit(std::string(CIRCUITS_DIR) + "adder.txt"));
+  std::mt19937 rng(41);
+  std::vector<BitVector> garbler_inputs(5), evaluator_inputs(5);
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < circuit.garbler_input_length; j++)
+      garbler_inputs[i].push_back(rng() & 1);
+    for (int j = 0; j < circuit.evaluator_input_length; j++)
+      evaluator_inputs[i].push_back(rng() & 1);
+  }
+
+  std::vector<BitVector> garbler_outputs, evaluator_outputs;
+  run_parties(
+      47010,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerClient garbler(circuit, network_driver,
+                              std::make_shared<CryptoDriver>());
+        // Passes need not line up between the two sides.
+        garbler.set_instances_per_pass(2);
+        garbler_outputs = garbler.run_batch(garbler_inputs);
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorClient evaluator(circuit, network_driver,
+                                  std::make_shared<CryptoDriver>());
+        evaluator.set_instances_per_pass(3);
+        evaluator_outputs = evaluator.run_batch(evaluator_inputs);
+      });
+
+  CircuitSimulator simulator(circuit);
+  REQUIRE(evaluator_outputs.size() == 5);
+  CHECK(garbler_outputs == evaluator_outputs);
+  for (int i = 0; i < 5; i++) {
+    BitVector input = garbler_inputs[i];
+    input.append(evaluator_inputs[i]);
+    std::string expected;
+    for (int bit : simulator.run(input.to_ints()))
+      expected += bit ? "1" : "0";
+    CHECK(evaluator_outputs[i].to_string() == expected);
+  }
+}
+
+TEST_CASE("instances garbled in one pass decode like the simulator") {
+  Circuit circuit =
+      schedule_circuit(parse_circuit(std::string(CIRCUITS_DIR) + "adder.txt"));
+  WireSlots slots = assign_wire_slots(circuit);
+  GarblerClient garbler(circuit, nullptr, std::make_shared<CryptoDriver>());
+  const int k = 4;
+  std::vector<GarbledLabels> labels;
+  for (int j = 0; j < k; j++)
+    labels.push_back(garbler.generate_labels(circuit, slots));
+  std::vector<GarbledLabels *> pass;
+  for (GarbledLabels &instance : labels)
+    pass.push_back(&instance);
+  std::vector<std::vector<GarbledGate>> tables =
+      garble_instances(circuit, slots, pass);
+  REQUIRE(tables.size() == k);
+
+  // Each instance on its own inputs, with its own delta.
+  CircuitSimulator simulator(circuit);
+  std::mt19937 rng(44);
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<std::vector<int>> inputs(k);
+  std::vector<std::vector<GarbledWire>> input_labels(k);
+  std::vector<const std::vector<GarbledGate> *> table_ptrs;
+  for (int j = 0; j < k; j++) {
+    for (int i = 0; i < num_inputs; i++) {
+      int bit = rng() & 1;
+      int s = slots.slot[i];
+      inputs[j].push_back(bit);
+      input_labels[j].push_back(bit ? labels[j].ones[s] : labels[j].zeros[s]);
+    }
+    table_ptrs.push_back(&tables[j]);
+  }
+  std::vector<std::vector<GarbledWire>> outputs =
+      evaluate_instances(circuit, slots, table_ptrs, input_labels);
+  REQUIRE(outputs.size() == k);
+  int first_output = circuit.num_wire - circuit.output_length;
+  for (int j = 0; j < k; j++) {
+    std::vector<int> expected = simulator.run(inputs[j]);
+    for (int i = 0; i < circuit.output_length; i++) {
+      int s = slots.slot[first_output + i];
+      const GarbledWire &zero = labels[j].zeros[s], &one = labels[j].ones[s];
+      CHECK(outputs[j][i].value == (expected[i] ? one : zero).value);
+    }
+  }
+
+  // A table that nothing decrypts is an error, not a zero label.
+  GarbledGate *broken = nullptr;
+  for (GarbledGate &table : tables[2]) {
+    if (!table.entries.empty()) {
+      for (GateEntry &entry : table.entries)
+        entry = GateEntry();
+      broken = &table;
+      break;
+    }
+  }
+  CHECK_THROWS(evaluate_instances(circuit, slots, table_ptrs, input_labels));
+  // Likewise for the single-instance evaluator.
+  REQUIRE(broken != nullptr);
+  EvaluatorClient evaluator(circuit,
+                            std::make_shared<SharedMemoryNetworkDriver>(),
+                            std::make_shared<CryptoDriver>());
+  CHECK_THROWS(evaluator.evaluate_gate(*broken, input_labels[2][0],
+                                       input_labels[2][1]));
+}
+
+TEST_CASE("stored garblings run from a table file") {
+  std::string dir = CIRCUITS_DIR;
+  Circuit circuit = schedule_circuit(parse_circuit(dir + "adder.txt"));
+  std::string tables =
+      (std::filesystem::temp_directory_path() / "yaos_test_tables.yg")
+          .string();
+  std::string key =
+      (std::filesystem::temp_directory_path() / "yaos_test_tables.key")
+          .string();
+  GarblerClient(circuit, nullptr, std::make_shared<CryptoDriver>())
+      .garble_to_file(tables, key);
+
+  std::string garbler_output, evaluator_output;
+  run_parties(
+      47013,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerClient garbler(circuit, network_driver,
+                              std::make_shared<CryptoDriver>());
+        garbler_output =
+            garbler.run_stored(key, read_input(dir + "adder-input-1.txt"));
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorClient evaluator(circuit, network_driver,
+                                  std::make_shared<CryptoDriver>());
+        evaluator_output = evaluator.run_stored(
+            tables, read_input(dir + "adder-input-2.txt"));
+      });
+  CHECK(garbler_output == evaluator_output);
+  CHECK(evaluator_output == "010000000000000000000000000000000");
+
+  // The run used the key up; another run on it must not send labels.
+  CHECK(!std::filesystem::exists(key));
+  CHECK_THROWS(
+      GarblerClient(circuit, nullptr, std::make_shared<CryptoDriver>())
+          .run_stored(key, read_input(dir + "adder-input-1.txt")));
+
+  // Labels the tables were not garbled under decrypt nothing.
+  std::vector<GarbledWire> wrong_labels(circuit.garbler_input_length +
+                                        circuit.evaluator_input_length);
+  for (GarbledWire &label : wrong_labels)
+    label.value = WireLabel::random();
+  CHECK_THROWS(evaluate_stored(circuit, assign_wire_slots(circuit),
+                               load_garbled_tables(tables), wrong_labels));
+
+  // Flip one table byte: only a verified load notices.
+  std::string header_copy = tables + ".header";
+  std::filesystem::copy_file(tables, header_copy,
+                             std::filesystem::copy_options::overwrite_existing);
+  {
+    std::fstream f(tables, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(300);
+    f.put(0x7f);
+  }
+  CHECK_NOTHROW(load_garbled_tables(tables, false));
+  CHECK_THROWS(load_garbled_tables(tables));
+  std::remove(tables.c_str());
+
+  // The checksum covers the header too.
+  {
+    std::fstream f(header_copy,
+                   std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offsetof(GarbledTableHeader, garbling_id));
+    f.put(0x7f);
+  }
+  CHECK_NOTHROW(load_garbled_tables(header_copy, false));
+  CHECK_THROWS(load_garbled_tables(header_copy));
+  // An offset past the end is caught before it can wrap.
+  {
+    uint64_t offset = ~(uint64_t)63;
+    std::fstream f(header_copy,
+                   std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offsetof(GarbledTableHeader, tables_offset));
+    f.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  }
+  CHECK_THROWS(load_garbled_tables(header_copy, false));
+  std::remove(header_copy.c_str());
+}
+
+TEST_CASE("output queries garble only the queried cone") {
+  std::string dir = CIRCUITS_DIR;
+  Circuit circuit = parse_circuit(dir + "adder.txt");
+  std::string garbler_output, evaluator_output;
+  run_parties(
+      47014,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerClient garbler(circuit, network_driver,
+                              std::make_shared<CryptoDriver>());
+        garbler_output =
+            garbler.run_query(read_input(dir + "adder-input-1.txt"));
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorClient evaluator(circuit, network_driver,
+                                  std::make_shared<CryptoDriver>());
+        evaluator_output = evaluator.run_query(
+            read_input(dir + "adder-input-2.txt"), {1, 0, 32});
+      });
+  CHECK(garbler_output == evaluator_output);
+  // Full output is 0100...0.
+  CHECK(evaluator_output == "100");
+}
+
+TEST_CASE("sessions run different circuits over one connection") {
+  std::string dir = CIRCUITS_DIR;
+  std::vector<std::string> jobs = {"adder", "xor", "adder", "and"};
+  auto add_circuits = [&](auto &session) {
+    for (std::string name : {"adder", "xor", "and"})
+      session.add_circuit(name, std::make_shared<const Circuit>(
+                                    parse_circuit(dir + name + ".txt")));
+  };
+
+  std::vector<std::string> garbler_outputs, evaluator_outputs;
+  run_parties(
+      47011,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerSession session(network_driver,
+                               std::make_shared<CryptoDriver>());
+        add_circuits(session);
+        for (std::string name : jobs)
+          garbler_outputs.push_back(session.run_job(
+              name, read_input(dir + name + "-input-1.txt")));
+        session.close();
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorSession session(network_driver,
+                                 std::make_shared<CryptoDriver>());
+        add_circuits(session);
+        for (std::string name : jobs)
+          evaluator_outputs.push_back(session.run_job(
+              name, read_input(dir + name + "-input-2.txt")));
+        session.close();
+      });
+
+  std::vector<std::string> expected = {"010000000000000000000000000000000",
+                                       "1", "010000000000000000000000000000000",
+                                       "0"};
+  CHECK(garbler_outputs == expected);
+  CHECK(evaluator_outputs == expected);
+}
+
+TEST_CASE("reactive jobs pass kept labels between circuits") {
+  // (x + y) * z with the sum never revealed.
+  using namespace circuits;
+  auto add_circuit = std::make_shared<const Circuit>(build_circuit(
+      8, 8, [](CircuitBuilder &b, Bits x, Bits y) { return add(b, x, y); }));
+  auto multiply_circuit = std::make_shared<const Circuit>(build_circuit(
+      9, 8,
+      [](CircuitBuilder &b, Bits s, Bits z) { return multiply(b, s, z); }));
+  JobWiring keep_sum, use_sum;
+  keep_sum.outputs.push_back({"sum", 0, 9});
+  use_sum.inputs.push_back({"sum", 0});
+  auto bits = [](int value, int width) {
+    BitVector out;
+    for (int i = 0; i < width; i++)
+      out.push_back((value >> i) & 1);
+    return out;
+  };
+  auto add_circuits = [&](auto &session) {
+    session.add_circuit("add", add_circuit);
+    session.add_circuit("multiply", multiply_circuit);
+  };
+
+  int x = 200, y = 100, z = 77;
+  std::string garbler_sum, garbler_product, evaluator_sum, product;
+  run_parties(
+      47012,
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        GarblerSession session(network_driver,
+                               std::make_shared<CryptoDriver>());
+        add_circuits(session);
+        garbler_sum = session.run_job("add", bits(x, 8), keep_sum);
+        garbler_product = session.run_job("multiply", {}, use_sum);
+        session.close();
+      },
+      [&](std::shared_ptr<NetworkDriver> network_driver) {
+        EvaluatorSession session(network_driver,
+                                 std::make_shared<CryptoDriver>());
+        add_circuits(session);
+        evaluator_sum = session.run_job("add", bits(y, 8), keep_sum);
+        product = session.run_job("multiply", bits(z, 8), use_sum);
+        session.close();
+      });
+
+  CHECK(garbler_sum.empty());
+  CHECK(evaluator_sum.empty());
+  std::string expected = bits((x + y) * z, 17).to_string();
+  CHECK(product == expected);
+  CHECK(garbler_product == expected);
+}
+
+TEST_CASE("wan driver delays, paces and keeps order") {
+  WanProfile profile;
+  profile.latency_ms = 30;
+  profile.jitter_ms = 20;
+  profile.bandwidth_mbit = 8; // 1 MB/s
+  profile.burst_bytes = 1000;
+
+  std::thread listener([&] {
+    SharedMemoryNetworkDriver driver;
+    driver.listen(47005);
+    for (int i = 0; i < 20; i++)
+      driver.send(driver.read());
+  });
+  WanEmulatedNetworkDriver driver(
+      std::make_shared<SharedMemoryNetworkDriver>(), profile);
+  driver.connect("localhost", 47005);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 20; i++)
+    driver.send(std::vector<unsigned char>(5000, i));
+  for (int i = 0; i < 20; i++)
+    CHECK(driver.read() == std::vector<unsigned char>(5000, i));
+  double elapsed_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  // 99 KB over the burst at 1 MB/s, plus at least latency - jitter.
+  CHECK(elapsed_ms >= 99 + 10);
+  driver.disconnect();
+  listener.join();
+}
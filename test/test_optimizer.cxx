@@ -0,0 +1,236 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "doctest/doctest.h"
+
+#include "../include-shared/circuit.hpp"
+#include "../include-shared/circuit_optimizer.hpp"
+
+namespace {
+/*
+ * Plaintext evaluation; returns the output bits. One value per wire, so it
+ * does not share the simulator's slot assignment.
+ */
+std::vector<int> simulate(const Circuit &circuit, const std::vector<int> &input) {
+  std::vector<int> wires(circuit.num_wire, 0);
+  std::copy(input.begin(), input.end(), wires.begin());
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::AND_GATE)
+      wires[gate.output] = wires[gate.lhs] & wires[gate.rhs];
+    else if (gate.type == GateType::XOR_GATE)
+      wires[gate.output] = wires[gate.lhs] ^ wires[gate.rhs];
+    else
+      wires[gate.output] = !wires[gate.lhs];
+  }
+  return std::vector<int>(wires.end() - circuit.output_length, wires.end());
+}
+
+/*
+ * Plaintext evaluation of 64 input vectors at once, one per bit position.
+ */
+std::vector<uint64_t> simulate_words(const Circuit &circuit,
+                                     const std::vector<uint64_t> &input) {
+  std::vector<uint64_t> wires(circuit.num_wire, 0);
+  std::copy(input.begin(), input.end(), wires.begin());
+  for (const Gate &gate : circuit.gates) {
+    if (gate.type == GateType::AND_GATE)
+      wires[gate.output] = wires[gate.lhs] & wires[gate.rhs];
+    else if (gate.type == GateType::XOR_GATE)
+      wires[gate.output] = wires[gate.lhs] ^ wires[gate.rhs];
+    else
+      wires[gate.output] = ~wires[gate.lhs];
+  }
+  return std::vector<uint64_t>(wires.end() - circuit.output_length,
+                               wires.end());
+}
+
+/*
+ * Compare two circuits on 64 * rounds random inputs, plus exhaustively when
+ * there are at most 6 inputs.
+ */
+bool equivalent_words(const Circuit &a, const Circuit &b, int rounds) {
+  int num_inputs = a.garbler_input_length + a.evaluator_input_length;
+  std::mt19937_64 rng(1515);
+  for (int r = 0; r < rounds; r++) {
+    std::vector<uint64_t> input(num_inputs);
+    for (int i = 0; i < num_inputs; i++) {
+      // Bit j of input i is bit i of j: all 64 assignments of 6 inputs.
+      const uint64_t patterns[6] = {0xAAAAAAAAAAAAAAAA, 0xCCCCCCCCCCCCCCCC,
+                                    0xF0F0F0F0F0F0F0F0, 0xFF00FF00FF00FF00,
+                                    0xFFFF0000FFFF0000, 0xFFFFFFFF00000000};
+      input[i] = r == 0 && num_inputs <= 6 ? patterns[i] : rng();
+    }
+    if (simulate_words(a, input) != simulate_words(b, input))
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Compare two circuits on random inputs.
+ */
+bool equivalent(const Circuit &a, const Circuit &b, int trials) {
+  int num_inputs = a.garbler_input_length + a.evaluator_input_length;
+  std::mt19937 rng(1515);
+  for (int t = 0; t < trials; t++) {
+    std::vector<int> input(num_inputs);
+    for (int &bit : input)
+      bit = rng() & 1;
+    if (simulate(a, input) != simulate(b, input))
+      return false;
+  }
+  return true;
+}
+
+Circuit circuit_from(std::string contents) {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "yaos_test_optimizer.txt")
+          .string();
+  std::ofstream(path) << contents;
+  Circuit circuit = parse_circuit(path);
+  std::remove(path.c_str());
+  return circuit;
+}
+} // namespace
+
+TEST_CASE("optimizer folds constants, NOT pairs and dead gates") {
+  // w3 = w0 ^ w0 (0); w4 = w3 & w1 (0, dead); w5 = !w1; w6 = !w5 (w1);
+  // w7 = w6 & w2; w8 = w0 & w2 (dead); w9 = w7 ^ w3 (w7); w10 = !w3 (1)
+  Circuit c = circuit_from("8 11\n2 1 2\n\n"
+                           "2 1 0 0 3 XOR\n2 1 3 1 4 AND\n1 1 1 5 INV\n"
+                           "1 1 5 6 INV\n2 1 6 2 7 AND\n2 1 0 2 8 AND\n"
+                           "2 1 7 3 9 XOR\n1 1 3 10 INV\n");
+  Circuit o = optimize_circuit(c);
+  GateCounts counts = count_gates(o);
+  CHECK(counts.and_gates == 1);
+  CHECK(o.num_gate <= 3); // w1 & w2, zero, !zero
+  CHECK(o.num_wire - o.output_length ==
+        3 + o.num_gate - o.output_length); // dense wires
+  CHECK(equivalent(c, o, 8));
+}
+
+TEST_CASE("optimizer keeps inputs first and outputs last") {
+  // Output 0 is an input, outputs 1 and 2 are the same gate.
+  Circuit c = circuit_from("3 5\n1 1 3\n\n"
+                           "2 1 0 1 2 AND\n2 1 0 1 3 AND\n"
+                           "2 1 1 1 4 AND\n");
+  Circuit o = optimize_circuit(c);
+  CHECK(count_gates(o).and_gates == 1);
+  CHECK(equivalent(c, o, 4));
+}
+
+TEST_CASE("optimized circuits are equivalent") {
+  for (std::string name : {"adder", "mult", "aes"}) {
+    Circuit c = parse_circuit(std::string(CIRCUITS_DIR) + name + ".txt");
+    Circuit o = optimize_circuit(c);
+    CHECK(count_gates(o).and_gates <= count_gates(c).and_gates);
+    CHECK(o.num_gate <= c.num_gate);
+    CHECK(equivalent(c, o, 16));
+
+    // The result survives a Bristol round trip (and its validation).
+    std::string path =
+        (std::filesystem::temp_directory_path() / "yaos_test_optimized.txt")
+            .string();
+    write_circuit(o, path);
+    CHECK(equivalent(o, parse_circuit(path), 4));
+    std::remove(path.c_str());
+  }
+}
+
+TEST_CASE("mc rewriting shrinks majority, full adders and muxes") {
+  // maj(a, b, c) = ab ^ ac ^ bc: 3 ANDs -> 1.
+  Circuit maj = circuit_from("5 8\n2 1 1\n\n"
+                             "2 1 0 1 3 AND\n2 1 0 2 4 AND\n2 1 1 2 5 AND\n"
+                             "2 1 3 4 6 XOR\n2 1 6 5 7 XOR\n");
+  // Full adder (sum, carry), carry = ab | c(a ^ b): 3 ANDs -> 1.
+  Circuit adder = circuit_from("8 11\n2 1 2\n\n"
+                               "2 1 0 1 3 XOR\n2 1 0 1 4 AND\n"
+                               "2 1 2 3 5 AND\n1 1 4 6 INV\n1 1 5 7 INV\n"
+                               "2 1 6 7 8 AND\n2 1 3 2 9 XOR\n"
+                               "1 1 8 10 INV\n");
+  // mux(s, a, b) = s ? b : a as (s & b) | (!s & a): 3 ANDs -> 1.
+  Circuit mux = circuit_from("7 10\n1 2 1\n\n"
+                             "2 1 0 2 3 AND\n1 1 0 4 INV\n2 1 4 1 5 AND\n"
+                             "1 1 3 6 INV\n1 1 5 7 INV\n2 1 6 7 8 AND\n"
+                             "1 1 8 9 INV\n");
+  for (const Circuit *c : {&maj, &adder, &mux}) {
+    Circuit m = minimize_and_gates(*c);
+    CHECK(count_gates(*c).and_gates == 3);
+    CHECK(count_gates(m).and_gates == 1);
+    CHECK(equivalent_words(*c, m, 1));
+  }
+}
+
+TEST_CASE("mc rewriting preserves the shipped circuits") {
+  for (std::string name : {"adder", "mult", "aes"}) {
+    Circuit c = parse_circuit(std::string(CIRCUITS_DIR) + name + ".txt");
+    Circuit m = minimize_and_gates(c);
+    MESSAGE(name << ": " << count_gates(c).and_gates << " -> "
+                 << count_gates(m).and_gates << " ANDs");
+    CHECK(count_gates(m).and_gates <= count_gates(c).and_gates);
+    CHECK(equivalent_words(c, m, 64));
+  }
+}
+
+TEST_CASE("output cones keep only what the chosen outputs need") {
+  Circuit mult = parse_circuit(std::string(CIRCUITS_DIR) + "mult.txt");
+  // The low product bit is x0 & y0.
+  CHECK(count_gates(output_cone(mult, {0})).and_gates == 1);
+  CHECK(count_gates(output_cone(mult, {0, 1, 2, 3})).and_gates <
+        count_gates(mult).and_gates / 10);
+
+  // Outputs come back in the order asked, repeats included.
+  std::vector<int> outputs = {40, 3, 63, 3};
+  Circuit cone = output_cone(mult, outputs);
+  CHECK(cone.output_length == outputs.size());
+  std::mt19937 rng(46);
+  for (int t = 0; t < 8; t++) {
+    std::vector<int> input(mult.garbler_input_length +
+                           mult.evaluator_input_length);
+    for (int &bit : input)
+      bit = rng() & 1;
+    std::vector<int> want = simulate(mult, input),
+                     got = simulate(cone, input);
+    for (int i = 0; i < outputs.size(); i++)
+      CHECK(got[i] == want[outputs[i]]);
+  }
+  CHECK_THROWS(output_cone(mult, {64}));
+}
+
+TEST_CASE("schedule groups levels and improves locality") {
+  auto mean_distance = [](const Circuit &c) {
+    double total = 0;
+    for (const Gate &gate : c.gates)
+      total += std::abs(gate.output - gate.lhs);
+    return total / c.gates.size();
+  };
+  for (std::string name : {"adder", "mult", "aes"}) {
+    Circuit c = parse_circuit(std::string(CIRCUITS_DIR) + name + ".txt");
+    Circuit s = schedule_circuit(c);
+    CHECK(equivalent_words(c, s, 16));
+    CHECK(mean_distance(s) <= mean_distance(c));
+
+    // Every gate sits in its level and levels only read earlier levels.
+    std::vector<uint32_t> levels = compute_gate_levels(s);
+    REQUIRE(s.level_offsets.size() >= 1);
+    CHECK(s.level_offsets.front() == 0);
+    CHECK(s.level_offsets.back() == s.num_gate);
+    for (int l = 0; l + 1 < s.level_offsets.size(); l++) {
+      for (int i = s.level_offsets[l]; i < s.level_offsets[l + 1]; i++)
+        CHECK(levels[i] == l);
+    }
+
+    // Both parties must get the same circuit however often it is scheduled.
+    Circuit again = schedule_circuit(s);
+    CHECK(again.num_wire == s.num_wire);
+    CHECK(again.level_offsets == s.level_offsets);
+    CHECK(std::equal(again.gates.begin(), again.gates.end(), s.gates.begin(),
+                     [](const Gate &a, const Gate &b) {
+                       return a.type == b.type && a.lhs == b.lhs &&
+                              a.rhs == b.rhs && a.output == b.output;
+                     }));
+  }
+}